@@ -9,38 +9,829 @@
 #include "RecoTargetSampleHandler.h"
 #include "RecoTargetUserOptions.h"
 #include "RecoTargetUtils.h"
+#include "RecoTargetException.h"
+#include "RecoTargetDistributed.h"
+#include "RecoTargetPipeline.h"
+#include "RecoTargetScheduler.h"
+#include "RecoTargetCache.h"
+#include "RecoTargetReduction.h"
+#include "RecoTargetRanking.h"
+#include "RecoTargetProfiler.h"
+#include "RecoTargetValidation.h"
+#include "RecoTargetStream.h"
+#include "RecoTargetRegion.h"
+#include "RecoTargetServer.h"
 #include <iostream>
+#include <iomanip>
 #include <cstring>
+#include <memory>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace RECOTRACKS_ANA;
 using namespace RecoTarget;
 using std::cout;
+using std::cerr;
 using std::vector;
 
-int main (int argc, char *argv[])
+//! fill kmax nearest neighbors for selected testing targets from selected
+//! learning (and merge top-k from all ranks on rank 0 if distributed);
+//! leave-one-out: testing samples are learning ones; with stream
+//! learning samples are read chunk by chunk (learningSamples not used)
+void fillNeighbors (RecoTargetSampleHandler **testingSamples,
+                    RecoTargetSampleHandler **learningSamples,
+                    const RecoTargetUserOptions &userOptions,
+                    RecoTargetCommunicator *communicator,
+                    RecoTargetScheduler &scheduler,
+                    RecoTargetStream *stream)
+{
+  if (stream)
+    stream->run ([&] (RecoTargetSampleHandler **chunk)
+                 { scheduler.fillNeighbors (testingSamples, chunk,
+                                            userOptions); });
+  else if (userOptions.getFlagLoo())
+    scheduler.fillSymmetric (learningSamples, userOptions);
+  else
+    scheduler.fillNeighbors (testingSamples, learningSamples, userOptions);
+            
+  if (communicator)
+    reduceNeighbors (testingSamples, communicator,
+                     userOptions.getMaxNeighbors());
+}
+
+//! set storage precision for all loaded samples
+void quantize (RecoTargetSampleHandler **samples,
+               const Precision &precision)
 {
-  // parse and save user's command arguments
-  RecoTargetUserOptions userOptions (argc, argv);
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (samples[i]) samples[i]->quantize (precision);
+}
+
+//! replace distributions of all loaded samples by features
+void useFeatures (RecoTargetSampleHandler **samples,
+                  const RecoTargetUserOptions &userOptions)
+{
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (samples[i]) samples[i]->useFeatures (userOptions.getFlagFeatures());
+}
+
+//! return planes of run's region of interest (empty = all planes);
+//! auto region is chosen from given learning samples
+vector <unsigned int> getRegion (RecoTargetSampleHandler **learningSamples,
+                                 const RecoTargetUserOptions &userOptions)
+{
+  if (not userOptions.getRegion()) return vector <unsigned int> ();
   
-  // arrays for testing and learning samples
-  RecoTargetSampleHandler *testingSamples[nTargets] = {NULL};
-  RecoTargetSampleHandler *learningSamples[nTargets] = {NULL};
+  return RecoTargetRegion (userOptions.getRegion()).getPlanes
+    (learningSamples);
+}
+
+//! keep only planes of region in all loaded samples
+void useRegion (RecoTargetSampleHandler **samples,
+                const vector <unsigned int> &planes)
+{
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (samples[i]) samples[i]->useRegion (planes);
+}
+
+//! deletes testing and learning handlers (NULL = not used) when it goes
+//! out of scope, so they are freed on every exit path; testing handlers
+//! which are learning ones (leave-one-out) are deleted once
+class SamplesGuard
+{
+  public:
+  
+  //! constructor (testingSamples = NULL: only learning ones)
+  SamplesGuard (RecoTargetSampleHandler **testingSamples,
+                RecoTargetSampleHandler **learningSamples)
+    : testingSamples (testingSamples), learningSamples (learningSamples) {}
+  
+  //! destructor (delete handlers)
+  ~SamplesGuard ()
+  {
+    for (unsigned int i = 0; i < nTargets; i++)
+    {
+      if (testingSamples and testingSamples[i] != learningSamples[i])
+        delete testingSamples[i];
+      
+      delete learningSamples[i];
+    }
+  }
+  
+  private:
+  
+  RecoTargetSampleHandler **testingSamples;
+  RecoTargetSampleHandler **learningSamples;
+  
+  //! guard deletes handlers, so it can not be copied
+  SamplesGuard (const SamplesGuard &);
+  SamplesGuard& operator= (const SamplesGuard &);
+};
+
+//! runs which find the same neighbors: done at once for all their
+//! testing targets and the largest kmax
+struct RunGroup
+{
+  RecoTargetUserOptions options; //!< union of all runs in group
+  vector <unsigned int> runs;    //!< which runs belong to group
+  RecoTargetCache *cache;        //!< NULL if cache is not used
+  bool isDone;                   //!< true if scores are known
+  
+  RunGroup (const RecoTargetUserOptions &run)
+    : options (run), cache (NULL), isDone (false) {}
+};
+
+//! what is printed for each run
+struct RunResult
+{
+  unsigned int nEntries[nTargets]; //!< entries found for each target
+  double scores[nTargets];         //!< score for each testing target
+  double referenceScores[nTargets]; //!< the same in double precision
+  double fullScores[nTargets];     //!< the same with full learning set
+  
+  unsigned int nFull;    //!< learning samples before reduction (if done)
+  unsigned int nReduced; //!< learning samples used (0 = unknown)
+  
+  //! for k = 1 .. kmax: score of each target and mean margin (kscan)
+  vector <double> kScan;
+  
+  //! true target x predicted target for run's k (kscan)
+  unsigned int confusion[nTargets][nTargets];
+};
+
+//! which scores of a run are saved
+typedef double (RunResult::*Scores)[nTargets];
+
+//! true if learning samples are reduced in this run (not read from
+//! reduced set saved before)
+bool isReducing (const RecoTargetUserOptions &userOptions)
+{
+  const char *path = userOptions.getReducedPath();
+  
+  return userOptions.getReduction() != FULL and
+         not (path and access (path, F_OK) == 0);
+}
+
+//! return the number of samples in all handlers
+unsigned int nSamples (RecoTargetSampleHandler **samples)
+{
+  unsigned int n = 0;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (samples[i]) n += samples[i]->getNSamples();
+    
+  return n;
+}
+
+//! put runs with the same neighbors together
+vector <RunGroup> groupRuns (const vector <RecoTargetUserOptions> &runs)
+{
+  vector <RunGroup> groups;
+  
+  for (unsigned int r = 0; r < runs.size(); r++)
+  {
+    unsigned int g = 0;
+    
+    while (g < groups.size() and
+           not groups[g].options.isSameNeighbors (runs[r])) g++;
+    
+    if (g == groups.size()) groups.push_back (RunGroup (runs[r]));
+    
+    groups[g].options.merge (runs[r]);
+    groups[g].runs.push_back (r);
+  }
+  
+  return groups;
+}
+
+//! index learning samples if any group uses Euclidean metric (so far
+//! ones are skipped; leave-one-out does not use index)
+void index (RecoTargetSampleHandler **learningSamples,
+            const vector <RunGroup*> &groups)
+{
+  bool isEuclidean = false;
+  
+  for (unsigned int g = 0; g < groups.size(); g++)
+    isEuclidean = isEuclidean or
+      (groups[g]->options.getMetric() == EUCLIDEAN and
+       not groups[g]->options.getFlagLoo());
+  
+  if (not isEuclidean) return;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (learningSamples[i]) learningSamples[i]->index();
+}
+
+//! save scores for every k up to run's kmax, and confusion matrix
+void getKScan (const RecoTargetRanking &ranking,
+               const RecoTargetUserOptions &run, RunResult &result)
+{
+  const unsigned int kMax = run.getMaxNeighbors();
+  
+  result.kScan.assign (kMax * (nTargets + 1), 0.0);
+  
+  for (unsigned int k = 1; k <= kMax; k++)
+  {
+    double *scan = &result.kScan[(k - 1) * (nTargets + 1)];
+    
+    double margin = 0.0;
+    unsigned int n = 0;
+    
+    for (unsigned int i = 0; i < nTargets; i++)
+    {
+      if (not run.getFlagTestingTarget (i)) continue;
+      
+      scan[i] = ranking.getScore (i, k);
+      
+      margin += ranking.getMargin (i, k) * ranking.getNSamples (i);
+      n += ranking.getNSamples (i);
+    }
+    
+    scan[nTargets] = n > 0 ? margin / n : 0.0;
+  }
   
-  // load sample from ana files with options specified by user
-  loadSamples (testingSamples, learningSamples, userOptions);
+  for (unsigned int i = 0; i < nTargets; i++)
+    for (unsigned int j = 0; j < nTargets; j++)
+      result.confusion[i][j] =
+        ranking.getConfusion (i, j, run.getNeighbors());
+}
+
+/*! <ul>
+ *  <li> save entries of all runs in group
+ *  <li> count votes once per vote (for the largest k of the group), so
+ *  runs which differ only by k share the work
+ *  <li> save given scores of each run (and k scan if requested)
+ *  </ul>
+ */
+void getScores (RecoTargetSampleHandler **testingSamples,
+                const RunGroup &group,
+                const vector <RecoTargetUserOptions> &runs,
+                const unsigned int *nEntries,
+                vector <RunResult> &results,
+                const Scores &scores = &RunResult::scores)
+{
+  RecoTargetRanking *rankings[nVotes] = {NULL};
+  
+  for (unsigned int r = 0; r < group.runs.size(); r++)
+  {
+    const RecoTargetUserOptions &run = runs[group.runs[r]];
+    RunResult &result = results[group.runs[r]];
+    
+    for (unsigned int i = 0; i < nTargets; i++)
+      if (run.getFlagTestingTarget (i) or run.getFlagLearningTarget (i))
+        result.nEntries[i] = nEntries[i];
+    
+    const Vote vote = (Vote) run.getVote();
+    
+    if (not rankings[vote])
+    {
+      rankings[vote] = new RecoTargetRanking
+        (group.options.getMaxNeighbors(), vote);
+      
+      for (unsigned int i = 0; i < nTargets; i++)
+        if (testingSamples[i] and group.options.getFlagTestingTarget (i))
+          rankings[vote]->add (testingSamples[i], i);
+    }
+    
+    for (unsigned int i = 0; i < nTargets; i++)
+      if (run.getFlagTestingTarget (i))
+        (result.*scores)[i] = rankings[vote]->getScore
+          (i, run.getNeighbors());
+    
+    if (scores == &RunResult::scores and run.getFlagKScan())
+      getKScan (*rankings[vote], run, result);
+  }
+  
+  for (unsigned int v = 0; v < nVotes; v++) delete rankings[v];
+}
+
+//! print the number of entries found for each target
+void printEntries (const unsigned int *nEntries)
+{
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (nEntries[i] > 0)
+      cout << "Target " << i + 1 << ": " << nEntries[i]
+           << " entries available\n";
+}
+
+//! print scores and margins for every k, and confusion matrix for k
+void printKScan (const RecoTargetUserOptions &userOptions,
+                 const RunResult &result)
+{
+  if (result.kScan.empty()) return;
+  
+  const unsigned int kMax = result.kScan.size() / (nTargets + 1);
+  
+  cout << "\nScores for k = 1 .. " << kMax << " ("
+       << listOfVotes[userOptions.getVote()] << "):\n\n";
+  
+  cout << "    k";
   
-  // loop over samples, check if it is selected and fill neighbors  
   for (unsigned int i = 0; i < nTargets; i++)
     if (userOptions.getFlagTestingTarget (i))
-      for (unsigned int j = 0; j < nTargets; j++)
-        if (userOptions.getFlagLearningTarget (j))
-          testingSamples[i]->fillNeighbors
-            (learningSamples[j], j, (Metric)userOptions.getMetric());
+      cout << "  target " << i + 1;
+  
+  cout << "    margin\n";
+  
+  for (unsigned int k = 1; k <= kMax; k++)
+  {
+    const double *scan = &result.kScan[(k - 1) * (nTargets + 1)];
+    
+    cout << std::setw (5) << k;
+    
+    for (unsigned int i = 0; i < nTargets; i++)
+      if (userOptions.getFlagTestingTarget (i))
+        cout << std::setw (10) << scan[i];
+    
+    cout << std::setw (10) << scan[nTargets] << "\n";
+  }
+  
+  cout << "\nConfusion matrix for k = " << userOptions.getNeighbors()
+       << " (rows: true target, columns: predicted):\n\n";
+       
+  cout << "     ";
+  
+  for (unsigned int j = 0; j < nTargets; j++) cout << std::setw (7) << j + 1;
+  
+  cout << "\n";
   
   for (unsigned int i = 0; i < nTargets; i++)
-    cout << "Target " << i + 1 << " -> "
-         << testingSamples[i]->getScore (i, userOptions.getNeighbors())
-         << "\n";
+  {
+    if (not userOptions.getFlagTestingTarget (i)) continue;
+    
+    cout << std::setw (5) << i + 1;
+    
+    for (unsigned int j = 0; j < nTargets; j++)
+      cout << std::setw (7) << result.confusion[i][j];
+      
+    cout << "\n";
+  }
+}
+
+//! print score for each selected testing target (and difference to
+//! double precision if quantized, and to full learning set if reduced)
+void printScores (const RecoTargetUserOptions &userOptions,
+                  const RunResult &result)
+{
+  const Precision precision = (Precision) userOptions.getPrecision();
+  
+  const char *reducedPath = userOptions.getReducedPath();
+  
+  if (result.nFull > 0)
+    cout << "Reduced learning set: " << result.nReduced << " of "
+         << result.nFull << " samples ("
+         << 100.0 * result.nReduced / result.nFull << "%)\n";
+  else if (reducedPath and access (reducedPath, F_OK) == 0)
+  {
+    cout << "Learning samples read from " << reducedPath;
+    
+    if (result.nReduced > 0) cout << " (" << result.nReduced << ")";
+    
+    cout << "\n";
+  }
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    if (not userOptions.getFlagTestingTarget (i)) continue;
+    
+    const double score = result.scores[i];
+    
+    cout << "Target " << i + 1 << " -> " << score;
+    
+    if (precision != DOUBLE)
+      cout << " (" << listOfPrecisions[DOUBLE] << ": "
+           << result.referenceScores[i] << ", difference: "
+           << score - result.referenceScores[i] << ")";
+    
+    if (result.nFull > 0)
+      cout << " (full learning set: " << result.fullScores[i]
+           << ", difference: " << score - result.fullScores[i] << ")";
+           
+    cout << "\n";
+  }
+}
+
+/*! <ul>
+ *  <li> load neighbors of group from cache (also double precision ones
+ *  if quantized, as they are needed for reference scores)
+ *  <li> return false if any is missing
+ *  <li> otherwise save entries and scores as if they were computed
+ *  </ul>
+ */
+bool loadCached (const RunGroup &group,
+                 const vector <RecoTargetUserOptions> &runs,
+                 vector <RunResult> &results)
+{
+  const Precision precision = (Precision) group.options.getPrecision();
+  
+  RecoTargetSampleHandler *testingSamples[nTargets] = {NULL};
+  RecoTargetSampleHandler *referenceSamples[nTargets] = {NULL};
+  
+  const SamplesGuard guard (testingSamples, referenceSamples);
+  
+  unsigned int nEntries[nTargets] = {0};
+  
+  bool isCached = group.cache->load (precision, testingSamples, nEntries);
+  
+  if (isCached and precision != DOUBLE)
+    isCached = group.cache->load (DOUBLE, referenceSamples, nEntries);
+    
+  if (isCached)
+  {
+    getScores (testingSamples, group, runs, nEntries, results);
+    
+    if (precision != DOUBLE)
+      getScores (referenceSamples, group, runs, nEntries, results,
+                 &RunResult::referenceScores);
+  }
+  
+  return isCached;
+}
+
+/*! <ul>
+ *  <li> load samples once for the first group not done yet and all
+ *  other groups which use the same samples (out-of-core: only testing
+ *  ones, learning samples are read chunk by chunk for each fill)
+ *  <li> if learning samples are reduced: fill neighbors and save scores
+ *  with full learning set first, then reduce (and save reduced set)
+ *  <li> fill neighbors and save scores group by group
+ *  <li> repeat with double precision to see what was lost
+ *  </ul>
+ */
+void compute (vector <RunGroup> &groups, const unsigned int first,
+              const vector <RecoTargetUserOptions> &runs,
+              RecoTargetCommunicator *communicator,
+              RecoTargetScheduler &scheduler,
+              RecoTargetProfiler *profiler,
+              vector <RunResult> &results)
+{
+  const unsigned int rank = communicator ? communicator->getRank() : 0;
+  const unsigned int nRanks = communicator ? communicator->getSize() : 1;
+  
+  // groups sharing samples, and options to load samples for all of them
+  vector <RunGroup*> shared;
+  RecoTargetUserOptions userOptions (groups[first].options);
+  
+  for (unsigned int g = first; g < groups.size(); g++)
+    if (not groups[g].isDone and
+        groups[g].options.isSameSamples (groups[first].options))
+    {
+      shared.push_back (&groups[g]);
+      userOptions.merge (groups[g].options);
+    }
+  
+  // arrays for testing and learning samples
+  RecoTargetSampleHandler *testingSamples[nTargets] = {NULL};
+  RecoTargetSampleHandler *learningSamples[nTargets] = {NULL};
+  
+  // handlers are deleted on every exit (also if anything throws)
+  const SamplesGuard guard (testingSamples, learningSamples);
+  
+  // the number of entries found for each target
+  unsigned int nEntries[nTargets] = {0};
+  
+  const Precision precision = (Precision) userOptions.getPrecision();
+  
+  // pipeline fills neighbors while testing samples are read (single run)
+  const bool isPipeline = userOptions.getFlagPipeline();
+  
+  // learning samples read chunk by chunk for each fill (out-of-core)
+  std::unique_ptr <RecoTargetStream> stream;
+  
+  // precision of learning chunks being read (double in the last pass)
+  Precision chunkPrecision = precision;
+  
+  if (isPipeline)
+  {
+    // learning samples first, then classify testing ones while reading
+    loadSamples (NULL, learningSamples, userOptions, rank, nRanks,
+                 nEntries, NULL, profiler);
+    
+    useFeatures (learningSamples, userOptions);
+    useRegion (learningSamples, getRegion (learningSamples, userOptions));
+    quantize (learningSamples, precision);
+    index (learningSamples, shared);
+    
+    // testing samples get region of learning ones batch by batch
+    RecoTargetPipeline pipeline (learningSamples, userOptions,
+                                 userOptions.getNThreads(), profiler);
+    
+    loadSamples (testingSamples, NULL, userOptions, rank, nRanks,
+                 nEntries, &pipeline, profiler);
+    
+    pipeline.finish();
+    
+    if (communicator)
+      reduceNeighbors (testingSamples, communicator,
+                       userOptions.getMaxNeighbors());
+  }
+  else if (userOptions.getChunkSize() > 0)
+  {
+    // only testing samples stay in memory
+    loadSamples (testingSamples, NULL, userOptions, rank, nRanks,
+                 nEntries, NULL, profiler);
+    
+    // region is not chosen by importance, so no learning sample is needed
+    const vector <unsigned int> planes =
+      getRegion (learningSamples, userOptions);
+    
+    useFeatures (testingSamples, userOptions);
+    useRegion (testingSamples, planes);
+    quantize (testingSamples, precision);
+    
+    // shard of this rank is split into chunks (shards of shards), the
+    // largest planned shard has at most chunk size entries per chunk
+    const unsigned int nShardEntries =
+      (maxLearningEntries (userOptions) + nRanks - 1) / nRanks;
+    const unsigned int nChunks = std::max (1u,
+      (nShardEntries + userOptions.getChunkSize() - 1) /
+      userOptions.getChunkSize());
+    
+    stream.reset (new RecoTargetStream (nChunks,
+      [&, nChunks, planes] (RecoTargetSampleHandler **chunk,
+                            const unsigned int &c)
+      {
+        loadSamples (NULL, chunk, userOptions, rank * nChunks + c,
+                     nRanks * nChunks, nEntries, NULL, profiler);
+        
+        useFeatures (chunk, userOptions);
+        useRegion (chunk, planes);
+        quantize (chunk, chunkPrecision);
+        index (chunk, shared);
+      }));
+  }
+  else
+  {
+    const bool isReduced = userOptions.getReducedPath() and
+                           not isReducing (userOptions);
+    
+    // leave-one-out: only learning samples are loaded
+    const bool isLoo = userOptions.getFlagLoo();
+    
+    // load sample from ana files with options specified by user
+    loadSamples (isLoo ? NULL : testingSamples,
+                 isReduced ? NULL : learningSamples,
+                 userOptions, rank, nRanks, nEntries, NULL, profiler);
+    
+    for (unsigned int i = 0; i < nTargets and isLoo; i++)
+      if (userOptions.getFlagTestingTarget (i))
+        testingSamples[i] = learningSamples[i];
+    
+    // or learning samples from reduced set saved before
+    if (isReduced)
+    {
+      bool isLearningTarget[nTargets];
+      
+      for (unsigned int i = 0; i < nTargets; i++)
+        isLearningTarget[i] = userOptions.getFlagLearningTarget (i);
+      
+      RecoTargetReduction::load (learningSamples, isLearningTarget,
+                                 userOptions.getFlagFeatures(),
+                                 userOptions.getReducedPath());
+    }
+    
+    useFeatures (testingSamples, userOptions);
+    useFeatures (learningSamples, userOptions);
+    
+    // planes chosen by importance are the same for both
+    const vector <unsigned int> planes =
+      getRegion (learningSamples, userOptions);
+    
+    useRegion (testingSamples, planes);
+    useRegion (learningSamples, planes);
+    
+    quantize (testingSamples, precision);
+    quantize (learningSamples, precision);
+    index (learningSamples, shared);
+  }
+  
+  if (isReducing (userOptions))
+  {
+    // scores with full learning set show what reduction costs
+    for (unsigned int g = 0; g < shared.size(); g++)
+    {
+      for (unsigned int i = 0; i < nTargets; i++)
+        if (testingSamples[i]) testingSamples[i]->clearNeighbors();
+      
+      fillNeighbors (testingSamples, learningSamples, shared[g]->options,
+                     communicator, scheduler, stream.get());
+      
+      if (rank == 0)
+        getScores (testingSamples, *shared[g], runs, nEntries, results,
+                   &RunResult::fullScores);
+    }
+    
+    RecoTargetReduction reduction
+      ((Reduction) userOptions.getReduction(),
+       (Metric) userOptions.getMetric(), userOptions.getSeed());
+    
+    reduction.reduce (learningSamples);
+    
+    if (userOptions.getReducedPath())
+      RecoTargetReduction::save (learningSamples,
+                                 userOptions.getReducedPath());
+    
+    quantize (learningSamples, precision);
+    index (learningSamples, shared);
+    
+    for (unsigned int g = 0; g < shared.size(); g++)
+      for (unsigned int r = 0; r < shared[g]->runs.size(); r++)
+      {
+        results[shared[g]->runs[r]].nFull = reduction.getNFull();
+        results[shared[g]->runs[r]].nReduced = reduction.getNReduced();
+      }
+  }
+  else
+    for (unsigned int g = 0; g < shared.size(); g++)
+      for (unsigned int r = 0; r < shared[g]->runs.size(); r++)
+        results[shared[g]->runs[r]].nReduced = nSamples (learningSamples);
+  
+  const Precision passes[] = {precision, DOUBLE};
+  const unsigned int nPasses = precision == DOUBLE ? 1 : 2;
+  
+  for (unsigned int p = 0; p < nPasses; p++)
+  {
+    // repeat with double precision to see what was lost
+    if (p > 0)
+    {
+      quantize (testingSamples, DOUBLE);
+      quantize (learningSamples, DOUBLE);
+      chunkPrecision = DOUBLE;
+    }
+    
+    for (unsigned int g = 0; g < shared.size(); g++)
+    {
+      if (p > 0 or not isPipeline)
+      {
+        for (unsigned int i = 0; i < nTargets; i++)
+          if (testingSamples[i]) testingSamples[i]->clearNeighbors();
+        
+        fillNeighbors (testingSamples, learningSamples, shared[g]->options,
+                       communicator, scheduler, stream.get());
+      }
+      
+      if (rank > 0) continue;
+      
+      getScores (testingSamples, *shared[g], runs, nEntries, results,
+                 p > 0 ? &RunResult::referenceScores : &RunResult::scores);
+      
+      if (shared[g]->cache)
+        shared[g]->cache->save (passes[p], testingSamples, nEntries);
+    }
+  }
+  
+  for (unsigned int g = 0; g < shared.size(); g++) shared[g]->isDone = true;
+}
+
+/*! <ul>
+ *  <li> load learning samples once (as for pipeline); if quantized,
+ *  only their quantized copy is kept
+ *  <li> classify events from input of run until it is closed, write
+ *  predictions to stdout micro-batch by micro-batch
+ *  </ul>
+ */
+void serve (const RecoTargetUserOptions &userOptions,
+            RecoTargetScheduler &scheduler)
+{
+  const char *path = userOptions.getServePath();
+  
+  const int input = strcmp (path, "-") ? open (path, O_RDONLY) :
+                                         STDIN_FILENO;
+  
+  if (input < 0)
+    throw Exception (BAD_FILE, std::string ("can not open ") + path);
+  
+  RecoTargetSampleHandler *learningSamples[nTargets] = {NULL};
+  
+  const SamplesGuard guard (NULL, learningSamples);
+  
+  loadSamples (NULL, learningSamples, userOptions);
+  
+  useFeatures (learningSamples, userOptions);
+  useRegion (learningSamples, getRegion (learningSamples, userOptions));
+  quantize (learningSamples, (Precision) userOptions.getPrecision());
+  
+  RunGroup group (userOptions);
+  index (learningSamples, vector <RunGroup*> (1, &group));
+  
+  // no double pass when serving: quantized copy is enough
+  if (userOptions.getPrecision() != DOUBLE)
+    for (unsigned int i = 0; i < nTargets; i++)
+      if (learningSamples[i]) learningSamples[i]->dropDistributions();
+  
+  {
+    RecoTargetServer server (learningSamples, userOptions, scheduler);
+    server.run (input, cout, userOptions.getFlagBinary());
+  }
+  
+  if (input != STDIN_FILENO) close (input);
+}
+
+//! run kNN for all runs requested by user
+void run (int argc, char *argv[])
+{
+  // parse user's command arguments (or batch file)
+  const vector <RecoTargetUserOptions> runs =
+    RecoTargetUserOptions (argc, argv).getRuns();
+  
+  // threads, ranks and cache are the same for all runs
+  const RecoTargetUserOptions &userOptions = runs.front();
+  
+  // compare engines on synthetic events instead of reading files
+  if (userOptions.getFlagValidate())
+  {
+    RecoTargetValidation validation (userOptions);
+    
+    if (validation.run (cout) > 0)
+      throw Exception (FAILED_CHECK, "engines differ from reference");
+    
+    return;
+  }
+  
+  // classify events from input instead of testing samples (nothing
+  // else is printed to stdout, it is left for predictions)
+  if (userOptions.getServePath())
+  {
+    RecoTargetScheduler scheduler (userOptions.getNThreads());
+    
+    serve (userOptions, scheduler);
+    
+    return;
+  }
+  
+  vector <RunGroup> groups = groupRuns (runs);
+  vector <RunResult> results (runs.size(), RunResult());
+  
+  // the same configurations may be already done: only recompute scores
+  bool isDone = true;
+  
+  for (unsigned int g = 0; g < groups.size(); g++)
+  {
+    // reduction is compared to full learning set, which is not cached
+    if (userOptions.getCachePath() and not isReducing (groups[g].options))
+    {
+      groups[g].cache = new RecoTargetCache (groups[g].options);
+      groups[g].isDone = loadCached (groups[g], runs, results);
+    }
+    
+    isDone = isDone and groups[g].isDone;
+  }
+  
+  // start other ranks (if requested), each loads its learning shard
+  RecoTargetCommunicator *communicator =
+    isDone ? NULL : createCommunicator (userOptions.getNRanks());
+    
+  const unsigned int rank = communicator ? communicator->getRank() : 0;
+  
+  // hardware counters around fill and distances (if requested)
+  RecoTargetProfiler *profiler =
+    userOptions.getFlagProfile() ? new RecoTargetProfiler : NULL;
+  
+  // threads share (testing x learning) blocks
+  RecoTargetScheduler scheduler (userOptions.getNThreads(), profiler);
+  
+  for (unsigned int g = 0; g < groups.size(); g++)
+    if (not groups[g].isDone)
+      compute (groups, g, runs, communicator, scheduler, profiler,
+               results);
+  
+  for (unsigned int r = 0; r < runs.size() and rank == 0; r++)
+  {
+    if (runs.size() > 1) cout << "\n" << runs[r].getName() << ":\n";
+    
+    printEntries (results[r].nEntries);
+    printScores (runs[r], results[r]);
+    printKScan (runs[r], results[r]);
+  }
+  
+  // how many distances were not computed thanks to index (this rank)
+  if (rank == 0 and scheduler.getNSkipped() > 0)
+    cout << "Skipped " << scheduler.getNSkipped() << " of "
+         << scheduler.getNCandidates() << " distances ("
+         << 100.0 * scheduler.getNSkipped() / scheduler.getNCandidates()
+         << "%)\n";
+  
+  // counts of this rank, per phase and thread
+  if (rank == 0 and profiler) profiler->print (cout);
+  
+  for (unsigned int g = 0; g < groups.size(); g++) delete groups[g].cache;
+  
+  delete profiler;
+  
+  delete communicator;
+}
+
+int main (int argc, char *argv[])
+{
+  try
+  {
+    run (argc, argv);
+  }
+  catch (const Exception &e)
+  {
+    if (e.what()[0] != '\0') cerr << "\nERROR: " << e.what() << "\n\n";
+    return e.getCode();
+  }
       
   return 0;
 }
@@ -0,0 +1,248 @@
+#include "RecoTargetCache.h"
+#include "RecoTargetUtils.h"
+#include "RecoTargetException.h"
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <vector>
+#include <glob.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace RecoTarget;
+
+namespace
+{
+  const uint64_t cacheMagic = 0x3130484341435452ull; //!< "RTCACH01"
+  
+  //! FNV-1a hash of a string
+  uint64_t hash (const std::string &text)
+  {
+    uint64_t h = 0xcbf29ce484222325ull;
+    
+    for (size_t i = 0; i < text.size(); i++)
+    {
+      h ^= (unsigned char) text[i];
+      h *= 0x100000001b3ull;
+    }
+    
+    return h;
+  }
+  
+  //! append name, size and mtime of files matching pattern
+  void describeFiles (const std::string &pattern, std::ostringstream &text)
+  {
+    glob_t files;
+    
+    if (glob (pattern.c_str(), 0, NULL, &files) == 0)
+      for (size_t i = 0; i < files.gl_pathc; i++)
+      {
+        struct stat status;
+        
+        if (stat (files.gl_pathv[i], &status) != 0) continue;
+        
+        text << files.gl_pathv[i] << ' ' << status.st_size << ' '
+             << status.st_mtime << '\n';
+      }
+      
+    globfree (&files);
+  }
+  
+  //! copy n bytes from cursor (false if it would read behind end)
+  bool readBytes (const char *&cursor, const char *end, void *data,
+                  const size_t &n)
+  {
+    if ((size_t) (end - cursor) < n) return false;
+    
+    memcpy (data, cursor, n);
+    cursor += n;
+    
+    return true;
+  }
+}
+
+/*! <ul>
+ *  <li> describe all options which can change neighbors
+ *  <li> describe input files of all selected targets (and event
+ *  stores, if used)
+ *  <li> hash the description
+ *  </ul>
+ */
+RecoTargetCache :: RecoTargetCache (const RecoTargetUserOptions &userOptions)
+  : userOptions (userOptions)
+{
+  std::ostringstream text;
+  
+  text << RECO_TARGET_VERSION << '\n'
+       << userOptions.getPath() << '\n'
+       << userOptions.getNTestingSamples() << ' '
+       << userOptions.getNLearningSamples() << ' '
+       << userOptions.getMetric() << ' '
+       << userOptions.getSelection() << ' '
+       << userOptions.getSeed() << ' '
+       << userOptions.getFlagFeatures() << ' '
+       << userOptions.getFlagCompressed() << ' '
+       << userOptions.getFlagLoo() << ' '
+       << userOptions.getReduction() << '\n';
+  
+  // region of interest (key of runs with all planes does not change)
+  if (userOptions.getRegion())
+    text << userOptions.getRegion() << '\n';
+  
+  // reduced learning set read from file (if it exists)
+  if (userOptions.getReducedPath())
+    describeFiles (userOptions.getReducedPath(), text);
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    text << userOptions.getFlagTestingTarget (i)
+         << userOptions.getFlagLearningTarget (i) << '\n';
+    
+    if (not (userOptions.getFlagTestingTarget (i) or
+             userOptions.getFlagLearningTarget (i))) continue;
+             
+    describeFiles (mergeChar (userOptions.getPath(), targetSubpath (i)),
+                   text);
+                   
+    if (userOptions.getStorePath())
+      describeFiles (std::string (userOptions.getStorePath()) + 
+                     "/target0" + char ('1' + i) + ".store", text);
+  }
+  
+  key = hash (text.str());
+}
+
+//! cacheDir/key-precision.cache
+std::string RecoTargetCache :: fileName (const Precision &precision) const
+{
+  char name[64];
+  
+  snprintf (name, sizeof (name), "/%016llx-%u.cache",
+            (unsigned long long) key, (unsigned int) precision);
+  
+  return userOptions.getCachePath() + std::string (name);
+}
+
+/*! file layout:
+ *  <ul>
+ *  <li> magic, key, kmax (uint64 each)
+ *  <li> per target: number of entries, number of testing samples
+ *  (uint32 each)
+ *  <li> neighbors of all testing samples (as packNeighbors writes them)
+ *  </ul>
+ *  <ul>
+ *  <li> read whole file, check header and kmax >= k
+ *  <li> check sizes of all lists before anything is created
+ *  <li> create testing samples and merge their (only) list
+ *  </ul>
+ */
+bool RecoTargetCache :: load (const Precision &precision,
+                              RecoTargetSampleHandler **testingSamples,
+                              unsigned int *nEntries) const
+{
+  FILE *file = fopen (fileName (precision).c_str(), "rb");
+  
+  if (not file) return false;
+  
+  std::vector <char> data;
+  char buffer[65536];
+  size_t n;
+  
+  while ((n = fread (buffer, 1, sizeof (buffer), file)) > 0)
+    data.insert (data.end(), buffer, buffer + n);
+    
+  fclose (file);
+  
+  const char *cursor = data.data();
+  const char *end = cursor + data.size();
+  
+  uint64_t header[3]; // magic, key, kmax
+  uint32_t counts[nTargets][2]; // entries, testing samples
+  
+  if (not readBytes (cursor, end, header, sizeof (header)) or
+      not readBytes (cursor, end, counts, sizeof (counts)) or
+      header[0] != cacheMagic or header[1] != key or
+      // lists must hold kmax of this run (kscan, votes of merged runs)
+      header[2] < userOptions.getMaxNeighbors()) return false;
+      
+  // walk through all lists to make sure file is complete
+  const char *lists = cursor;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    for (uint32_t s = 0; s < counts[i][1]; s++)
+    {
+      uint32_t nNeighbors;
+      
+      if (not readBytes (cursor, end, &nNeighbors, sizeof (nNeighbors)) or
+          (size_t) (end - cursor) < nNeighbors * sizeof (Neighbor))
+        return false;
+        
+      cursor += nNeighbors * sizeof (Neighbor);
+    }
+    
+  if (cursor != end) return false;
+  
+  std::vector <const char*> cursors (1, lists);
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    nEntries[i] = counts[i][0];
+    
+    if (not userOptions.getFlagTestingTarget (i)) continue;
+    
+    testingSamples[i] = new RecoTargetSampleHandler (counts[i][1]);
+    testingSamples[i]->mergeNeighbors (cursors, header[2]);
+  }
+  
+  return true;
+}
+
+//! write to temporary file and rename it (as event store does)
+void RecoTargetCache :: save (const Precision &precision,
+                              RecoTargetSampleHandler **testingSamples,
+                              const unsigned int *nEntries) const
+{
+  const uint64_t kMax = userOptions.getMaxNeighbors();
+  const uint64_t header[3] = {cacheMagic, key, kMax};
+  
+  uint32_t counts[nTargets][2];
+  std::vector <char> lists;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    counts[i][0] = nEntries[i];
+    counts[i][1] = 0;
+    
+    if (not (userOptions.getFlagTestingTarget (i) and testingSamples[i]))
+      continue;
+      
+    counts[i][1] = testingSamples[i]->getNSamples();
+    
+    testingSamples[i]->keepNearest (kMax);
+    testingSamples[i]->packNeighbors (lists);
+  }
+  
+  const std::string name = fileName (precision);
+  
+  char suffix[32];
+  snprintf (suffix, sizeof (suffix), ".tmp%d", (int) getpid());
+  
+  const std::string tmpName = name + suffix;
+  
+  FILE *file = fopen (tmpName.c_str(), "wb");
+  
+  if (not file)
+    throw Exception (BAD_FILE, "can not create " + tmpName);
+  
+  const bool isWritten =
+    fwrite (header, sizeof (header), 1, file) == 1 and
+    fwrite (counts, sizeof (counts), 1, file) == 1 and
+    (lists.empty() or fwrite (lists.data(), lists.size(), 1, file) == 1);
+  
+  if (fclose (file) != 0 or not isWritten or
+      rename (tmpName.c_str(), name.c_str()) != 0)
+  {
+    remove (tmpName.c_str());
+    throw Exception (BAD_FILE, "can not write " + name);
+  }
+}
@@ -0,0 +1,64 @@
+/**
+ * @brief Cache of nearest neighbors keyed by inputs and configuration
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_CACHE_H
+#define RECO_TARGET_CACHE_H
+
+#include "RecoTargetSampleHandler.h"
+#include "RecoTargetUserOptions.h"
+#include <string>
+#include <stdint.h>
+
+//! code version in cache key: set -DRECO_TARGET_VERSION=\"`git describe
+//! --always --dirty`\" when building (all files); without it results of
+//! different code can not be told apart, so --cache is rejected
+#ifndef RECO_TARGET_VERSION
+#define RECO_TARGET_VERSION ""
+#endif
+
+/*! cache directory keeps one file per configuration:
+ *  <ul>
+ *  <li> file name = hash of code version, input files (name, size,
+ *  mtime) and all options which change neighbors, + precision
+ *  <li> k and vote are not in the key: top-kmax neighbors of each
+ *  testing sample are stored, so scores for any k <= kmax and any vote
+ *  are recomputed from them
+ *  <li> threads, pipeline, ranks do not change results, so any of them
+ *  can read what the other has written
+ *  </ul>
+ */
+class RecoTargetCache
+{
+  public:
+  
+  //! constructor (compute key; lists input files)
+  RecoTargetCache (const RecoTargetUserOptions &userOptions);
+  
+  //! create testing samples (without distributions) with neighbors
+  //! from cache; return false if there is no entry with enough
+  //! neighbors (nothing is created then)
+  bool load (const RecoTarget::Precision &precision,
+             RecoTargetSampleHandler **testingSamples,
+             unsigned int *nEntries) const;
+  
+  //! save top-kmax neighbors of selected testing samples
+  void save (const RecoTarget::Precision &precision,
+             RecoTargetSampleHandler **testingSamples,
+             const unsigned int *nEntries) const;
+  
+  private:
+  
+  const RecoTargetUserOptions &userOptions; //!< what was asked for
+  
+  uint64_t key; //!< hash of everything but precision
+  
+  //! return cache file for given precision
+  std::string fileName (const RecoTarget::Precision &precision) const;
+};
+
+#endif
@@ -0,0 +1,406 @@
+#include "RecoTargetClassifier.h"
+#include "RecoTargetUtils.h"
+#include "RecoTargetException.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace RECOTRACKS_ANA;
+using namespace RecoTarget;
+
+/*! <ul>
+ *  <li> loop over selected targets
+ *  <li> load RecoTracks from "path/00/00/00/0#TARGET"
+ *  <li> create learning sample the same way as RecoTarget does
+ *  </ul>
+ */
+RecoTargetClassifier :: RecoTargetClassifier
+  (const char *pathToFiles, const bool *isLearningTarget,
+   const unsigned int &nLearningSamples, const Metric &metric,
+   const unsigned int &k, const Vote &vote, const bool &earlyExit)
+  : metric (metric), nNeighbors (k), vote (vote), earlyExit (earlyExit),
+    ownsSamples (true)
+{
+  for (unsigned int i = 0; i < nTargets; i++) learningSamples[i] = NULL;
+  
+  try
+  {
+    for (unsigned int i = 0; i < nTargets; i++)
+    {
+      if (not isLearningTarget[i]) continue;
+      
+      RecoTracks *recoTracks =
+        loadFiles (mergeChar (pathToFiles, targetSubpath (i)).c_str());
+      
+      try
+      {
+        learningSamples[i] = createSample (recoTracks, nLearningSamples, 0);
+      }
+      catch (...)
+      {
+        closeFiles (recoTracks);
+        throw;
+      }
+      
+      closeFiles (recoTracks);
+    }
+    
+    checkSetup();
+    sortByNorm();
+  }
+  catch (...)
+  {
+    for (unsigned int i = 0; i < nTargets; i++) delete learningSamples[i];
+    throw;
+  }
+}
+
+RecoTargetClassifier :: RecoTargetClassifier
+  (RecoTargetSampleHandler **learningSamples, const Metric &metric,
+   const unsigned int &k, const Vote &vote, const bool &earlyExit)
+  : metric (metric), nNeighbors (k), vote (vote), earlyExit (earlyExit),
+    ownsSamples (false)
+{
+  for (unsigned int i = 0; i < nTargets; i++)
+    this->learningSamples[i] = learningSamples[i];
+    
+  checkSetup();
+  sortByNorm();
+}
+
+RecoTargetClassifier :: ~RecoTargetClassifier ()
+{
+  if (ownsSamples)
+    for (unsigned int i = 0; i < nTargets; i++) delete learningSamples[i];
+}
+
+/*! <ul>
+ *  <li> metric must be defined, k > 0 and there must be k learning
+ *  samples
+ *  <li> learning samples must keep double distributions (events are
+ *  compared in double) and all of them the same planes and features
+ *  (events are converted as they are)
+ *  </ul>
+ */
+void RecoTargetClassifier :: checkSetup () const
+{
+  if ((unsigned int) metric >= nMetrics)
+    throw Exception (UNDEFINED_METRIC, "undefined metric");
+  
+  if ((unsigned int) vote >= nVotes)
+    throw Exception (BAD_ARGUMENT, "undefined vote");
+  
+  if (nNeighbors == 0)
+    throw Exception (BAD_ARGUMENT, "k must be positive");
+  
+  unsigned int nLearning = 0; // total number of learning samples
+  
+  const RecoTargetSampleHandler *first = NULL; // the first one used
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    if (not learningSamples[i]) continue;
+    
+    learningSamples[i]->checkDistributions();
+    
+    if (not first) first = learningSamples[i];
+    
+    if (learningSamples[i]->isFeatures != first->isFeatures or
+        learningSamples[i]->region != first->region)
+      throw Exception (BAD_ARGUMENT, "learning samples of targets keep "
+                       "different planes or features");
+    
+    nLearning += learningSamples[i]->nSamples;
+  }
+  
+  if (nLearning < nNeighbors)
+    throw Exception (BAD_ARGUMENT, "less learning samples than k");
+}
+
+//! norm is a lower bound for Euclidean distance only
+void RecoTargetClassifier :: sortByNorm ()
+{
+  if (not earlyExit or metric != EUCLIDEAN) return;
+  
+  for (unsigned int j = 0; j < nTargets; j++)
+    if (learningSamples[j]) indexSamples (j, 0);
+}
+
+/*! <ul>
+ *  <li> calculate norms of new samples only and sort them
+ *  <li> merge them with already sorted ones
+ *  </ul>
+ */
+void RecoTargetClassifier :: indexSamples (const unsigned int &target,
+                                           const unsigned int &fromId)
+{
+  if (not earlyExit or metric != EUCLIDEAN) return;
+  
+  const RecoTargetSampleHandler *learning = learningSamples[target];
+  
+  // <norm, id> of new samples
+  std::vector < std::pair <double, unsigned int> > added;
+  
+  for (unsigned int id = std::max (fromId, learning->firstId);
+       id < learning->getNextId(); id++)
+    added.push_back (std::make_pair
+      (learning->samples[id - learning->firstId].norm(), id));
+      
+  std::sort (added.begin(), added.end());
+  
+  std::vector <double> mergedNorms;
+  std::vector < std::pair <unsigned int, unsigned int> > merged;
+  
+  mergedNorms.reserve (norms.size() + added.size());
+  merged.reserve (norms.size() + added.size());
+  
+  for (size_t i = 0, a = 0; i < norms.size() or a < added.size(); )
+    if (a == added.size() or (i < norms.size() and
+                              norms[i] <= added[a].first))
+    {
+      mergedNorms.push_back (norms[i]);
+      merged.push_back (sortedSamples[i++]);
+    }
+    else
+    {
+      mergedNorms.push_back (added[a].first);
+      merged.push_back (std::make_pair (target, added[a++].second));
+    }
+    
+  norms.swap (mergedNorms);
+  sortedSamples.swap (merged);
+}
+
+//! keep order of the rest (no sorting needed)
+void RecoTargetClassifier :: unindexSamples (const unsigned int &target)
+{
+  const unsigned int firstId = learningSamples[target]->firstId;
+  
+  size_t nKept = 0;
+  
+  for (size_t i = 0; i < norms.size(); i++)
+    if (sortedSamples[i].first != target or
+        sortedSamples[i].second >= firstId)
+    {
+      norms[nKept] = norms[i];
+      sortedSamples[nKept++] = sortedSamples[i];
+    }
+    
+  norms.resize (nKept);
+  sortedSamples.resize (nKept);
+}
+
+//! samples[i] has id = firstId + i
+const RecoTargetSampleHandler::Sample& RecoTargetClassifier :: sortedSample
+  (const size_t &c) const
+{
+  const RecoTargetSampleHandler *learning =
+    learningSamples[sortedSamples[c].first];
+  
+  return learning->samples[sortedSamples[c].second - learning->firstId];
+}
+
+//! append to learning handler, then update the index with new samples
+void RecoTargetClassifier :: appendLearning (const unsigned int &target,
+                                             const Event *events,
+                                             const unsigned int &nEvents)
+{
+  if (target >= nTargets or not learningSamples[target])
+    throw Exception (BAD_ARGUMENT, "target is not used for learning");
+    
+  RecoTargetSampleHandler *learning = learningSamples[target];
+  
+  const unsigned int fromId = learning->getNextId();
+  
+  for (unsigned int i = 0; i < nEvents; i++)
+    learning->appendSample (events[i].planeVisibleEnergy,
+                            events[i].planeId, events[i].nFilledPlanes);
+    
+  indexSamples (target, fromId);
+}
+
+//! retire from learning handler, then remove them from the index
+void RecoTargetClassifier :: retireLearning (const unsigned int &target,
+                                             const unsigned int &n)
+{
+  if (target >= nTargets or not learningSamples[target])
+    throw Exception (BAD_ARGUMENT, "target is not used for learning");
+    
+  learningSamples[target]->retireSamples (n);
+  
+  unindexSamples (target);
+  
+  checkSetup();
+}
+
+/*! <ul>
+ *  <li> start from learning samples with norm closest to sample's one
+ *  <li> take next sample from the side with smaller norm difference
+ *  <li> keep k nearest neighbors in max-heap
+ *  <li> stop if norm difference^2 > k-th distance (squared Euclidean)
+ *  <li> or if majority vote can not be changed anymore
+ *  <li> save k nearest in sample's neighbors list
+ *  </ul>
+ */
+void RecoTargetClassifier :: fillNearestEarlyExit
+  (Workspace &workspace) const
+{
+  RecoTargetSampleHandler::DenseSample &sample = workspace.sample;
+  
+  // max-heap of k nearest neighbors
+  std::vector <Neighbor> &nearest = workspace.nearest;
+  nearest.clear();
+  
+  const double norm = sample.norm();
+  const size_t n = norms.size();
+  
+  // not scanned yet: [0, lo) and [hi, n)
+  size_t hi = std::lower_bound (norms.begin(), norms.end(), norm)
+              - norms.begin();
+  size_t lo = hi;
+  
+  while (lo > 0 or hi < n)
+  {
+    const bool up = lo == 0 or
+                    (hi < n and norms[hi] - norm < norm - norms[lo - 1]);
+    const size_t c = up ? hi++ : --lo; // current candidate
+    
+    // lower bound for the distance (with safety margin for rounding)
+    const double bound = norms[c] - norm;
+    
+    if (nearest.size() == nNeighbors and
+        bound * bound > nearest.front().distance * (1.0 + 1e-12) + 1e-300)
+      break; // all remaining samples are even further
+    
+    const Neighbor neighbor
+      (sample.distance (sortedSample (c), metric),
+       sortedSamples[c].first, sortedSamples[c].second);
+    
+    if (not RecoTargetSampleHandler::pushNearest (nearest, neighbor,
+                                                  nNeighbors)) continue;
+    
+    if (vote == MAJORITY and nearest.size() == nNeighbors and
+        isVoteDecided (nearest, norm, lo, hi)) break;
+  }
+  
+  sample.neighbors.assign (nearest.begin(), nearest.end());
+}
+
+/*! <ul>
+ *  <li> count votes: L = leader, R = runner-up
+ *  <li> count not scanned samples with norm within k-th distance
+ *  (only those may still enter the top-k), m = min (k, count)
+ *  <li> each new neighbor takes at most one vote from leader and gives
+ *  at most one to the other target, so leader stays if L - R > 2m
+ *  </ul>
+ */
+bool RecoTargetClassifier :: isVoteDecided
+  (const std::vector <Neighbor> &nearest,
+   const double &norm, const size_t &lo, const size_t &hi) const
+{
+  unsigned int votes[nTargets] = {0};
+  double kthDistance = 0.0;
+  
+  for (size_t i = 0; i < nearest.size(); i++)
+  {
+    votes[nearest[i].target]++;
+    kthDistance = std::max (kthDistance, nearest[i].distance);
+  }
+  
+  unsigned int leader = 0, runnerUp = 0;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (votes[i] > leader)
+    {
+      runnerUp = leader;
+      leader = votes[i];
+    }
+    else if (votes[i] > runnerUp) runnerUp = votes[i];
+    
+  const double radius = sqrt (kthDistance) * (1.0 + 1e-12) + 1e-150;
+  
+  const size_t below = lo - std::min (lo, (size_t)
+    (std::lower_bound (norms.begin(), norms.end(), norm - radius)
+     - norms.begin()));
+  const size_t above = std::max (hi, (size_t)
+    (std::upper_bound (norms.begin(), norms.end(), norm + radius)
+     - norms.begin())) - hi;
+     
+  const size_t changes = std::min <size_t> (nNeighbors, below + above);
+  
+  return leader - runnerUp > 2 * changes;
+}
+
+/*! <ul>
+ *  <li> fill local sample from event (so it is thread-safe)
+ *  <li> convert it as learning samples are (features, region)
+ *  <li> keep k nearest of all learning samples in max-heap (or scan
+ *  only needed ones if early exit is on)
+ *  <li> return target of k nearest neighbors
+ *  </ul>
+ */
+unsigned int RecoTargetClassifier :: classify (const Event &event,
+                                               Workspace &workspace,
+                                               double *confidence) const
+{
+  RecoTargetSampleHandler::DenseSample &sample = workspace.sample;
+  
+  sample.fill (event.planeVisibleEnergy, event.planeId,
+               event.nFilledPlanes);
+  
+  // compare features with features and planes of region with planes of
+  // region (all learning samples are the same, see checkSetup)
+  for (unsigned int j = 0; j < nTargets; j++)
+    if (learningSamples[j])
+    {
+      if (learningSamples[j]->isFeatures) sample.extractFeatures();
+      
+      if (not learningSamples[j]->region.empty())
+        sample.selectPlanes (learningSamples[j]->region);
+      
+      break;
+    }
+  
+  if (not norms.empty())
+  {
+    fillNearestEarlyExit (workspace);
+    return sample.closestTarget (nNeighbors, vote, confidence);
+  }
+  
+  sample.neighbors.clear();
+  
+  for (unsigned int j = 0; j < nTargets; j++) // loop over targets
+  {
+    if (not learningSamples[j]) continue;
+    
+    const RecoTargetSampleHandler *learning = learningSamples[j];
+    
+    for (unsigned int i = 0; i < learning->nSamples; i++)
+      RecoTargetSampleHandler::pushNearest (sample.neighbors, Neighbor
+        (sample.distance (learning->samples[i], metric), j,
+         learning->firstId + i), nNeighbors);
+  }
+  
+  return sample.closestTarget (nNeighbors, vote, confidence);
+}
+
+//! use temporary workspace
+unsigned int RecoTargetClassifier :: classify (const Event &event,
+                                               double *confidence) const
+{
+  Workspace workspace;
+  
+  return classify (event, workspace, confidence);
+}
+
+//! classify events one by one (with one workspace for all of them)
+void RecoTargetClassifier :: classify (const Event *events,
+                                       const unsigned int &nEvents,
+                                       unsigned int *predictions,
+                                       double *confidences) const
+{
+  Workspace workspace;
+  
+  for (unsigned int i = 0; i < nEvents; i++)
+    predictions[i] = classify (events[i], workspace,
+                               confidences ? confidences + i : NULL);
+}
@@ -0,0 +1,144 @@
+/**
+ * @brief kNN classifier to be used in-process (without RecoTarget main)
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_CLASSIFIER_H
+#define RECO_TARGET_CLASSIFIER_H
+
+#include "RecoTargetSampleHandler.h"
+#include "RecoTargetDetectorProperties.h"
+#include "RecoTargetMetrics.h"
+#include "RecoTargetVoting.h"
+#include <vector>
+
+namespace RecoTarget
+{
+  //! single event as stored in RecoTracks (only non-zero planes)
+  struct Event
+  {
+    const double *planeVisibleEnergy; //!< visible energy per hit plane
+    const int *planeId;               //!< plane id per hit plane
+    unsigned int nFilledPlanes;       //!< number of hit planes
+  };
+}
+
+/*! learning samples are loaded once, then classify() may be called
+ *  concurrently from many threads (it does not modify the classifier)
+ *
+ *  events are converted as learning samples are (features, planes of
+ *  region of interest), so all learning handlers must be the same, and
+ *  they must keep double distributions (not only a quantized copy)
+ *
+ *  with early exit (Euclidean metric only) learning samples are scanned
+ *  in the order of |norm(learning) - norm(testing)|, which is a lower
+ *  bound for the distance, and the scan stops when no remaining sample
+ *  can change the top-k (or the majority vote)
+ */
+class RecoTargetClassifier
+{
+  public:
+  
+  //! constructor (learning samples from ana files, see RecoTargetUtils)
+  RecoTargetClassifier (const char *pathToFiles,
+                        const bool *isLearningTarget,
+                        const unsigned int &nLearningSamples,
+                        const RecoTarget::Metric &metric,
+                        const unsigned int &k,
+                        const RecoTarget::Vote &vote = RecoTarget::MAJORITY,
+                        const bool &earlyExit = false);
+  
+  //! constructor (already loaded learning samples, NULL = not used)
+  RecoTargetClassifier (RecoTargetSampleHandler **learningSamples,
+                        const RecoTarget::Metric &metric,
+                        const unsigned int &k,
+                        const RecoTarget::Vote &vote = RecoTarget::MAJORITY,
+                        const bool &earlyExit = false);
+  
+  ~RecoTargetClassifier (); //!< destructor
+  
+  //! buffers used by classify; keep one per thread and reuse it, so
+  //! classification does not allocate memory in steady state
+  class Workspace
+  {
+    friend class RecoTargetClassifier;
+    
+    RecoTargetSampleHandler::DenseSample sample; //!< event being classified
+    //! k nearest neighbors found so far (early exit)
+    std::vector <RecoTarget::Neighbor> nearest;
+  };
+  
+  //! return predicted target (0 .. nTargets - 1) for a single event
+  //! (confidence = winner's share of the vote, if not NULL)
+  unsigned int classify (const RecoTarget::Event &event,
+                         Workspace &workspace,
+                         double *confidence = NULL) const;
+  
+  //! as above, but with temporary workspace
+  unsigned int classify (const RecoTarget::Event &event,
+                         double *confidence = NULL) const;
+  
+  //! save predicted target for each event in predictions
+  void classify (const RecoTarget::Event *events,
+                 const unsigned int &nEvents,
+                 unsigned int *predictions,
+                 double *confidences = NULL) const;
+  
+  //! add learning events for given target (only they are processed);
+  //! must not be called while other threads classify
+  void appendLearning (const unsigned int &target,
+                       const RecoTarget::Event *events,
+                       const unsigned int &nEvents);
+  
+  //! remove "n" oldest learning events of given target;
+  //! must not be called while other threads classify
+  void retireLearning (const unsigned int &target, const unsigned int &n);
+  
+  private:
+  
+  //! learning samples per target (NULL if target is not used)
+  RecoTargetSampleHandler *learningSamples[RecoTarget::nTargets];
+  
+  RecoTarget::Metric metric; //!< metric used for distance
+  unsigned int nNeighbors;   //!< k for kNN
+  RecoTarget::Vote vote;     //!< how neighbors vote
+  bool earlyExit;            //!< stop scan when top-k / vote is decided
+  bool ownsSamples; //!< true if learning samples were loaded here
+  
+  //! norms of all learning samples (sorted, used for early exit)
+  std::vector <double> norms;
+  //! <target, id> of learning samples in the order of norms
+  std::vector < std::pair <unsigned int, unsigned int> > sortedSamples;
+  
+  void checkSetup () const; //!< throw if setup does not make sense
+  void sortByNorm (); //!< fill norms and sortedSamples
+  
+  //! merge learning samples of target with id >= fromId into the index
+  void indexSamples (const unsigned int &target,
+                     const unsigned int &fromId);
+  
+  //! remove retired learning samples of target from the index
+  void unindexSamples (const unsigned int &target);
+  
+  //! return c-th learning sample in the order of norms
+  const RecoTargetSampleHandler::Sample&
+    sortedSample (const size_t &c) const;
+  
+  //! scan learning samples ordered by norm, stop when result is known
+  void fillNearestEarlyExit (Workspace &workspace) const;
+    
+  //! true if majority vote of nearest can not change after the scan
+  //! of the rest of learning samples (lo, hi = not scanned yet)
+  bool isVoteDecided
+    (const std::vector <RecoTarget::Neighbor> &nearest,
+     const double &norm, const size_t &lo, const size_t &hi) const;
+  
+  //! classifier owns learning samples, so it can not be copied
+  RecoTargetClassifier (const RecoTargetClassifier &);
+  RecoTargetClassifier& operator= (const RecoTargetClassifier &);
+};
+
+#endif
@@ -9,19 +9,20 @@
 #ifndef RECO_TARGET_DETECTOR_PROPERTIES_H
 #define RECO_TARGET_DETECTOR_PROPERTIES_H
 
-#include <map>
-
 namespace RecoTarget
 {
   const unsigned int nPlanes = 208; //!< number of planes in detector
   
   const unsigned int nTargets = 5; //!< number of targets
   
-  //! the map of plane positions in the detector
-  extern std::map <int, double> planePositions;
+  //! z of nuclear targets (middle of the gap between module planes)
+  extern const double targetPositions[nTargets];
+  
+  const double waterTargetPosition = 5305.26; //!< z of water target
+  const double ecalPosition = 8647.38; //!< z where ECAL starts
+  const double hcalPosition = 9063.30; //!< z where HCAL starts
   
-  //! the map of plane id order
-  extern std::map <int, int> idOrderMap;
+  // plane ids and positions of planes: see RecoTargetGeometry.h
 };
 
 #endif
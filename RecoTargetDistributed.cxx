@@ -0,0 +1,243 @@
+#include "RecoTargetDistributed.h"
+#include "RecoTargetException.h"
+#include <iostream>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <stdint.h>
+
+#ifdef RECO_TARGET_MPI
+#include <mpi.h>
+#endif
+
+using namespace RecoTarget;
+
+namespace
+{
+  //! write all n bytes to fd, return false on error
+  bool writeAll (const int &fd, const char *data, size_t n)
+  {
+    while (n > 0)
+    {
+      const ssize_t written = write (fd, data, n);
+      
+      if (written <= 0) return false;
+      
+      data += written;
+      n -= written;
+    }
+    
+    return true;
+  }
+  
+  //! read all n bytes from fd, return false on error or end of file
+  bool readAll (const int &fd, char *data, size_t n)
+  {
+    while (n > 0)
+    {
+      const ssize_t got = read (fd, data, n);
+      
+      if (got <= 0) return false;
+      
+      data += got;
+      n -= got;
+    }
+    
+    return true;
+  }
+}
+
+/*! <ul>
+ *  <li> flush output, so children do not print it again
+ *  <li> create a pipe and fork for each rank > 0
+ *  <li> child keeps only write end of its pipe, rank 0 all read ends
+ *  </ul>
+ */
+RecoTargetForkCommunicator :: RecoTargetForkCommunicator
+  (const unsigned int &n)
+{
+  rank = 0;
+  size = n;
+  
+  std::cout.flush();
+  std::cerr.flush();
+  fflush (NULL);
+  
+  for (unsigned int r = 1; r < size; r++)
+  {
+    int fd[2];
+    
+    if (pipe (fd) != 0)
+      throw Exception (SYSTEM_ERROR, "can not create pipe");
+      
+    const pid_t pid = fork();
+    
+    if (pid < 0) throw Exception (SYSTEM_ERROR, "can not fork");
+    
+    if (pid == 0) // child
+    {
+      for (size_t i = 0; i < pipes.size(); i++) close (pipes[i]);
+      
+      close (fd[0]);
+      
+      pipes.assign (1, fd[1]);
+      children.clear();
+      rank = r;
+      
+      return;
+    }
+    
+    close (fd[1]);
+    
+    pipes.push_back (fd[0]);
+    children.push_back (pid);
+  }
+}
+
+//! close pipes, rank 0 waits for all children
+RecoTargetForkCommunicator :: ~RecoTargetForkCommunicator ()
+{
+  for (size_t i = 0; i < pipes.size(); i++) close (pipes[i]);
+  
+  for (size_t i = 0; i < children.size(); i++)
+    waitpid (children[i], NULL, 0);
+}
+
+//! message = size (uint64) + data
+void RecoTargetForkCommunicator :: gather
+  (const std::vector <char> &buffer,
+   std::vector < std::vector <char> > &buffers)
+{
+  if (rank > 0)
+  {
+    const uint64_t n = buffer.size();
+    
+    if (not writeAll (pipes[0], (const char*) &n, sizeof (n)) or
+        not writeAll (pipes[0], buffer.data(), n))
+      throw Exception (SYSTEM_ERROR, "can not send data to rank 0");
+    
+    return;
+  }
+  
+  buffers.resize (size);
+  buffers[0] = buffer;
+  
+  for (unsigned int r = 1; r < size; r++)
+  {
+    uint64_t n = 0;
+    
+    if (not readAll (pipes[r - 1], (char*) &n, sizeof (n)))
+      throw Exception (SYSTEM_ERROR, "rank failed before sending data");
+      
+    buffers[r].resize (n);
+    
+    if (not readAll (pipes[r - 1], buffers[r].data(), n))
+      throw Exception (SYSTEM_ERROR, "rank failed while sending data");
+  }
+}
+
+#ifdef RECO_TARGET_MPI
+RecoTargetMpiCommunicator :: RecoTargetMpiCommunicator ()
+{
+  MPI_Init (NULL, NULL);
+  
+  int r, n;
+  
+  MPI_Comm_rank (MPI_COMM_WORLD, &r);
+  MPI_Comm_size (MPI_COMM_WORLD, &n);
+  
+  rank = r;
+  size = n;
+}
+
+RecoTargetMpiCommunicator :: ~RecoTargetMpiCommunicator ()
+{
+  MPI_Finalize();
+}
+
+//! gather sizes first, then data
+void RecoTargetMpiCommunicator :: gather
+  (const std::vector <char> &buffer,
+   std::vector < std::vector <char> > &buffers)
+{
+  int n = buffer.size();
+  
+  std::vector <int> sizes (size), offsets (size);
+  
+  MPI_Gather (&n, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
+  
+  std::vector <char> all;
+  
+  if (rank == 0)
+  {
+    for (unsigned int r = 1; r < size; r++)
+      offsets[r] = offsets[r - 1] + sizes[r - 1];
+      
+    all.resize (offsets[size - 1] + sizes[size - 1]);
+  }
+  
+  MPI_Gatherv (const_cast <char*> (buffer.data()), n, MPI_CHAR,
+               all.data(), sizes.data(), offsets.data(), MPI_CHAR, 0,
+               MPI_COMM_WORLD);
+  
+  if (rank > 0) return;
+  
+  buffers.resize (size);
+  
+  for (unsigned int r = 0; r < size; r++)
+    buffers[r].assign (all.begin() + offsets[r],
+                       all.begin() + offsets[r] + sizes[r]);
+}
+#endif
+
+namespace RecoTarget
+{
+  //! n > 1: fork, n = 0: MPI (if compiled with it)
+  RecoTargetCommunicator* createCommunicator (const unsigned int &n)
+  {
+    if (n == 1) return NULL;
+    
+#ifdef RECO_TARGET_MPI
+    if (n == 0) return new RecoTargetMpiCommunicator;
+#else
+    if (n == 0)
+      throw Exception (BAD_ARGUMENT, "compiled without MPI support");
+#endif
+    
+    return new RecoTargetForkCommunicator (n);
+  }
+  
+  /*! <ul>
+   *  <li> keep top-k of each testing sample and pack them
+   *  <li> gather packed lists on rank 0
+   *  <li> rank 0: k-way merge of lists from all ranks per sample
+   *  </ul>
+   */
+  void reduceNeighbors (RecoTargetSampleHandler **testingSamples,
+                        RecoTargetCommunicator *communicator,
+                        const unsigned int &k)
+  {
+    std::vector <char> buffer;
+    
+    for (unsigned int i = 0; i < nTargets; i++)
+      if (testingSamples[i])
+      {
+        testingSamples[i]->keepNearest (k);
+        testingSamples[i]->packNeighbors (buffer);
+      }
+      
+    std::vector < std::vector <char> > buffers;
+    
+    communicator->gather (buffer, buffers);
+    
+    if (communicator->getRank() > 0) return;
+    
+    std::vector <const char*> cursors (buffers.size());
+    
+    for (size_t r = 0; r < buffers.size(); r++)
+      cursors[r] = buffers[r].data();
+      
+    for (unsigned int i = 0; i < nTargets; i++)
+      if (testingSamples[i]) testingSamples[i]->mergeNeighbors (cursors, k);
+  }
+}
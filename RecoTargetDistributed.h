@@ -0,0 +1,93 @@
+/**
+ * @brief Communication between ranks of distributed kNN
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_DISTRIBUTED_H
+#define RECO_TARGET_DISTRIBUTED_H
+
+#include "RecoTargetSampleHandler.h"
+#include <vector>
+#include <sys/types.h>
+
+/*! each rank keeps a shard of learning samples and the whole testing
+ *  sample; partial top-k lists are gathered on rank 0 and merged there
+ */
+class RecoTargetCommunicator
+{
+  public:
+  
+  virtual ~RecoTargetCommunicator () {} //!< destructor
+  
+  //! return rank of this process (0 = root)
+  inline unsigned int getRank () const
+  {
+    return rank;
+  };
+  
+  //! return the number of ranks
+  inline unsigned int getSize () const
+  {
+    return size;
+  };
+  
+  //! send buffer to rank 0; on rank 0 buffers[r] = buffer of rank r
+  virtual void gather (const std::vector <char> &buffer,
+                       std::vector < std::vector <char> > &buffers) = 0;
+  
+  protected:
+  
+  unsigned int rank; //!< rank of this process
+  unsigned int size; //!< number of ranks
+};
+
+//! local stand-in for MPI: n - 1 forked processes talking by pipes
+class RecoTargetForkCommunicator : public RecoTargetCommunicator
+{
+  public:
+  
+  RecoTargetForkCommunicator (const unsigned int &n); //!< constructor
+  ~RecoTargetForkCommunicator (); //!< destructor (waits for children)
+  
+  //! children write to their pipes, rank 0 reads all of them
+  void gather (const std::vector <char> &buffer,
+               std::vector < std::vector <char> > &buffers);
+  
+  private:
+  
+  //! rank 0: read ends of pipes (one per child), child: write end
+  std::vector <int> pipes;
+  std::vector <pid_t> children; //!< child processes (rank 0 only)
+};
+
+#ifdef RECO_TARGET_MPI
+//! MPI backend (compile with -DRECO_TARGET_MPI and run with mpirun)
+class RecoTargetMpiCommunicator : public RecoTargetCommunicator
+{
+  public:
+  
+  RecoTargetMpiCommunicator (); //!< constructor (MPI_Init)
+  ~RecoTargetMpiCommunicator (); //!< destructor (MPI_Finalize)
+  
+  //! MPI_Gatherv to rank 0
+  void gather (const std::vector <char> &buffer,
+               std::vector < std::vector <char> > &buffers);
+};
+#endif
+
+namespace RecoTarget
+{
+  //! return communicator for n local processes (0 = MPI), NULL if n = 1
+  RecoTargetCommunicator* createCommunicator (const unsigned int &n);
+  
+  //! replace neighbors of testing samples on rank 0 by top-k merged
+  //! from all ranks (each rank must have filled its top-k before)
+  void reduceNeighbors (RecoTargetSampleHandler **testingSamples,
+                        RecoTargetCommunicator *communicator,
+                        const unsigned int &k);
+}
+
+#endif
@@ -0,0 +1,209 @@
+#include "RecoTargetEventStore.h"
+#include "RecoTargetGeometry.h"
+#include "RecoTargetException.h"
+#include "RecoTargetUtils.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace RECOTRACKS_ANA;
+using namespace RecoTarget;
+
+namespace
+{
+  const uint64_t storeMagic = 0x3130534554524552ull; //!< "RERTES01"
+  const uint64_t storeVersion = 2;
+  
+  //! file header
+  struct Header
+  {
+    uint64_t magic;    //!< storeMagic
+    uint64_t version;  //!< storeVersion
+    uint64_t nEntries; //!< number of entries
+    uint64_t nHits;    //!< total number of hit planes
+    uint64_t nFiles;   //!< number of input files
+  };
+  
+  //! fwrite or throw (the caller closes file)
+  void writeOrThrow (const void *data, const size_t &size,
+                     const size_t &n, FILE *file)
+  {
+    if (n > 0 and fwrite (data, size, n, file) != n)
+      throw Exception (BAD_FILE, "can not write event store");
+  }
+  
+  //! true if offsets[0 .. n] go from 0 to last and never decrease
+  bool isMonotonic (const uint64_t *offsets, const uint64_t &n,
+                    const uint64_t &last)
+  {
+    if (offsets[0] != 0 or offsets[n] != last) return false;
+    
+    for (uint64_t i = 0; i < n; i++)
+      if (offsets[i] > offsets[i + 1]) return false;
+      
+    return true;
+  }
+}
+
+/*! <ul>
+ *  <li> map the file read-only
+ *  <li> check header and size
+ *  <li> set up pointers to columns, check that offsets of files and
+ *  entries never decrease and end at the number of entries and hits
+ *  (so every entry is within the file)
+ *  <li> advise random access (no read-ahead of unused entries), or
+ *  sequential one if entries are read front to back
+ *  </ul>
+ */
+RecoTargetEventStore :: RecoTargetEventStore (const char *fileName,
+                                              const bool &isSequential)
+  : data (MAP_FAILED), dataSize (0)
+{
+  const int fd = open (fileName, O_RDONLY);
+  
+  if (fd < 0)
+    throw Exception (BAD_FILE, std::string ("can not open ") + fileName);
+    
+  struct stat status;
+  
+  if (fstat (fd, &status) == 0 and status.st_size >= (off_t) sizeof (Header))
+  {
+    dataSize = status.st_size;
+    data = mmap (NULL, dataSize, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  
+  close (fd);
+  
+  if (data == MAP_FAILED)
+    throw Exception (BAD_FILE, std::string ("can not map ") + fileName);
+    
+  const Header *header = static_cast <const Header*> (data);
+  
+  nEntries = header->nEntries;
+  nFiles = header->nFiles;
+  
+  // each count is below the file size, so expected size can not overflow
+  bool isValid = header->magic == storeMagic and
+    header->version == storeVersion and nEntries < dataSize and
+    (unsigned int) nEntries == nEntries and nFiles < dataSize and
+    header->nHits < dataSize and dataSize == sizeof (Header) +
+    (nFiles + 1 + nEntries + 1) * sizeof (uint64_t) +
+    header->nHits * (sizeof (double) + sizeof (uint8_t));
+  
+  if (isValid)
+  {
+    fileOffsets = reinterpret_cast <const uint64_t*> (header + 1);
+    offsets = fileOffsets + nFiles + 1;
+    energy = reinterpret_cast <const double*> (offsets + nEntries + 1);
+    planeZorder = reinterpret_cast <const uint8_t*>
+      (energy + header->nHits);
+    
+    isValid = isMonotonic (fileOffsets, nFiles, nEntries) and
+              isMonotonic (offsets, nEntries, header->nHits);
+  }
+  
+  if (not isValid)
+  {
+    munmap (data, dataSize);
+    throw Exception (BAD_FILE, std::string ("corrupted store ") + fileName);
+  }
+  
+  madvise (data, dataSize, isSequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+}
+
+RecoTargetEventStore :: ~RecoTargetEventStore ()
+{
+  munmap (data, dataSize);
+}
+
+/*! <ul>
+ *  <li> read entries one by one (each ROOT basket is decompressed once)
+ *  <li> write energies directly behind the place for offsets
+ *  <li> keep offsets and z-orders in memory (9 bytes per hit at most)
+ *  <li> write z-orders, then go back for header and offsets (file
+ *  offsets are known from the chain upfront)
+ *  <li> write to temporary file and rename it, so store is never 
+ *  seen half-written (temporary file is removed if anything fails)
+ *  </ul>
+ */
+void RecoTargetEventStore :: convert (RecoTracks *recoTracks,
+                                      const char *fileName)
+{
+  // unique temporary name (many ranks may convert at the same time)
+  char suffix[32];
+  snprintf (suffix, sizeof (suffix), ".tmp%d", (int) getpid());
+  
+  const std::string tmpName = std::string (fileName) + suffix;
+  
+  FILE *file = fopen (tmpName.c_str(), "wb");
+  
+  if (not file)
+    throw Exception (BAD_FILE, "can not create " + tmpName);
+    
+  try
+  {
+    Header header;
+    header.magic = storeMagic;
+    header.version = storeVersion;
+    header.nEntries = recoTracks->fChain->GetEntries();
+    header.nHits = 0;
+    
+    const std::vector <unsigned int> files = 
+      RecoTarget::fileOffsets (recoTracks);
+    const std::vector <uint64_t> firstEntries (files.begin(), files.end());
+    
+    header.nFiles = firstEntries.size() - 1;
+    
+    std::vector <uint64_t> offsets (1, 0);
+    std::vector <uint8_t> planeZorder;
+    
+    offsets.reserve (header.nEntries + 1);
+    
+    // leave space for header and offsets
+    if (fseek (file, sizeof (Header) + (header.nFiles + 1 +
+               header.nEntries + 1) * sizeof (uint64_t), SEEK_SET) != 0)
+      throw Exception (BAD_FILE, "can not write event store");
+    
+    for (uint64_t entry = 0; entry < header.nEntries; entry++)
+    {
+      recoTracks->GetEntry (entry);
+      
+      const unsigned int nHits = recoTracks->plane_id_sz;
+      
+      writeOrThrow (recoTracks->plane_visible_energy, sizeof (double),
+                    nHits, file);
+      
+      for (unsigned int i = 0; i < nHits; i++)
+        planeZorder.push_back (planeOrder (recoTracks->plane_id[i]));
+        
+      header.nHits += nHits;
+      offsets.push_back (header.nHits);
+    }
+    
+    writeOrThrow (planeZorder.data(), sizeof (uint8_t), planeZorder.size(),
+                  file);
+    
+    rewind (file);
+    
+    writeOrThrow (&header, sizeof (Header), 1, file);
+    writeOrThrow (firstEntries.data(), sizeof (uint64_t),
+                  firstEntries.size(), file);
+    writeOrThrow (offsets.data(), sizeof (uint64_t), offsets.size(), file);
+  }
+  catch (...)
+  {
+    fclose (file);
+    unlink (tmpName.c_str());
+    throw;
+  }
+  
+  if (fclose (file) != 0 or rename (tmpName.c_str(), fileName) != 0)
+  {
+    unlink (tmpName.c_str());
+    throw Exception (BAD_FILE, std::string ("can not write ") + fileName);
+  }
+}
@@ -0,0 +1,95 @@
+/**
+ * @brief Memory-mapped columnar copy of RecoTracks plane hits
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_EVENT_STORE_H
+#define RECO_TARGET_EVENT_STORE_H
+
+#include "RecoTracks.h"
+#include <cstddef>
+#include <stdint.h>
+
+/*! file layout (no compression, so any entry is read directly):
+ *  <ul>
+ *  <li> header: magic, version, number of entries, number of hits,
+ *  number of input files
+ *  <li> fileOffsets[nFiles + 1]: first entry of each input file
+ *  <li> offsets[nEntries + 1]: hits of entry i are [offsets[i], 
+ *  offsets[i + 1]) (CSR)
+ *  <li> energy[nHits]: visible energy per hit plane
+ *  <li> planeZorder[nHits]: plane z-order (already translated from id)
+ *  </ul>
+ *  the file is memory-mapped, so only pages of used entries are read
+ */
+class RecoTargetEventStore
+{
+  public:
+  
+  //! constructor (map existing store file; isSequential = entries are
+  //! read front to back, e.g. learning chunks, so pages are read ahead)
+  RecoTargetEventStore (const char *fileName,
+                        const bool &isSequential = false);
+  ~RecoTargetEventStore (); //!< destructor (unmap file)
+  
+  //! write all entries of recoTracks to store file (one sequential pass)
+  static void convert (RECOTRACKS_ANA::RecoTracks *recoTracks,
+                       const char *fileName);
+  
+  //! return the number of entries
+  inline unsigned int getNEntries () const
+  {
+    return nEntries;
+  };
+  
+  //! return the number of input files
+  inline unsigned int getNFiles () const
+  {
+    return nFiles;
+  };
+  
+  //! return the first entry of input file (file = nFiles -> nEntries)
+  inline unsigned int getFileOffset (const unsigned int &file) const
+  {
+    return fileOffsets[file];
+  };
+  
+  //! return the number of hit planes in entry
+  inline unsigned int getNHits (const unsigned int &entry) const
+  {
+    return offsets[entry + 1] - offsets[entry];
+  };
+  
+  //! return visible energy of hit planes in entry
+  inline const double* getEnergy (const unsigned int &entry) const
+  {
+    return energy + offsets[entry];
+  };
+  
+  //! return z-order of hit planes in entry
+  inline const uint8_t* getPlaneOrder (const unsigned int &entry) const
+  {
+    return planeZorder + offsets[entry];
+  };
+  
+  private:
+  
+  void *data;      //!< mapped file
+  size_t dataSize; //!< size of mapped file
+  
+  uint64_t nEntries;         //!< number of entries
+  uint64_t nFiles;           //!< number of input files
+  const uint64_t *fileOffsets; //!< first entry of each input file
+  const uint64_t *offsets;   //!< first hit of each entry
+  const double *energy;      //!< energy per hit
+  const uint8_t *planeZorder; //!< plane z-order per hit
+  
+  //! store can not be copied (it owns the mapping)
+  RecoTargetEventStore (const RecoTargetEventStore &);
+  RecoTargetEventStore& operator= (const RecoTargetEventStore &);
+};
+
+#endif
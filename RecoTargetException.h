@@ -0,0 +1,52 @@
+/**
+ * @brief Errors reported by RecoTarget
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_EXCEPTION_H
+#define RECO_TARGET_EXCEPTION_H
+
+#include <stdexcept>
+#include <string>
+
+namespace RecoTarget
+{
+  //! error codes (used as exit codes by RecoTarget executable)
+  enum ErrorCode
+  {
+    NO_ERROR         = 0,
+    BAD_USAGE        = 1, //!< wrong or missing command line options
+    USER_ABORT       = 2, //!< user did not accept the summary
+    NO_FILES         = 3, //!< no input files found
+    UNDEFINED_METRIC = 4, //!< metric id out of range
+    BAD_ARGUMENT     = 5, //!< invalid argument passed to the library
+    BAD_FILE         = 6, //!< file can not be read or written
+    FAILED_CHECK     = 7, //!< engine differs from reference (validation)
+    SYSTEM_ERROR     = 8  //!< pipe, fork or process communication failed
+  };
+  
+  //! exception thrown instead of exit() so RecoTarget can be embedded
+  class Exception : public std::runtime_error
+  {
+    public:
+    
+    //! constructor (error code, message)
+    Exception (const ErrorCode &code, const std::string &message = "")
+      : std::runtime_error (message), errorCode (code) {}
+    
+    //! return error code
+    inline ErrorCode getCode () const
+    {
+      return errorCode;
+    };
+    
+    private:
+    
+    ErrorCode errorCode; //!< what went wrong
+  };
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include "RecoTargetFeatures.h"
+#include "RecoTargetGeometry.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace RecoTarget;
+
+namespace
+{
+  //! geometry tables used by extractFeatures (built once)
+  struct Geometry
+  {
+    double z[nPlanes];             //!< normalized z of each plane
+    unsigned int region[nPlanes];  //!< region of each plane
+    int nearTarget[nPlanes];       //!< feature next to target (or -1)
+    unsigned int byZ[nPlanes];     //!< planes sorted by z
+    
+    /*! <ul>
+     *  <li> take z from planePositions (key = plane order)
+     *  <li> region = number of boundaries upstream of the plane
+     *  <li> nNearPlanes closest planes on each side of a target
+     *  </ul>
+     */
+    Geometry ()
+    {
+      const double boundaries[nRegions - 1] =
+      {
+        targetPositions[0], targetPositions[1], targetPositions[2],
+        waterTargetPosition, targetPositions[3], targetPositions[4],
+        ecalPosition, hcalPosition
+      };
+      
+      double position[nPlanes];
+      
+      for (unsigned int p = 0; p < nPlanes; p++)
+      {
+        position[p] = planePositions[p];
+        byZ[p] = p;
+      }
+      
+      std::sort (byZ, byZ + nPlanes, [&] (unsigned int a, unsigned int b)
+                 { return position[a] < position[b]; });
+                 
+      const double front = position[byZ[0]];
+      const double length = position[byZ[nPlanes - 1]] - front;
+      
+      for (unsigned int p = 0; p < nPlanes; p++)
+      {
+        z[p] = (position[p] - front) / length;
+        region[p] = std::upper_bound (boundaries, boundaries + 
+          nRegions - 1, position[p]) - boundaries;
+        nearTarget[p] = -1;
+      }
+      
+      for (unsigned int t = 0; t < nTargets; t++)
+      {
+        // the first plane behind the target (in z order)
+        unsigned int behind = 0;
+        
+        while (behind < nPlanes and 
+               position[byZ[behind]] < targetPositions[t]) behind++;
+        
+        for (unsigned int n = 1; n <= nNearPlanes; n++)
+        {
+          if (behind >= n)
+            nearTarget[byZ[behind - n]] = 5 + nRegions + 2 * t;
+          if (behind + n - 1 < nPlanes)
+            nearTarget[byZ[behind + n - 1]] = 5 + nRegions + 2 * t + 1;
+        }
+      }
+    }
+  };
+}
+
+namespace RecoTarget
+{
+  /*! <ul>
+   *  <li> one pass for sums of z, z^2, z^3, regions and targets
+   *  <li> first / last hit from planes sorted by z
+   *  <li> central moments from raw ones
+   *  </ul>
+   */
+  void extractFeatures (const double *energyPerPlane, double *features)
+  {
+    static const Geometry geometry; // thread-safe since C++11
+    
+    std::fill_n (features, nFeatures, 0.0);
+    
+    double total = 0.0, z1 = 0.0, z2 = 0.0, z3 = 0.0;
+    
+    for (unsigned int p = 0; p < nPlanes; p++)
+    {
+      const double e = energyPerPlane[p];
+      
+      if (e == 0.0) continue;
+      
+      const double z = geometry.z[p];
+      
+      total += e;
+      z1 += e * z;
+      z2 += e * z * z;
+      z3 += e * z * z * z;
+      
+      features[5 + geometry.region[p]] += e;
+      
+      if (geometry.nearTarget[p] >= 0) features[geometry.nearTarget[p]] += e;
+    }
+    
+    if (total <= 0.0) return; // empty event
+    
+    const double mean = z1 / total;
+    const double variance = std::max (0.0, z2 / total - mean * mean);
+    const double rms = sqrt (variance);
+    const double third = z3 / total - 3.0 * mean * z2 / total +
+                         2.0 * mean * mean * mean;
+    
+    features[0] = mean;
+    features[1] = rms;
+    features[2] = rms > 0.0 ? 0.5 + atan (third / (variance * rms)) / M_PI
+                            : 0.5;
+    
+    for (unsigned int p = 0; p < nPlanes; p++)
+      if (energyPerPlane[geometry.byZ[p]] != 0.0)
+      {
+        features[3] = geometry.z[geometry.byZ[p]];
+        break;
+      }
+      
+    for (unsigned int p = nPlanes; p-- > 0; )
+      if (energyPerPlane[geometry.byZ[p]] != 0.0)
+      {
+        features[4] = geometry.z[geometry.byZ[p]];
+        break;
+      }
+      
+    // fractions (energy is normalized already, but make sure)
+    for (unsigned int f = 5; f < nFeatures; f++) features[f] /= total;
+  }
+}
@@ -0,0 +1,35 @@
+/**
+ * @brief Compact longitudinal profile features of an event
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_FEATURES_H
+#define RECO_TARGET_FEATURES_H
+
+#include "RecoTargetDetectorProperties.h"
+
+namespace RecoTarget
+{
+  const unsigned int nRegions = nTargets + 4; //!< parts of detector
+  const unsigned int nNearPlanes = 2; //!< planes next to target (module)
+  
+  //! number of features: 5 moments / edges + regions + 2 per target
+  const unsigned int nFeatures = 5 + nRegions + 2 * nTargets;
+  
+  /*! calculate features from energy per plane (normalized to 1), all in
+   *  [0, 1] (z is measured from the first to the last plane):
+   *  <ul>
+   *  <li> energy-weighted mean z, RMS and skew (0.5 + atan (skew) / pi)
+   *  <li> z of the first and the last hit plane
+   *  <li> energy fraction in regions split by targets, water target,
+   *  ECAL and HCAL
+   *  <li> energy fraction in the module just before / after each target
+   *  </ul>
+   */
+  void extractFeatures (const double *energyPerPlane, double *features);
+}
+
+#endif
@@ -0,0 +1,139 @@
+#include "RecoTargetGeometry.h"
+#include <limits>
+
+namespace RecoTarget
+{
+  /*! sub-detectors: 9 = nuclear target region, 11 = tracker, 12 = ECAL,
+   *  13 = HCAL; modules missing in the nuclear target region are the
+   *  passive targets; HCAL modules have one plane
+   */
+  const ModuleRun moduleRuns[nModuleRuns] =
+  {
+    { 9,  0,   3, 1, 2,   0},
+    { 9,  5,   8, 1, 2,   8},
+    { 9, 11,  18, 1, 2,  16},
+    { 9, 20,  21, 1, 2,  32},
+    { 9, -6,  -3, 1, 2,  36},
+    {11, 23,  84, 1, 2,  44},
+    {12, 85,  94, 1, 2, 168},
+    {13, 95, 114, 2, 1, 188}
+  };
+  
+  const double planePositions[nPlanes] =
+  {
+    4514.11, 4534.76, 4558.33, 4578.97, 4602.54, 4623.19,
+    4646.76, 4667.4, 4735.19, 4755.83, 4779.4, 4800.05,
+    4823.62, 4844.26, 4867.83, 4888.48, 5000.48, 5021.12,
+    5044.69, 5065.34, 5088.91, 5109.55, 5133.12, 5153.77,
+    5456.74, 5477.38, 5500.95, 5521.6, 5545.17, 5565.81,
+    5589.38, 5610.02, 5677.81, 5698.45, 5722.03, 5742.67,
+    4293.04, 4313.68, 4337.25, 4357.9, 4381.47, 4402.11,
+    4425.68, 4446.33, 5810.45, 5831.1, 5855.68, 5876.33,
+    5900.91, 5921.56, 5946.14, 5966.79, 5991.37, 6012.01,
+    6036.6, 6057.24, 6081.83, 6102.47, 6127.06, 6147.7,
+    6172.29, 6192.93, 6217.52, 6238.16, 6262.74, 6283.39,
+    6307.97, 6328.62, 6353.2, 6373.85, 6398.43, 6419.08,
+    6443.66, 6464.3, 6488.89, 6509.53, 6534.12, 6554.76,
+    6579.35, 6599.99, 6624.58, 6645.22, 6669.81, 6690.45,
+    6715.03, 6735.68, 6760.26, 6780.91, 6805.49, 6826.14,
+    6850.72, 6871.37, 6895.95, 6916.59, 6941.18, 6961.82,
+    6986.41, 7007.05, 7031.64, 7052.28, 7076.87, 7097.51,
+    7122.1, 7142.74, 7167.32, 7187.97, 7212.55, 7233.2,
+    7257.78, 7278.43, 7303.01, 7323.66, 7348.24, 7368.88,
+    7393.47, 7414.11, 7438.7, 7459.34, 7483.93, 7504.57,
+    7529.16, 7549.8, 7574.39, 7595.03, 7619.61, 7640.26,
+    7664.84, 7685.49, 7710.07, 7730.72, 7755.3, 7775.95,
+    7800.53, 7821.17, 7845.76, 7866.4, 7890.99, 7911.63,
+    7936.22, 7956.86, 7981.45, 8002.09, 8026.68, 8047.32,
+    8071.9, 8092.55, 8117.13, 8137.78, 8162.36, 8183.01,
+    8207.59, 8228.24, 8252.82, 8273.46, 8298.05, 8318.69,
+    8343.28, 8363.92, 8388.51, 8409.15, 8433.74, 8454.38,
+    8478.97, 8499.61, 8524.19, 8544.84, 8569.42, 8590.07,
+    8614.65, 8635.3, 8659.46, 8680.1, 8704.26, 8724.9,
+    8749.06, 8769.71, 8793.86, 8814.51, 8838.67, 8859.31,
+    8883.47, 8904.11, 8928.27, 8948.92, 8973.08, 8993.72,
+    9017.88, 9038.52, 9088.08, 9135.41, 9182.75, 9230.08,
+    9277.41, 9324.74, 9372.08, 9419.41, 9466.74, 9514.07,
+    9561.41, 9608.74, 9656.07, 9703.4, 9750.74, 9798.07,
+    9845.4, 9892.73, 9940.07, 9987.4
+  };
+  
+  /*! <ul>
+   *  <li> decode sub-detector, module and plane from bit fields
+   *  <li> find run of modules (a few comparisons, no lookup table)
+   *  <li> other bits must be zero (strip ids are not plane ids)
+   *  </ul>
+   */
+  int planeOrder (const int &planeId)
+  {
+    if (planeId & 0x3ffff) return 0;
+    
+    const unsigned int subdetector = subdetectorOf (planeId);
+    const int module = moduleOf (planeId);
+    const unsigned int plane = planeOf (planeId);
+    
+    for (unsigned int r = 0; r < nModuleRuns; r++)
+    {
+      const ModuleRun &run = moduleRuns[r];
+      
+      if (subdetector == run.subdetector and
+          module >= run.firstModule and module <= run.lastModule and
+          plane >= run.firstPlane and plane < run.firstPlane + run.nPlanes)
+        return run.firstOrder + (module - run.firstModule) * run.nPlanes +
+               plane - run.firstPlane;
+    }
+    
+    return 0;
+  }
+  
+  //! run containing z-order, then fields back to bits
+  int planeId (const unsigned int &order)
+  {
+    unsigned int r = 0;
+    
+    while (r + 1 < nModuleRuns and moduleRuns[r + 1].firstOrder <= order)
+      r++;
+    
+    const ModuleRun &run = moduleRuns[r];
+    
+    const unsigned int n = order - run.firstOrder;
+    const int module = run.firstModule + n / run.nPlanes;
+    const unsigned int plane = run.firstPlane + n % run.nPlanes;
+    
+    return (run.subdetector << 27) | ((module & 0x7f) << 20) | (plane << 18);
+  }
+  
+  //! one pass over planes, neighbors in z-order are joined
+  std::vector <PlaneRange> planesBetween (const double &zFrom,
+                                          const double &zTo)
+  {
+    std::vector <PlaneRange> ranges;
+    
+    for (unsigned int p = 0; p < nPlanes; p++)
+    {
+      if (planePositions[p] < zFrom or planePositions[p] >= zTo) continue;
+      
+      if (not ranges.empty() and ranges.back().to == p)
+        ranges.back().to++;
+      else
+      {
+        const PlaneRange range = {p, p + 1};
+        ranges.push_back (range);
+      }
+    }
+    
+    return ranges;
+  }
+  
+  std::vector <PlaneRange> upstreamPlanes (const unsigned int &target)
+  {
+    return planesBetween (-std::numeric_limits <double>::infinity(),
+                          targetPositions[target]);
+  }
+  
+  std::vector <PlaneRange> downstreamPlanes (const unsigned int &target)
+  {
+    return planesBetween (targetPositions[target],
+                          std::numeric_limits <double>::infinity());
+  }
+}
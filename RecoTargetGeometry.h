@@ -0,0 +1,82 @@
+/**
+ * @brief Plane tables of the detector decoded from plane id bit fields
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_GEOMETRY_H
+#define RECO_TARGET_GEOMETRY_H
+
+#include "RecoTargetDetectorProperties.h"
+#include <vector>
+
+namespace RecoTarget
+{
+  //! planes [from, to) of z-order
+  struct PlaneRange
+  {
+    unsigned int from; //!< the first plane
+    unsigned int to;   //!< plane behind the range
+  };
+  
+  //! run of modules in one sub-detector, all with the same planes
+  struct ModuleRun
+  {
+    unsigned int subdetector; //!< sub-detector field of plane id
+    int firstModule;          //!< the first module of run
+    int lastModule;           //!< the last module of run
+    unsigned int firstPlane;  //!< the first plane in each module
+    unsigned int nPlanes;     //!< planes in each module
+    unsigned int firstOrder;  //!< z-order of the first plane of run
+  };
+  
+  const unsigned int nModuleRuns = 8; //!< number of module runs
+  
+  //! modules with planes, in order of plane ids (z-order of samples)
+  extern const ModuleRun moduleRuns[nModuleRuns];
+  
+  //! z of plane with given z-order (compile-time table)
+  extern const double planePositions[nPlanes];
+  
+  //! return sub-detector field of plane id (bits 27 - 31)
+  inline unsigned int subdetectorOf (const int &planeId)
+  {
+    return (unsigned int) planeId >> 27;
+  };
+  
+  //! return module of plane id (bits 20 - 26; modules upstream of
+  //! module 0 wrap around: 122 = module -6)
+  inline int moduleOf (const int &planeId)
+  {
+    const int module = (planeId >> 20) & 0x7f;
+    
+    return module >= 120 ? module - 128 : module;
+  };
+  
+  //! return plane in module of plane id (bits 18 - 19: 1 or 2)
+  inline unsigned int planeOf (const int &planeId)
+  {
+    return (planeId >> 18) & 0x3;
+  };
+  
+  //! return z-order of plane with given id (0 if unknown id)
+  int planeOrder (const int &planeId);
+  
+  //! return id of plane with given z-order (inverse of planeOrder)
+  int planeId (const unsigned int &order);
+  
+  //! return planes with position in [zFrom, zTo) as sorted ranges of
+  //! z-order (z-order is plane id order, so a z window may be split)
+  std::vector <PlaneRange> planesBetween (const double &zFrom,
+                                          const double &zTo);
+  
+  //! return planes upstream of target (closer to the beam)
+  std::vector <PlaneRange> upstreamPlanes (const unsigned int &target);
+  
+  //! return planes downstream of target
+  std::vector <PlaneRange> downstreamPlanes (const unsigned int &target);
+}
+
+#endif
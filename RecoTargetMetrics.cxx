@@ -9,7 +9,8 @@ namespace RecoTarget
   {
     "Euclidean",
     "Manhattan",
-    "Cosine similarity"
+    "Cosine similarity (dot product of L1-normalized)",
+    "Cosine distance (1 - cosine similarity)"
   };
   
   //! return (x-y)^2 multiplied by weight (1.0 by default)
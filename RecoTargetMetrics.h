@@ -11,10 +11,10 @@
 
 namespace RecoTarget
 {
-  const unsigned int nMetrics = 3; //!< number of implemented metrics
+  const unsigned int nMetrics = 4; //!< number of implemented metrics
   extern const char *listOfMetrics[]; //!< list of implemented metrics
   //! metrics enumerator
-  enum Metric {EUCLIDEAN, MANHATTAN, COSINE};
+  enum Metric {EUCLIDEAN, MANHATTAN, COSINE, NORMALIZED_COSINE};
   
   //! Eucliean metric
   double metricEuclidean (const double &x, const double &y,
@@ -22,9 +22,13 @@ namespace RecoTarget
   //! Manhattan metric
   double metricManhattan (const double &x, const double &y,
                           const double &w = 1.0);
-  //! Cosine similarity
+  //! Cosine similarity (not normalized, i.e. minus dot product)
   double metricCosine (const double &x, const double &y,
                        const double &w = 1.0);
+                       
+  /* NORMALIZED_COSINE = 1 - x.y / (|x| |y|) is not a sum over planes,
+   * samples keep 1 / |x| and compute it as a single dot product
+   */
 }
 
 #endif
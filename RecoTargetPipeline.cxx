@@ -0,0 +1,171 @@
+#include "RecoTargetPipeline.h"
+#include <memory>
+
+using namespace RecoTarget;
+
+//! ring keeps pipelineDepth batches per worker
+RecoTargetPipeline :: RecoTargetPipeline 
+  (RecoTargetSampleHandler **learningSamples,
+   const RecoTargetUserOptions &userOptions,
+   const unsigned int &nWorkers,
+   RecoTargetProfiler *profiler)
+  : learningSamples (learningSamples), userOptions (userOptions),
+    profiler (profiler), ring (pipelineDepth * nWorkers), head (0),
+    nQueued (0), isDone (false)
+{
+  for (unsigned int i = 0; i < nWorkers; i++)
+    workers.push_back (std::thread (&RecoTargetPipeline::work, this, i));
+}
+
+//! all learning samples have the same region
+std::vector <unsigned int> RecoTargetPipeline :: getRegion () const
+{
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (learningSamples[i]) return learningSamples[i]->getRegion();
+  
+  return std::vector <unsigned int> ();
+}
+
+//! stop workers (without rethrowing, e.g. if reader failed)
+RecoTargetPipeline :: ~RecoTargetPipeline ()
+{
+  {
+    std::lock_guard <std::mutex> lock (mutex);
+    isDone = true;
+  }
+  
+  notEmpty.notify_all();
+  
+  for (size_t i = 0; i < workers.size(); i++)
+    if (workers[i].joinable()) workers[i].join();
+}
+
+/*! <ul>
+ *  <li> wait for a free slot in the ring
+ *  <li> stop reading if some worker has failed
+ *  <li> put batch behind the last one and wake up a worker
+ *  </ul>
+ */
+void RecoTargetPipeline :: push (RecoTargetSampleHandler *testingSamples,
+                                 const unsigned int &first,
+                                 const unsigned int &last)
+{
+  {
+    std::unique_lock <std::mutex> lock (mutex);
+    
+    notFull.wait (lock, [this] { return nQueued < ring.size() or error; });
+    
+    if (error) std::rethrow_exception (error);
+    
+    Batch &batch = ring[(head + nQueued) % ring.size()];
+    
+    batch.samples = testingSamples;
+    batch.first = first;
+    batch.last = last;
+    
+    nQueued++;
+  }
+  
+  notEmpty.notify_one();
+}
+
+//! let workers empty the ring, join them, rethrow the first error
+void RecoTargetPipeline :: finish ()
+{
+  {
+    std::lock_guard <std::mutex> lock (mutex);
+    isDone = true;
+  }
+  
+  notEmpty.notify_all();
+  
+  for (size_t i = 0; i < workers.size(); i++)
+    if (workers[i].joinable()) workers[i].join();
+    
+  if (error) std::rethrow_exception (error);
+}
+
+//! wait for a batch (or the end of reading)
+bool RecoTargetPipeline :: pop (Batch &batch)
+{
+  {
+    std::unique_lock <std::mutex> lock (mutex);
+    
+    notEmpty.wait (lock, [this] { return nQueued > 0 or isDone; });
+    
+    if (nQueued == 0) return false;
+    
+    batch = ring[head];
+    
+    head = (head + 1) % ring.size();
+    nQueued--;
+  }
+  
+  notFull.notify_one();
+  
+  return true;
+}
+
+/*! <ul>
+ *  <li> take batches one by one
+ *  <li> keep kmax nearest of each selected learning target in worker's
+ *  own lists (max-heaps, far samples are skipped by index)
+ *  <li> merge them into neighbors of batch samples (batches do not
+ *  overlap, so no locks are needed)
+ *  <li> keep the first error, it is rethrown to the reader
+ *  <li> if profiled: count only neighbors (not waiting for batches)
+ *  </ul>
+ */
+void RecoTargetPipeline :: work (const unsigned int worker)
+{
+  const Metric metric = (Metric) userOptions.getMetric();
+  const unsigned int k = userOptions.getMaxNeighbors();
+  
+  std::unique_ptr <RecoTargetCounters> counters
+    (profiler ? new RecoTargetCounters : NULL);
+  
+  uint64_t nDistances = 0;
+  
+  // k nearest of each sample of batch (reused by all batches)
+  std::vector < std::vector <Neighbor> > lists (pipelineBatch);
+  
+  Batch batch;
+  
+  while (pop (batch))
+  {
+    try
+    {
+      if (lists.size() < batch.last - batch.first)
+        lists.resize (batch.last - batch.first);
+      
+      if (counters) counters->start();
+      
+      for (unsigned int j = 0; j < nTargets; j++)
+        if (userOptions.getFlagLearningTarget (j))
+        {
+          const unsigned int n = learningSamples[j]->getNSamples();
+          
+          nDistances += 1ull * (batch.last - batch.first) * n -
+            batch.samples->nearestNeighbors (learningSamples[j], j, metric,
+                                             batch.first, batch.last, 0,
+                                             n, k, lists.data());
+        }
+      
+      for (unsigned int i = batch.first; i < batch.last; i++)
+        batch.samples->addNearest (i, lists[i - batch.first], k);
+      
+      if (counters) counters->stop();
+    }
+    catch (...)
+    {
+      {
+        std::lock_guard <std::mutex> lock (mutex);
+        if (not error) error = std::current_exception();
+      }
+      
+      notFull.notify_all(); // reader should not wait for free slot
+    }
+  }
+  
+  if (counters) profiler->add (NEIGHBORS, worker, *counters, nDistances);
+}
@@ -0,0 +1,110 @@
+/**
+ * @brief Classify testing samples while they are being read
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_PIPELINE_H
+#define RECO_TARGET_PIPELINE_H
+
+#include "RecoTargetSampleHandler.h"
+#include "RecoTargetUserOptions.h"
+#include "RecoTargetProfiler.h"
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RecoTarget
+{
+  const unsigned int pipelineBatch = 64; //!< samples per batch
+  const unsigned int pipelineDepth = 4;  //!< batches per worker in ring
+}
+
+/*! producer / consumer pipeline:
+ *  <ul>
+ *  <li> reader (the caller) fills a batch of testing samples and pushes
+ *  it to a bounded ring (it waits if the ring is full)
+ *  <li> worker threads take batches and find kmax nearest neighbors of
+ *  their samples among all selected learning samples
+ *  <li> reading next batch and computing distances overlap
+ *  </ul>
+ *  learning samples must be loaded (and quantized) before construction
+ *  and must not change until finish; only the reader uses ROOT
+ */
+class RecoTargetPipeline
+{
+  public:
+  
+  //! constructor (start nWorkers threads; profiler = NULL: hardware
+  //! counters are not used)
+  RecoTargetPipeline (RecoTargetSampleHandler **learningSamples,
+                      const RecoTargetUserOptions &userOptions,
+                      const unsigned int &nWorkers,
+                      RecoTargetProfiler *profiler = NULL);
+  ~RecoTargetPipeline (); //!< destructor (stop workers)
+  
+  //! queue samples [first, last) of handler (already filled)
+  void push (RecoTargetSampleHandler *testingSamples,
+             const unsigned int &first, const unsigned int &last);
+  
+  //! wait until all queued batches are done (rethrow worker's error)
+  void finish ();
+  
+  //! return precision testing samples should be stored with
+  inline RecoTarget::Precision getPrecision () const
+  {
+    return (RecoTarget::Precision) userOptions.getPrecision();
+  };
+  
+  //! return true if testing samples should be converted to features
+  inline bool getFlagFeatures () const
+  {
+    return userOptions.getFlagFeatures();
+  };
+  
+  //! return planes testing samples should keep (region of learning
+  //! samples, empty = all planes)
+  std::vector <unsigned int> getRegion () const;
+  
+  private:
+  
+  //! range of testing samples
+  struct Batch
+  {
+    RecoTargetSampleHandler *samples; //!< testing samples handler
+    unsigned int first; //!< first sample in batch
+    unsigned int last;  //!< sample behind the batch
+  };
+  
+  RecoTargetSampleHandler **learningSamples; //!< samples to compare with
+  const RecoTargetUserOptions &userOptions;  //!< targets and metric
+  RecoTargetProfiler *profiler;              //!< NULL = not profiled
+  
+  std::vector <Batch> ring; //!< bounded queue of batches
+  size_t head;              //!< the oldest batch in the ring
+  size_t nQueued;           //!< number of batches in the ring
+  bool isDone;              //!< no more batches will come
+  
+  std::mutex mutex;                 //!< guards all of the above
+  std::condition_variable notEmpty; //!< signaled when batch is pushed
+  std::condition_variable notFull;  //!< signaled when batch is taken
+  
+  std::vector <std::thread> workers; //!< worker threads
+  std::exception_ptr error;          //!< the first error of workers
+  
+  //! take the oldest batch (false if there is nothing left to do)
+  bool pop (Batch &batch);
+  
+  //! worker thread: classify batches until pipeline is finished
+  void work (const unsigned int worker);
+  
+  //! pipeline owns threads, so it can not be copied
+  RecoTargetPipeline (const RecoTargetPipeline &);
+  RecoTargetPipeline& operator= (const RecoTargetPipeline &);
+};
+
+#endif
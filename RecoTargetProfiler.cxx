@@ -0,0 +1,274 @@
+#include "RecoTargetProfiler.h"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <string>
+
+namespace RecoTarget
+{
+  const char *listOfCounters[] =
+  {
+    "cycles",
+    "instructions",
+    "cache misses",
+    "branch misses"
+  };
+  
+  const char *listOfPhases[] =
+  {
+    "fill",
+    "neighbors"
+  };
+}
+
+using namespace RecoTarget;
+
+namespace
+{
+  //! perf configs of counters (in order of Counter)
+  const uint64_t configs[nCounters] =
+  {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+  };
+  
+  //! monotonic time in seconds
+  double now ()
+  {
+    timespec time;
+    clock_gettime (CLOCK_MONOTONIC, &time);
+    
+    return time.tv_sec + 1e-9 * time.tv_nsec;
+  }
+}
+
+/*! <ul>
+ *  <li> open counters of the calling thread on any cpu, the first one
+ *  which opens leads the group (it is disabled, so the group waits
+ *  for start)
+ *  <li> kernel and hypervisor are excluded, so ioctl around counted
+ *  code does not count itself
+ *  </ul>
+ */
+RecoTargetCounters :: RecoTargetCounters ()
+  : leader (-1), seconds (0.0), started (0.0)
+{
+  std::fill_n (base, 3 + nCounters, 0);
+  
+  for (unsigned int c = 0; c < nCounters; c++)
+  {
+    perf_event_attr attr;
+    memset (&attr, 0, sizeof (attr));
+    
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof (attr);
+    attr.config = configs[c];
+    attr.disabled = leader < 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP |
+                       PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    
+    fds[c] = syscall (__NR_perf_event_open, &attr, 0, -1, leader, 0);
+    
+    if (leader < 0) leader = fds[c];
+  }
+}
+
+RecoTargetCounters :: ~RecoTargetCounters ()
+{
+  for (unsigned int c = 0; c < nCounters; c++)
+    if (fds[c] >= 0) close (fds[c]);
+}
+
+//! enable the whole group
+void RecoTargetCounters :: start ()
+{
+  started = now();
+  
+  if (leader >= 0)
+    ioctl (leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+//! disable the whole group
+void RecoTargetCounters :: stop ()
+{
+  if (leader >= 0)
+    ioctl (leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  
+  seconds += now() - started;
+}
+
+/*! <ul>
+ *  <li> group is read at once: number of values, time enabled, time
+ *  running, then values of open counters in order of opening
+ *  <li> values are scaled by enabled / running (multiplexing)
+ *  </ul>
+ */
+void RecoTargetCounters :: read (uint64_t *counts, bool *isCounted) const
+{
+  uint64_t data[3 + nCounters] = {0};
+  
+  const bool isRead = readGroup (data);
+  
+  for (unsigned int i = 1; isRead and i < 3 + nCounters; i++)
+    data[i] -= base[i];
+  
+  const double scale = data[2] > 0 ? 1.0 * data[1] / data[2] : 1.0;
+  
+  unsigned int v = 0; // index of the next value
+  
+  for (unsigned int c = 0; c < nCounters; c++)
+  {
+    isCounted[c] = isRead and fds[c] >= 0 and v < data[0];
+    counts[c] = isCounted[c] ? (uint64_t) (data[3 + v++] * scale) : 0;
+  }
+}
+
+//! times enabled and running are kept by base too, so scale is right
+void RecoTargetCounters :: reset ()
+{
+  seconds = 0.0;
+  
+  if (not readGroup (base)) std::fill_n (base, 3 + nCounters, 0);
+}
+
+//! thread_local: each thread opens its own group once
+RecoTargetCounters& RecoTargetCounters :: ofThread ()
+{
+  thread_local RecoTargetCounters counters;
+  
+  return counters;
+}
+
+bool RecoTargetCounters :: readGroup (uint64_t *data) const
+{
+  return leader >= 0 and ::read (leader, data, (3 + nCounters) *
+    sizeof (*data)) >= (ssize_t) (3 * sizeof (*data));
+}
+
+RecoTargetProfiler :: Record :: Record () : nUnits (0), seconds (0.0)
+{
+  std::fill_n (counts, nCounters, 0);
+  std::fill_n (isCounted, nCounters, true);
+}
+
+//! counter is available only if it was available for both
+void RecoTargetProfiler :: Record :: add (const Record &record)
+{
+  nUnits += record.nUnits;
+  seconds += record.seconds;
+  
+  for (unsigned int c = 0; c < nCounters; c++)
+  {
+    counts[c] += record.counts[c];
+    isCounted[c] = isCounted[c] and record.isCounted[c];
+  }
+}
+
+//! threads are added in any order, records grow as needed
+void RecoTargetProfiler :: add (const Phase &phase,
+                                const unsigned int &thread,
+                                const RecoTargetCounters &counters,
+                                const uint64_t &nUnits)
+{
+  Record record;
+  
+  record.nUnits = nUnits;
+  record.seconds = counters.getSeconds();
+  counters.read (record.counts, record.isCounted);
+  
+  std::lock_guard <std::mutex> lock (mutex);
+  
+  if (records[phase].size() <= thread) records[phase].resize (thread + 1);
+  
+  records[phase][thread].add (record);
+}
+
+/*! <ul>
+ *  <li> one line per thread of each phase, then sum of all threads
+ *  <li> counts per unit (event or distance) and instructions per cycle
+ *  <li> call it when no thread is adding
+ *  </ul>
+ */
+void RecoTargetProfiler :: print (std::ostream &out) const
+{
+  // numbers are printed fixed, the stream is restored at the end
+  const std::ios_base::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  
+  out << "\nProfile (per event for fill, per distance for neighbors):\n"
+      << std::setw (10) << "phase" << std::setw (8) << "thread"
+      << std::setw (13) << "units" << std::setw (10) << "seconds";
+  
+  for (unsigned int c = 0; c < nCounters; c++)
+    out << std::setw (14) << listOfCounters[c];
+  
+  out << std::setw (8) << "IPC" << "\n";
+  
+  for (unsigned int p = 0; p < nPhases; p++)
+  {
+    Record all;
+    unsigned int nThreads = 0; // threads with some work done
+    
+    for (unsigned int t = 0; t < records[p].size(); t++)
+    {
+      if (records[p][t].nUnits == 0) continue;
+      
+      all.add (records[p][t]);
+      nThreads++;
+      
+      print (out, (Phase) p, std::to_string (t).c_str(), records[p][t]);
+    }
+    
+    if (nThreads > 1)
+      print (out, (Phase) p, "all", all);
+  }
+  
+  bool isCounted = true;
+  
+  for (unsigned int p = 0; p < nPhases; p++)
+    for (unsigned int t = 0; t < records[p].size(); t++)
+      for (unsigned int c = 0; c < nCounters; c++)
+        isCounted = isCounted and records[p][t].isCounted[c];
+  
+  if (not isCounted)
+    out << "n/a = counter not available (see "
+        << "/proc/sys/kernel/perf_event_paranoid)\n";
+  
+  out.flags (flags);
+  out.precision (precision);
+}
+
+//! counts per unit, n/a if not counted
+void RecoTargetProfiler :: print (std::ostream &out, const Phase &phase,
+                                  const char *thread, const Record &record)
+{
+  out << std::setw (10) << listOfPhases[phase] << std::setw (8) << thread
+      << std::setw (13) << record.nUnits
+      << std::setw (10) << std::fixed << std::setprecision (3)
+      << record.seconds << std::setprecision (2);
+  
+  for (unsigned int c = 0; c < nCounters; c++)
+    if (record.isCounted[c])
+      out << std::setw (14) << 1.0 * record.counts[c] / record.nUnits;
+    else
+      out << std::setw (14) << "n/a";
+  
+  if (record.isCounted[CYCLES] and record.isCounted[INSTRUCTIONS] and
+      record.counts[CYCLES] > 0)
+    out << std::setw (8)
+        << 1.0 * record.counts[INSTRUCTIONS] / record.counts[CYCLES];
+  else
+    out << std::setw (8) << "n/a";
+  
+  out << "\n";
+}
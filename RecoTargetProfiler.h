@@ -0,0 +1,139 @@
+/**
+ * @brief Hardware counters around filling samples and neighbors
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_PROFILER_H
+#define RECO_TARGET_PROFILER_H
+
+#include <stdint.h>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace RecoTarget
+{
+  const unsigned int nCounters = 4; //!< number of hardware counters
+  extern const char *listOfCounters[]; //!< list of hardware counters
+  //! hardware counters enumerator
+  enum Counter {CYCLES, INSTRUCTIONS, CACHE_MISSES, BRANCH_MISSES};
+  
+  const unsigned int nPhases = 2; //!< number of profiled phases
+  extern const char *listOfPhases[]; //!< list of profiled phases
+  //! phases enumerator (FILL = filling samples, NEIGHBORS = distances)
+  enum Phase {FILL, NEIGHBORS};
+}
+
+/*! counters of the calling thread (Linux perf_event_open, user space
+ *  only), counting only between start and stop:
+ *  <ul>
+ *  <li> all counters are one group, so they count the same code
+ *  <li> counter which can not be opened (e.g. not supported or not
+ *  allowed by perf_event_paranoid) is just not counted
+ *  <li> counts are scaled up if kernel had to multiplex counters
+ *  <li> code called many times (e.g. filling batches) uses counters of
+ *  its thread (opened once) and resets them before each count
+ *  </ul>
+ */
+class RecoTargetCounters
+{
+  public:
+  
+  RecoTargetCounters ();  //!< constructor (open counters, stopped)
+  ~RecoTargetCounters (); //!< destructor (close counters)
+  
+  //! start counting (and timing)
+  void start ();
+  
+  //! stop counting (and timing)
+  void stop ();
+  
+  //! get counts so far (isCounted = false if counter is not available)
+  void read (uint64_t *counts, bool *isCounted) const;
+  
+  //! count from zero again (counters are not closed)
+  void reset ();
+  
+  //! return counters of the calling thread (opened by the first call,
+  //! closed when thread ends)
+  static RecoTargetCounters& ofThread ();
+  
+  //! return seconds between starts and stops so far
+  inline double getSeconds () const
+  {
+    return seconds;
+  };
+  
+  private:
+  
+  int fds[RecoTarget::nCounters]; //!< file descriptors (-1 = not open)
+  int leader;                     //!< the first open descriptor
+  
+  double seconds; //!< time counted so far
+  double started; //!< when counting was started
+  
+  //! group as read by the last reset (subtracted from later reads)
+  uint64_t base[3 + RecoTarget::nCounters];
+  
+  //! read the whole group (number of values, time enabled, time
+  //! running, values); return false if it can not be read
+  bool readGroup (uint64_t *data) const;
+  
+  //! counters are owned by thread, so they can not be copied
+  RecoTargetCounters (const RecoTargetCounters &);
+  RecoTargetCounters& operator= (const RecoTargetCounters &);
+};
+
+/*! counts of all threads, added when a thread is done with its part
+ *  of a phase; report gives each phase and thread normalized per unit
+ *  (event for FILL, distance for NEIGHBORS):
+ *  <ul>
+ *  <li> instructions per cycle: low IPC with many cache misses per
+ *  unit = memory-bound, high IPC = compute-bound
+ *  <li> branch misses per unit show data dependent branches (e.g.
+ *  skipping learning samples by index)
+ *  </ul>
+ */
+class RecoTargetProfiler
+{
+  public:
+  
+  //! add counts of thread for units of work done in phase
+  void add (const RecoTarget::Phase &phase, const unsigned int &thread,
+            const RecoTargetCounters &counters, const uint64_t &nUnits);
+  
+  //! print table of phases and threads
+  void print (std::ostream &out) const;
+  
+  private:
+  
+  //! counts of one thread in one phase
+  struct Record
+  {
+    uint64_t nUnits; //!< events or distances
+    double seconds;  //!< time spent counting
+    
+    uint64_t counts[RecoTarget::nCounters]; //!< hardware counts
+    bool isCounted[RecoTarget::nCounters];  //!< false = not available
+    
+    //! constructor (nothing counted yet)
+    Record ();
+    
+    //! add counts of another record
+    void add (const Record &record);
+  };
+  
+  std::mutex mutex; //!< guards records (threads add at the same time)
+  
+  //! records of each phase, one per thread
+  std::vector <Record> records[RecoTarget::nPhases];
+  
+  //! print one line of table
+  static void print (std::ostream &out, const RecoTarget::Phase &phase,
+                     const char *thread, const Record &record);
+};
+
+#endif
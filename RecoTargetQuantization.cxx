@@ -0,0 +1,353 @@
+#include "RecoTargetQuantization.h"
+#include "RecoTargetException.h"
+#include <cmath>
+#include <cstdlib>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace RecoTarget;
+
+namespace RecoTarget
+{
+  //! use for understandable cout's
+  const char *listOfPrecisions[] =
+  {
+    "double",
+    "float",
+    "int16 (fixed point)",
+    "uint8 (fixed point)"
+  };
+}
+
+namespace
+{
+  const double int16Scale = 16384.0; //!< 2^14 (see class description)
+  const double uint8Scale = 255.0;   //!< full uint8 range
+  
+#ifdef __SSE2__
+  //! return sum of 4 floats
+  inline double sumFloats (const __m128 &x)
+  {
+    float lanes[4];
+    _mm_storeu_ps (lanes, x);
+    return (double) lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+  
+  //! return sum of 4 int32
+  inline int32_t sumInts (const __m128i &x)
+  {
+    int32_t lanes[4];
+    _mm_storeu_si128 ((__m128i*) lanes, x);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+#endif
+
+  //! distance between two float distributions (4 planes per step)
+  double distanceFloat (const float *x, const float *y,
+                        const unsigned int &n, const Metric &metric)
+  {
+    double distance = 0.0;
+    unsigned int i = 0;
+    
+    switch (metric)
+    {
+      case EUCLIDEAN:
+#ifdef __SSE2__
+      {
+        __m128 sum = _mm_setzero_ps();
+        for (; i + 4 <= n; i += 4)
+        {
+          const __m128 d = _mm_sub_ps (_mm_loadu_ps (x + i),
+                                       _mm_loadu_ps (y + i));
+          sum = _mm_add_ps (sum, _mm_mul_ps (d, d));
+        }
+        distance = sumFloats (sum);
+      }
+#endif
+        for (; i < n; i++) distance += (x[i] - y[i]) * (x[i] - y[i]);
+        break;
+      case MANHATTAN:
+#ifdef __SSE2__
+      {
+        const __m128 signMask = _mm_set1_ps (-0.0f);
+        __m128 sum = _mm_setzero_ps();
+        for (; i + 4 <= n; i += 4)
+        {
+          const __m128 d = _mm_sub_ps (_mm_loadu_ps (x + i),
+                                       _mm_loadu_ps (y + i));
+          sum = _mm_add_ps (sum, _mm_andnot_ps (signMask, d));
+        }
+        distance = sumFloats (sum);
+      }
+#endif
+        for (; i < n; i++) distance += fabs (x[i] - y[i]);
+        break;
+      case COSINE:
+#ifdef __SSE2__
+      {
+        __m128 sum = _mm_setzero_ps();
+        for (; i + 4 <= n; i += 4)
+          sum = _mm_add_ps (sum, _mm_mul_ps (_mm_loadu_ps (x + i),
+                                             _mm_loadu_ps (y + i)));
+        distance = -sumFloats (sum);
+      }
+#endif
+        for (; i < n; i++) distance -= x[i] * y[i];
+        break;
+      default:
+        throw Exception (UNDEFINED_METRIC, "undefined metric");
+    }
+    
+    return distance;
+  }
+  
+  //! distance between two int16 distributions (8 planes per step)
+  int32_t distanceInt16 (const int16_t *x, const int16_t *y,
+                         const unsigned int &n, const Metric &metric)
+  {
+    int32_t distance = 0;
+    unsigned int i = 0;
+    
+    switch (metric)
+    {
+      case EUCLIDEAN:
+#ifdef __SSE2__
+      {
+        __m128i sum = _mm_setzero_si128();
+        for (; i + 8 <= n; i += 8)
+        {
+          const __m128i d =
+            _mm_sub_epi16 (_mm_loadu_si128 ((const __m128i*) (x + i)),
+                           _mm_loadu_si128 ((const __m128i*) (y + i)));
+          sum = _mm_add_epi32 (sum, _mm_madd_epi16 (d, d));
+        }
+        distance = sumInts (sum);
+      }
+#endif
+        for (; i < n; i++) distance += (x[i] - y[i]) * (x[i] - y[i]);
+        break;
+      case MANHATTAN:
+#ifdef __SSE2__
+      {
+        const __m128i ones = _mm_set1_epi16 (1);
+        __m128i sum = _mm_setzero_si128();
+        for (; i + 8 <= n; i += 8)
+        {
+          const __m128i a = _mm_loadu_si128 ((const __m128i*) (x + i));
+          const __m128i b = _mm_loadu_si128 ((const __m128i*) (y + i));
+          const __m128i d = _mm_sub_epi16 (_mm_max_epi16 (a, b),
+                                           _mm_min_epi16 (a, b));
+          sum = _mm_add_epi32 (sum, _mm_madd_epi16 (d, ones));
+        }
+        distance = sumInts (sum);
+      }
+#endif
+        for (; i < n; i++) distance += abs (x[i] - y[i]);
+        break;
+      case COSINE:
+#ifdef __SSE2__
+      {
+        __m128i sum = _mm_setzero_si128();
+        for (; i + 8 <= n; i += 8)
+          sum = _mm_add_epi32 (sum, _mm_madd_epi16
+            (_mm_loadu_si128 ((const __m128i*) (x + i)),
+             _mm_loadu_si128 ((const __m128i*) (y + i))));
+        distance = -sumInts (sum);
+      }
+#endif
+        for (; i < n; i++) distance -= x[i] * y[i];
+        break;
+      default:
+        throw Exception (UNDEFINED_METRIC, "undefined metric");
+    }
+    
+    return distance;
+  }
+  
+  //! distance between two uint8 distributions (16 planes per step)
+  int32_t distanceUint8 (const uint8_t *x, const uint8_t *y,
+                         const unsigned int &n, const Metric &metric)
+  {
+    int32_t distance = 0;
+    unsigned int i = 0;
+    
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+#endif
+    
+    switch (metric)
+    {
+      case EUCLIDEAN:
+#ifdef __SSE2__
+      {
+        __m128i sum = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16)
+        {
+          const __m128i a = _mm_loadu_si128 ((const __m128i*) (x + i));
+          const __m128i b = _mm_loadu_si128 ((const __m128i*) (y + i));
+          const __m128i dLow = _mm_sub_epi16 (_mm_unpacklo_epi8 (a, zero),
+                                              _mm_unpacklo_epi8 (b, zero));
+          const __m128i dHigh = _mm_sub_epi16 (_mm_unpackhi_epi8 (a, zero),
+                                               _mm_unpackhi_epi8 (b, zero));
+          sum = _mm_add_epi32 (sum, _mm_madd_epi16 (dLow, dLow));
+          sum = _mm_add_epi32 (sum, _mm_madd_epi16 (dHigh, dHigh));
+        }
+        distance = sumInts (sum);
+      }
+#endif
+        for (; i < n; i++) distance += (x[i] - y[i]) * (x[i] - y[i]);
+        break;
+      case MANHATTAN:
+#ifdef __SSE2__
+      {
+        // sum of absolute differences gives two partial sums
+        __m128i sum = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16)
+          sum = _mm_add_epi64 (sum, _mm_sad_epu8
+            (_mm_loadu_si128 ((const __m128i*) (x + i)),
+             _mm_loadu_si128 ((const __m128i*) (y + i))));
+        distance = sumInts (sum);
+      }
+#endif
+        for (; i < n; i++) distance += abs (x[i] - y[i]);
+        break;
+      case COSINE:
+#ifdef __SSE2__
+      {
+        __m128i sum = _mm_setzero_si128();
+        for (; i + 16 <= n; i += 16)
+        {
+          const __m128i a = _mm_loadu_si128 ((const __m128i*) (x + i));
+          const __m128i b = _mm_loadu_si128 ((const __m128i*) (y + i));
+          sum = _mm_add_epi32 (sum, _mm_madd_epi16
+            (_mm_unpacklo_epi8 (a, zero), _mm_unpacklo_epi8 (b, zero)));
+          sum = _mm_add_epi32 (sum, _mm_madd_epi16
+            (_mm_unpackhi_epi8 (a, zero), _mm_unpackhi_epi8 (b, zero)));
+        }
+        distance = -sumInts (sum);
+      }
+#endif
+        for (; i < n; i++) distance -= x[i] * y[i];
+        break;
+      default:
+        throw Exception (UNDEFINED_METRIC, "undefined metric");
+    }
+    
+    return distance;
+  }
+}
+
+RecoTargetQuantizedSamples :: RecoTargetQuantizedSamples
+  (const Precision &precision, const unsigned int &n,
+   const unsigned int &nDimensions)
+  : precision (precision), scale (1.0), nDimensions (nDimensions)
+{
+  switch (precision)
+  {
+    case FLOAT:
+      break;
+    case INT16:
+      scale = int16Scale;
+      break;
+    case UINT8:
+      scale = uint8Scale;
+      break;
+    default:
+      throw Exception (BAD_ARGUMENT, "undefined quantized precision");
+  }
+  
+  resize (n);
+}
+
+//! resize storage of chosen precision
+void RecoTargetQuantizedSamples :: resize (const unsigned int &n)
+{
+  inverseNorms.resize (n);
+  
+  switch (precision)
+  {
+    case FLOAT:
+      floats.resize (n * nDimensions);
+      break;
+    case INT16:
+      shorts.resize (n * nDimensions);
+      break;
+    default:
+      bytes.resize (n * nDimensions);
+      break;
+  }
+}
+
+//! convert energy to float or round (scale * energy)
+void RecoTargetQuantizedSamples :: set (const unsigned int &i,
+                                        const double *energyPerPlane)
+{
+  const unsigned int offset = i * nDimensions;
+  
+  double norm2 = 0.0;
+  
+  for (unsigned int p = 0; p < nDimensions; p++)
+    norm2 += energyPerPlane[p] * energyPerPlane[p];
+    
+  inverseNorms[i] = norm2 > 0.0 ? 1.0 / sqrt (norm2) : 0.0;
+  
+  for (unsigned int p = 0; p < nDimensions; p++)
+    switch (precision)
+    {
+      case FLOAT:
+        floats[offset + p] = energyPerPlane[p];
+        break;
+      case INT16:
+        shorts[offset + p] = floor (scale * energyPerPlane[p] + 0.5);
+        break;
+      default:
+        bytes[offset + p] = floor (scale * energyPerPlane[p] + 0.5);
+        break;
+    }
+}
+
+/*! <ul>
+ *  <li> call SIMD kernel for chosen precision
+ *  <li> fixed-point distances are divided by scale (Manhattan)
+ *  or scale^2 (Euclidean, cosine)
+ *  <li> normalized cosine = 1 + (minus dot product) * inverse norms
+ *  </ul>
+ */
+double RecoTargetQuantizedSamples :: distance
+  (const unsigned int &i, const RecoTargetQuantizedSamples &other,
+   const unsigned int &j, const Metric &metric) const
+{
+  const unsigned int x = i * nDimensions; // offset of i-th sample
+  const unsigned int y = j * nDimensions; // offset of j-th sample in other
+  
+  // normalized cosine uses the dot product kernel
+  const Metric kernel = metric == NORMALIZED_COSINE ? COSINE : metric;
+  
+  double distance = 0.0;
+  
+  switch (precision)
+  {
+    case FLOAT:
+      distance = distanceFloat (&floats[x], &other.floats[y], nDimensions,
+                                kernel);
+      break;
+    case INT16:
+      distance = distanceInt16 (&shorts[x], &other.shorts[y], nDimensions,
+                                kernel);
+      break;
+    default:
+      distance = distanceUint8 (&bytes[x], &other.bytes[y], nDimensions,
+                                kernel);
+      break;
+  }
+  
+  if (precision != FLOAT)
+    distance /= kernel == MANHATTAN ? scale : scale * scale;
+  
+  if (metric == NORMALIZED_COSINE)
+    return 1.0 + distance * inverseNorms[i] * other.inverseNorms[j];
+    
+  return distance;
+}
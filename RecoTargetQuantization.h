@@ -0,0 +1,89 @@
+/**
+ * @brief Reduced precision storage of plane energy distributions
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_QUANTIZATION_H
+#define RECO_TARGET_QUANTIZATION_H
+
+#include "RecoTargetDetectorProperties.h"
+#include "RecoTargetMetrics.h"
+#include <vector>
+#include <stdint.h>
+
+namespace RecoTarget
+{
+  const unsigned int nPrecisions = 4; //!< number of storage precisions
+  extern const char *listOfPrecisions[]; //!< list of storage precisions
+  //! precisions enumerator
+  enum Precision {DOUBLE, FLOAT, INT16, UINT8};
+}
+
+/*! energy per plane (normalized to 1, so in [0, 1]) for all samples
+ *  stored contiguously as float or fixed-point int16 / uint8
+ *
+ *  int16 uses scale 2^14, so for L1-normalized distributions the sum
+ *  of (x - y)^2 and x * y can not overflow int32 accumulators
+ * 
+ *  the copy is kept next to double distributions of samples (the run is
+ *  repeated in double to report what was lost), so it saves memory
+ *  traffic of distances, not memory; a handler frees its doubles only
+ *  if asked (RecoTargetSampleHandler::dropDistributions)
+ *
+ *  rows are dense (all dimensions) even for compressed samples, so the
+ *  copy of a compressed testing set is not smaller
+ */
+class RecoTargetQuantizedSamples
+{
+  public:
+  
+  //! constructor (precision must not be DOUBLE, n = number of samples
+  //! of nDimensions values each)
+  RecoTargetQuantizedSamples (const RecoTarget::Precision &precision,
+                              const unsigned int &n,
+                              const unsigned int &nDimensions =
+                                RecoTarget::nPlanes);
+  
+  //! set the number of samples (keeps allocated memory if shrinks)
+  void resize (const unsigned int &n);
+  
+  //! save i-th sample (first nDimensions values, and its inverse norm)
+  void set (const unsigned int &i, const double *energyPerPlane);
+  
+  //! distance between i-th sample and j-th sample of other (in units
+  //! of double precision metric)
+  double distance (const unsigned int &i,
+                   const RecoTargetQuantizedSamples &other,
+                   const unsigned int &j,
+                   const RecoTarget::Metric &metric) const;
+  
+  //! return precision
+  inline RecoTarget::Precision getPrecision () const
+  {
+    return precision;
+  };
+  
+  //! return the number of values per sample
+  inline unsigned int getNDimensions () const
+  {
+    return nDimensions;
+  };
+  
+  private:
+  
+  RecoTarget::Precision precision; //!< storage precision
+  double scale; //!< fixed-point value = round (scale * energy)
+  unsigned int nDimensions; //!< values per sample (stride of storage)
+  
+  std::vector <float> floats;    //!< FLOAT storage
+  std::vector <int16_t> shorts;  //!< INT16 storage
+  std::vector <uint8_t> bytes;   //!< UINT8 storage
+  
+  //! 1 / Euclidean norm of each sample (from double, for cosine)
+  std::vector <double> inverseNorms;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "RecoTargetRanking.h"
+#include <algorithm>
+
+using namespace RecoTarget;
+
+RecoTargetRanking :: RecoTargetRanking (const unsigned int &kMax,
+                                        const Vote &vote)
+  : kMax (kMax), vote (vote), confusion (kMax * nTargets * nTargets, 0),
+    margins (kMax * nTargets, 0.0)
+{
+  std::fill_n (nSamples, nTargets, 0);
+}
+
+/*! <ul>
+ *  <li> keep sorted kmax nearest neighbors of each sample
+ *  <li> add votes of neighbors one by one (Gaussian: recount all with
+ *  the scale of the k-th neighbor), in the same order as closestTarget
+ *  does, so sums and predictions are the same
+ *  <li> k larger than the number of neighbors uses all of them
+ *  <li> winner = the first target with the highest score (0 if none)
+ *  </ul>
+ */
+void RecoTargetRanking :: add (RecoTargetSampleHandler *testingSamples,
+                               const unsigned int &target)
+{
+  testingSamples->keepNearest (kMax);
+  
+  double (*pVote)(const double&, const double&) = voteFunction (vote);
+  
+  const bool isScaled = vote == GAUSSIAN;
+  
+  for (unsigned int i = 0; i < testingSamples->getNSamples(); i++)
+  {
+    const std::vector <Neighbor> &neighbors =
+      testingSamples->getNeighbors (i);
+    
+    double targetScore[nTargets] = {0.0};
+    double totalScore = 0.0;
+    
+    unsigned int predicted = 0;
+    double margin = 0.0;
+    
+    for (unsigned int k = 1; k <= kMax; k++)
+    {
+      if (k <= neighbors.size())
+      {
+        const double scale = neighbors[k - 1].distance;
+        
+        if (isScaled)
+        {
+          std::fill_n (targetScore, nTargets, 0.0);
+          totalScore = 0.0;
+        }
+        
+        for (unsigned int j = isScaled ? 0 : k - 1; j < k; j++)
+        {
+          const double score = pVote (neighbors[j].distance, scale);
+          targetScore[neighbors[j].target] += score;
+          totalScore += score;
+        }
+        
+        double bestScore = 0.0;
+        double secondScore = 0.0;
+        
+        predicted = 0;
+        
+        for (unsigned int t = 0; t < nTargets; t++)
+          if (targetScore[t] > bestScore)
+          {
+            secondScore = bestScore;
+            bestScore = targetScore[t];
+            predicted = t;
+          }
+          else secondScore = std::max (secondScore, targetScore[t]);
+        
+        margin = totalScore > 0.0 ? (bestScore - secondScore) / totalScore
+                                  : 0.0;
+      }
+      
+      confusion[((k - 1) * nTargets + target) * nTargets + predicted]++;
+      margins[(k - 1) * nTargets + target] += margin;
+    }
+  }
+  
+  nSamples[target] += testingSamples->getNSamples();
+}
+
+//! diagonal of confusion matrix / samples
+double RecoTargetRanking :: getScore (const unsigned int &target,
+                                      const unsigned int &k) const
+{
+  return 1.0 * getConfusion (target, target, k) / nSamples[target];
+}
+
+//! sum of margins / samples
+double RecoTargetRanking :: getMargin (const unsigned int &target,
+                                       const unsigned int &k) const
+{
+  return margins[(k - 1) * nTargets + target] / nSamples[target];
+}
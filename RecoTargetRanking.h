@@ -0,0 +1,82 @@
+/**
+ * @brief Votes of testing samples for every k up to kmax
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_RANKING_H
+#define RECO_TARGET_RANKING_H
+
+#include "RecoTargetSampleHandler.h"
+#include "RecoTargetVoting.h"
+#include <vector>
+
+/*! neighbors of each testing sample are sorted once (top-kmax prefix),
+ *  then votes are counted neighbor by neighbor, so the result for k + 1
+ *  costs one more vote on top of the result for k:
+ *  <ul>
+ *  <li> confusion matrix (true target x predicted target) for every k
+ *  <li> mean vote margin (winner's share - runner-up's share) for every k
+ *  <li> Gaussian vote depends on the distance to the k-th neighbor, so
+ *  its votes are recounted for each k (still without sorting)
+ *  </ul>
+ *  predictions are the same as closestTarget gives for each k
+ */
+class RecoTargetRanking
+{
+  public:
+  
+  //! constructor (the largest k, vote)
+  RecoTargetRanking (const unsigned int &kMax,
+                     const RecoTarget::Vote &vote = RecoTarget::MAJORITY);
+  
+  //! add votes of all samples of given (true) target; their neighbors
+  //! are trimmed to sorted kmax nearest
+  void add (RecoTargetSampleHandler *testingSamples,
+            const unsigned int &target);
+  
+  //! return the largest k
+  inline unsigned int getMaxNeighbors () const
+  {
+    return kMax;
+  };
+  
+  //! return the number of samples added for target
+  inline unsigned int getNSamples (const unsigned int &target) const
+  {
+    return nSamples[target];
+  };
+  
+  //! return the number of samples of target predicted as "predicted"
+  //! with k nearest neighbors (k = 1 .. kmax)
+  inline unsigned int getConfusion (const unsigned int &target,
+                                    const unsigned int &predicted,
+                                    const unsigned int &k) const
+  {
+    return confusion[((k - 1) * RecoTarget::nTargets + target) *
+                     RecoTarget::nTargets + predicted];
+  };
+  
+  //! return the fraction of samples of target predicted correctly
+  double getScore (const unsigned int &target, const unsigned int &k) const;
+  
+  //! return mean vote margin of samples of target
+  double getMargin (const unsigned int &target, const unsigned int &k) const;
+  
+  private:
+  
+  unsigned int kMax;     //!< the largest k
+  RecoTarget::Vote vote; //!< how neighbors vote
+  
+  unsigned int nSamples[RecoTarget::nTargets]; //!< samples per target
+  
+  //! kmax x nTargets x nTargets counts
+  std::vector <unsigned int> confusion;
+  
+  //! kmax x nTargets sums of margins
+  std::vector <double> margins;
+};
+
+#endif
@@ -0,0 +1,457 @@
+#include "RecoTargetReduction.h"
+#include "RecoTargetFeatures.h"
+#include "RecoTargetException.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unistd.h>
+
+using namespace RecoTarget;
+
+namespace RecoTarget
+{
+  //! use for understandable cout's
+  const char *listOfReductions[] =
+  {
+    "Full learning set",
+    "Wilson editing",
+    "Hart condensing",
+    "Wilson editing + Hart condensing",
+    "k-means prototypes"
+  };
+}
+
+namespace
+{
+  const uint64_t reducedMagic = 0x3130445254524552ull; //!< "RERTRD01"
+  
+  //! what is saved for each target
+  struct TargetHeader
+  {
+    uint32_t isUsed;      //!< 1 if learning samples of target were loaded
+    uint32_t nDimensions; //!< doubles per sample
+    uint64_t nSamples;    //!< number of samples
+  };
+}
+
+RecoTargetReduction :: RecoTargetReduction (const Reduction &reduction,
+                                            const Metric &metric,
+                                            const unsigned int &seed)
+  : reduction (reduction), metric (metric), seed (seed), nFull (0),
+    nReduced (0)
+{
+}
+
+/*! <ul>
+ *  <li> remove quantized copies (neighbors are found in double)
+ *  <li> edit and/or condense all targets together (both need samples
+ *  of other targets), or find prototypes target by target
+ *  </ul>
+ */
+void RecoTargetReduction :: reduce (RecoTargetSampleHandler **learningSamples)
+{
+  nFull = nReduced = 0;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (learningSamples[i])
+    {
+      learningSamples[i]->quantize (DOUBLE);
+      nFull += learningSamples[i]->nSamples;
+    }
+  
+  if (reduction == EDITED or reduction == EDITED_CONDENSED)
+    edit (learningSamples);
+  
+  if (reduction == CONDENSED or reduction == EDITED_CONDENSED)
+    condense (learningSamples);
+  
+  if (reduction == PROTOTYPES)
+    for (unsigned int i = 0; i < nTargets; i++)
+      if (learningSamples[i]) prototypes (learningSamples[i]);
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (learningSamples[i]) nReduced += learningSamples[i]->nSamples;
+}
+
+/*! <ul>
+ *  <li> find editingNeighbors + 1 nearest learning samples of each
+ *  learning sample (index is used if available)
+ *  <li> drop the sample itself from its list
+ *  <li> mark sample for removal if majority votes for other target
+ *  <li> remove all marked samples at the end (so the order of targets
+ *  does not matter)
+ *  </ul>
+ */
+void RecoTargetReduction :: edit (RecoTargetSampleHandler **learningSamples)
+  const
+{
+  std::vector <bool> isKept[nTargets];
+  std::vector < std::vector <Neighbor> > lists;
+  
+  for (unsigned int h = 0; h < nTargets; h++)
+  {
+    RecoTargetSampleHandler *sampleHandler = learningSamples[h];
+    
+    if (not sampleHandler) continue;
+    
+    const unsigned int n = sampleHandler->nSamples;
+    
+    lists.resize (std::max <size_t> (lists.size(), n));
+    
+    for (unsigned int t = 0; t < nTargets; t++)
+      if (learningSamples[t])
+        sampleHandler->nearestNeighbors (learningSamples[t], t, metric, 0, n,
+                                         0, learningSamples[t]->nSamples,
+                                         editingNeighbors + 1, &lists[0]);
+    
+    isKept[h].assign (n, true);
+    
+    for (unsigned int i = 0; i < n; i++)
+    {
+      const Neighbor self (0.0, h, sampleHandler->firstId + i);
+      
+      std::vector <Neighbor> &list = lists[i];
+      
+      for (unsigned int j = 0; j < list.size(); j++)
+        if (list[j].target == self.target and list[j].id == self.id)
+        {
+          list.erase (list.begin() + j);
+          break;
+        }
+      
+      sampleHandler->addNeighbors (i, list);
+      
+      isKept[h][i] = sampleHandler->samples[i].closestTarget
+        (editingNeighbors) == (int) h;
+    }
+    
+    sampleHandler->clearNeighbors();
+  }
+  
+  for (unsigned int h = 0; h < nTargets; h++)
+    if (learningSamples[h]) keep (learningSamples[h], isKept[h]);
+}
+
+/*! <ul>
+ *  <li> start with the first sample of each target
+ *  <li> add every sample misclassified by its nearest kept sample
+ *  <li> repeat until a pass over all samples adds nothing
+ *  </ul>
+ */
+void RecoTargetReduction :: condense
+  (RecoTargetSampleHandler **learningSamples) const
+{
+  std::vector <bool> isKept[nTargets];
+  
+  // kept samples as (target, sample)
+  std::vector < std::pair <unsigned int, unsigned int> > kept;
+  
+  for (unsigned int t = 0; t < nTargets; t++)
+  {
+    if (not learningSamples[t]) continue;
+    
+    isKept[t].assign (learningSamples[t]->nSamples, false);
+    
+    if (isKept[t].empty()) continue;
+    
+    isKept[t][0] = true;
+    kept.push_back (std::make_pair (t, 0u));
+  }
+  
+  for (bool isChanged = true; isChanged;)
+  {
+    isChanged = false;
+    
+    for (unsigned int t = 0; t < nTargets; t++)
+      for (unsigned int i = 0; i < isKept[t].size(); i++)
+      {
+        if (isKept[t][i]) continue;
+        
+        const RecoTargetSampleHandler::Sample &sample =
+          learningSamples[t]->samples[i];
+        
+        double nearest = HUGE_VAL;
+        unsigned int nearestTarget = t;
+        
+        for (unsigned int s = 0; s < kept.size(); s++)
+        {
+          const double distance = sample.distance
+            (learningSamples[kept[s].first]->samples[kept[s].second],
+             metric);
+          
+          if (distance < nearest)
+          {
+            nearest = distance;
+            nearestTarget = kept[s].first;
+          }
+        }
+        
+        if (nearestTarget == t) continue;
+        
+        isKept[t][i] = true;
+        kept.push_back (std::make_pair (t, i));
+        isChanged = true;
+      }
+  }
+  
+  for (unsigned int t = 0; t < nTargets; t++)
+    if (learningSamples[t]) keep (learningSamples[t], isKept[t]);
+}
+
+/*! <ul>
+ *  <li> initial centers = distinct samples chosen at random (seeded)
+ *  <li> Lloyd iterations: assign samples to the nearest center
+ *  (Euclidean), move centers to means (empty clusters stay)
+ *  <li> stop if no sample changes its cluster (or after
+ *  prototypeIterations)
+ *  <li> centers replace the first samples, the rest is dropped
+ *  </ul>
+ */
+void RecoTargetReduction :: prototypes
+  (RecoTargetSampleHandler *sampleHandler) const
+{
+  std::vector <RecoTargetSampleHandler::Sample> &samples =
+    sampleHandler->samples;
+  
+  const unsigned int n = sampleHandler->nSamples;
+  
+  if (n == 0) return;
+  
+  const unsigned int m = (n + prototypeRatio - 1) / prototypeRatio;
+  const unsigned int d = samples[0].nDimensions;
+  
+  // partial Fisher-Yates shuffle picks m distinct samples
+  std::mt19937 generator (seed);
+  std::vector <unsigned int> order (n);
+  
+  for (unsigned int i = 0; i < n; i++) order[i] = i;
+  
+  std::vector <double> centers (m * d);
+  
+  for (unsigned int c = 0; c < m; c++)
+  {
+    std::swap (order[c], order[c + generator() % (n - c)]);
+    
+    std::copy (samples[order[c]].energyPerPlane,
+               samples[order[c]].energyPerPlane + d, &centers[c * d]);
+  }
+  
+  std::vector <unsigned int> cluster (n, m); // m = not assigned yet
+  std::vector <unsigned int> counts (m);
+  std::vector <double> sums (m * d);
+  
+  for (unsigned int iteration = 0; iteration < prototypeIterations;
+       iteration++)
+  {
+    bool isChanged = false;
+    
+    for (unsigned int i = 0; i < n; i++)
+    {
+      double nearest = HUGE_VAL;
+      unsigned int best = 0;
+      
+      for (unsigned int c = 0; c < m; c++)
+      {
+        double distance2 = 0.0;
+        
+        for (unsigned int p = 0; p < d; p++)
+        {
+          const double delta =
+            samples[i].energyPerPlane[p] - centers[c * d + p];
+          distance2 += delta * delta;
+        }
+        
+        if (distance2 < nearest)
+        {
+          nearest = distance2;
+          best = c;
+        }
+      }
+      
+      isChanged = isChanged or cluster[i] != best;
+      cluster[i] = best;
+    }
+    
+    if (not isChanged) break;
+    
+    std::fill (counts.begin(), counts.end(), 0);
+    std::fill (sums.begin(), sums.end(), 0.0);
+    
+    for (unsigned int i = 0; i < n; i++)
+    {
+      counts[cluster[i]]++;
+      
+      for (unsigned int p = 0; p < d; p++)
+        sums[cluster[i] * d + p] += samples[i].energyPerPlane[p];
+    }
+    
+    for (unsigned int c = 0; c < m; c++)
+      if (counts[c] > 0)
+        for (unsigned int p = 0; p < d; p++)
+          centers[c * d + p] = sums[c * d + p] / counts[c];
+  }
+  
+  for (unsigned int c = 0; c < m; c++)
+  {
+    RecoTargetSampleHandler::Sample &sample = samples[c];
+    
+    std::copy (&centers[c * d], &centers[c * d] + d, sample.energyPerPlane);
+    std::fill (sample.energyPerPlane + d, sample.energyPerPlane + nPlanes,
+               0.0);
+    
+    sample.updateNorms();
+  }
+  
+  sampleHandler->nSamples = m;
+  sampleHandler->clearNeighbors();
+  sampleHandler->updateCopies();
+}
+
+//! move kept samples to the front (swap keeps buffers in the pool)
+void RecoTargetReduction :: keep (RecoTargetSampleHandler *sampleHandler,
+                                  const std::vector <bool> &isKept)
+{
+  std::vector <RecoTargetSampleHandler::Sample> &samples =
+    sampleHandler->samples;
+  
+  unsigned int n = 0;
+  
+  for (unsigned int i = 0; i < sampleHandler->nSamples; i++)
+    if (isKept[i])
+    {
+      if (i != n) std::swap (samples[n], samples[i]);
+      n++;
+    }
+  
+  sampleHandler->nSamples = n;
+  sampleHandler->clearNeighbors();
+  sampleHandler->updateCopies();
+}
+
+/*! file layout:
+ *  <ul>
+ *  <li> magic (uint64)
+ *  <li> TargetHeader for each target
+ *  <li> used dimensions of all samples (double), target by target
+ *  </ul>
+ *  written to temporary file and renamed (as event store is)
+ */
+void RecoTargetReduction :: save (RecoTargetSampleHandler **learningSamples,
+                                  const char *fileName)
+{
+  char suffix[32];
+  snprintf (suffix, sizeof (suffix), ".tmp%d", (int) getpid());
+  
+  const std::string tmpName = std::string (fileName) + suffix;
+  
+  FILE *file = fopen (tmpName.c_str(), "wb");
+  
+  if (not file)
+    throw Exception (BAD_FILE, "can not create " + tmpName);
+  
+  TargetHeader headers[nTargets];
+  
+  for (unsigned int t = 0; t < nTargets; t++)
+  {
+    const RecoTargetSampleHandler *sampleHandler = learningSamples[t];
+    
+    headers[t].isUsed = sampleHandler != NULL;
+    headers[t].nSamples = sampleHandler ? sampleHandler->nSamples : 0;
+    headers[t].nDimensions =
+      sampleHandler and sampleHandler->isFeatures ? nFeatures : nPlanes;
+  }
+  
+  bool isWritten =
+    fwrite (&reducedMagic, sizeof (reducedMagic), 1, file) == 1 and
+    fwrite (headers, sizeof (headers), 1, file) == 1;
+  
+  for (unsigned int t = 0; t < nTargets and isWritten; t++)
+    for (unsigned int i = 0; i < headers[t].nSamples and isWritten; i++)
+      isWritten = fwrite (learningSamples[t]->samples[i].energyPerPlane,
+                          sizeof (double), headers[t].nDimensions, file)
+                  == headers[t].nDimensions;
+  
+  if (fclose (file) != 0 or not isWritten or
+      rename (tmpName.c_str(), fileName) != 0)
+  {
+    remove (tmpName.c_str());
+    throw Exception (BAD_FILE, std::string ("can not write ") + fileName);
+  }
+}
+
+/*! <ul>
+ *  <li> check header (magic, type of samples, all targets present)
+ *  <li> create handlers and read samples (the rest of planes is zero)
+ *  </ul>
+ */
+void RecoTargetReduction :: load (RecoTargetSampleHandler **learningSamples,
+                                  const bool *isLearningTarget,
+                                  const bool &features,
+                                  const char *fileName)
+{
+  const std::string name (fileName);
+  
+  FILE *file = fopen (fileName, "rb");
+  
+  if (not file) throw Exception (BAD_FILE, "can not open " + name);
+  
+  uint64_t magic = 0;
+  TargetHeader headers[nTargets];
+  
+  const unsigned int nDimensions = features ? nFeatures : nPlanes;
+  
+  std::string error;
+  
+  if (fread (&magic, sizeof (magic), 1, file) != 1 or
+      fread (headers, sizeof (headers), 1, file) != 1 or
+      magic != reducedMagic)
+    error = "corrupted reduced set " + name;
+  
+  for (unsigned int t = 0; t < nTargets and error.empty(); t++)
+  {
+    if (headers[t].isUsed and headers[t].nDimensions != nDimensions)
+      error = name + (features ? " was saved without features"
+                               : " was saved with features");
+    else if (isLearningTarget[t] and not headers[t].isUsed)
+      error = name + " does not contain target " + char ('1' + t);
+  }
+  
+  for (unsigned int t = 0; t < nTargets and error.empty(); t++)
+  {
+    if (not headers[t].isUsed) continue;
+    
+    RecoTargetSampleHandler *sampleHandler =
+      new RecoTargetSampleHandler (headers[t].nSamples);
+    
+    sampleHandler->isFeatures = features;
+    
+    for (unsigned int i = 0; i < headers[t].nSamples; i++)
+    {
+      RecoTargetSampleHandler::Sample &sample = sampleHandler->samples[i];
+      
+      if (fread (sample.energyPerPlane, sizeof (double), nDimensions, file)
+          != nDimensions)
+      {
+        error = "corrupted reduced set " + name;
+        break;
+      }
+      
+      std::fill (sample.energyPerPlane + nDimensions,
+                 sample.energyPerPlane + nPlanes, 0.0);
+      
+      sample.nDimensions = nDimensions;
+      sample.updateNorms();
+    }
+    
+    if (isLearningTarget[t] and error.empty())
+      learningSamples[t] = sampleHandler;
+    else
+      delete sampleHandler;
+  }
+  
+  fclose (file);
+  
+  if (not error.empty()) throw Exception (BAD_FILE, error);
+}
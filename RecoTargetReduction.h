@@ -0,0 +1,102 @@
+/**
+ * @brief Smaller reference set built from learning samples
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_REDUCTION_H
+#define RECO_TARGET_REDUCTION_H
+
+#include "RecoTargetSampleHandler.h"
+#include "RecoTargetMetrics.h"
+
+namespace RecoTarget
+{
+  const unsigned int nReductions = 5; //!< number of implemented reductions
+  extern const char *listOfReductions[]; //!< list of reductions
+  //! reductions enumerator
+  enum Reduction {FULL, EDITED, CONDENSED, EDITED_CONDENSED, PROTOTYPES};
+  
+  //! the number of neighbors voting in Wilson editing
+  const unsigned int editingNeighbors = 3;
+  
+  //! learning samples per k-means prototype
+  const unsigned int prototypeRatio = 10;
+  
+  //! the maximum number of k-means iterations
+  const unsigned int prototypeIterations = 20;
+}
+
+/*! learning samples of all targets are reduced in place:
+ *  <ul>
+ *  <li> EDITED (Wilson): samples outvoted by their nearest neighbors
+ *  (other learning samples) are removed, which cleans class borders
+ *  <li> CONDENSED (Hart): only samples needed to classify all other
+ *  ones by the nearest neighbor are kept, which drops class interiors
+ *  <li> EDITED_CONDENSED: Wilson first, so noise is not condensed
+ *  <li> PROTOTYPES: k-means centers, one per prototypeRatio samples of
+ *  each target (always Euclidean, as centers are means)
+ *  </ul>
+ */
+class RecoTargetReduction
+{
+  public:
+  
+  //! constructor (reduction, metric to find neighbors, seed of k-means)
+  RecoTargetReduction (const RecoTarget::Reduction &reduction,
+                       const RecoTarget::Metric &metric,
+                       const unsigned int &seed = 0);
+  
+  //! reduce learning samples (NULL = not used) in double precision;
+  //! quantized copies are removed (quantize again after), index is
+  //! updated
+  void reduce (RecoTargetSampleHandler **learningSamples);
+  
+  //! return the number of samples before the last reduction
+  inline unsigned int getNFull () const
+  {
+    return nFull;
+  };
+  
+  //! return the number of samples after the last reduction
+  inline unsigned int getNReduced () const
+  {
+    return nReduced;
+  };
+  
+  //! save reduced samples to file (reused later by load)
+  static void save (RecoTargetSampleHandler **learningSamples,
+                    const char *fileName);
+  
+  //! create learning samples saved in file for targets selected by
+  //! flags (features = expected type of samples)
+  static void load (RecoTargetSampleHandler **learningSamples,
+                    const bool *isLearningTarget, const bool &features,
+                    const char *fileName);
+  
+  private:
+  
+  RecoTarget::Reduction reduction; //!< what is done
+  RecoTarget::Metric metric;       //!< to find neighbors
+  unsigned int seed;               //!< seed for k-means initial centers
+  
+  unsigned int nFull;    //!< learning samples before reduction
+  unsigned int nReduced; //!< learning samples after reduction
+  
+  //! Wilson editing of all targets together
+  void edit (RecoTargetSampleHandler **learningSamples) const;
+  
+  //! Hart condensing of all targets together
+  void condense (RecoTargetSampleHandler **learningSamples) const;
+  
+  //! replace samples of a single target by k-means centers
+  void prototypes (RecoTargetSampleHandler *sampleHandler) const;
+  
+  //! keep only samples with isKept set (in order)
+  static void keep (RecoTargetSampleHandler *sampleHandler,
+                    const std::vector <bool> &isKept);
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "RecoTargetRegion.h"
+#include "RecoTargetGeometry.h"
+#include "RecoTargetException.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace RecoTarget;
+
+namespace
+{
+  //! parse non-negative number after "name:" (or return default if
+  //! there is just name); return false if text is not name[:number]
+  bool parseNamed (const std::string &text, const std::string &name,
+                   double &value)
+  {
+    if (text.compare (0, name.size(), name)) return false;
+    if (text.size() == name.size()) return true;
+    if (text[name.size()] != ':') return false;
+    
+    const char *begin = text.c_str() + name.size() + 1;
+    char *end;
+    
+    value = strtod (begin, &end);
+    
+    return end != begin and not *end and value >= 0.0;
+  }
+}
+
+/*! <ul>
+ *  <li> targets: one window [z - d, z + d) per target
+ *  <li> z windows: comma separated pairs z1:z2 with z1 < z2
+ *  </ul>
+ */
+RecoTargetRegion :: RecoTargetRegion (const std::string &text)
+  : nAuto (0)
+{
+  double width = regionHalfWidth;
+  double n = regionPlanes;
+  
+  if (parseNamed (text, "auto", n))
+  {
+    nAuto = n;
+    
+    if (nAuto == 0 or nAuto != n)
+      throw Exception (BAD_ARGUMENT, "wrong number of planes: " + text);
+    
+    return;
+  }
+  
+  if (parseNamed (text, "targets", width))
+  {
+    for (unsigned int t = 0; t < nTargets; t++)
+    {
+      windows.push_back (targetPositions[t] - width);
+      windows.push_back (targetPositions[t] + width);
+    }
+    
+    return;
+  }
+  
+  for (const char *z = text.c_str(); *z;)
+  {
+    char *next;
+    
+    const double from = strtod (z, &next);
+    
+    if (next == z or *next != ':')
+      throw Exception (BAD_ARGUMENT, "wrong region: " + text);
+    
+    z = next + 1;
+    
+    const double to = strtod (z, &next);
+    
+    if (next == z or to <= from or (*next and *next != ','))
+      throw Exception (BAD_ARGUMENT, "wrong region: " + text);
+    
+    windows.push_back (from);
+    windows.push_back (to);
+    
+    z = next + (*next == ',');
+  }
+  
+  if (windows.empty())
+    throw Exception (BAD_ARGUMENT, "empty region");
+}
+
+//! union of windows, or the best planes of learning samples
+std::vector <unsigned int> RecoTargetRegion :: getPlanes
+  (RecoTargetSampleHandler **learningSamples) const
+{
+  if (isAuto()) return rankPlanes (learningSamples);
+  
+  bool isUsed[nPlanes] = {false};
+  
+  for (unsigned int w = 0; w < windows.size(); w += 2)
+  {
+    const std::vector <PlaneRange> ranges =
+      planesBetween (windows[w], windows[w + 1]);
+    
+    for (unsigned int r = 0; r < ranges.size(); r++)
+      std::fill (isUsed + ranges[r].from, isUsed + ranges[r].to, true);
+  }
+  
+  std::vector <unsigned int> planes;
+  
+  for (unsigned int p = 0; p < nPlanes; p++)
+    if (isUsed[p]) planes.push_back (p);
+  
+  if (planes.empty())
+    throw Exception (BAD_ARGUMENT, "no planes in region");
+  
+  return planes;
+}
+
+/*! <ul>
+ *  <li> for each plane: mean and variance of energy over samples of
+ *  each learning target
+ *  <li> score = sum n_t (mean_t - mean)^2 / sum n_t var_t (between /
+ *  within targets); planes never hit score 0
+ *  <li> the best nAuto planes (ties: lower z-order first), sorted
+ *  </ul>
+ */
+std::vector <unsigned int> RecoTargetRegion :: rankPlanes
+  (RecoTargetSampleHandler **learningSamples) const
+{
+  double sums[nTargets][nPlanes] = {{0.0}};
+  double sums2[nTargets][nPlanes] = {{0.0}};
+  unsigned int counts[nTargets] = {0};
+  
+  unsigned int nLearning = 0; // targets with samples
+  double buffer[nPlanes];     // for compressed samples
+  
+  for (unsigned int t = 0; t < nTargets; t++)
+  {
+    if (not learningSamples[t]) continue;
+    
+    const RecoTargetSampleHandler &handler = *learningSamples[t];
+    
+    counts[t] = handler.nSamples;
+    
+    if (counts[t] > 0) nLearning++;
+    
+    for (unsigned int i = 0; i < handler.nSamples; i++)
+    {
+      const double *energy = handler.samples[i].values (buffer);
+      
+      for (unsigned int p = 0; p < nPlanes; p++)
+      {
+        sums[t][p] += energy[p];
+        sums2[t][p] += energy[p] * energy[p];
+      }
+    }
+  }
+  
+  std::vector <unsigned int> planes (nPlanes);
+  
+  for (unsigned int p = 0; p < nPlanes; p++) planes[p] = p;
+  
+  if (nLearning < 2 or nAuto >= nPlanes) return planes;
+  
+  std::vector <double> scores (nPlanes, 0.0);
+  
+  for (unsigned int p = 0; p < nPlanes; p++)
+  {
+    double sum = 0.0;
+    unsigned int n = 0;
+    
+    for (unsigned int t = 0; t < nTargets; t++)
+    {
+      sum += sums[t][p];
+      n += counts[t];
+    }
+    
+    const double mean = sum / n;
+    
+    double between = 0.0;
+    double within = 0.0;
+    
+    for (unsigned int t = 0; t < nTargets; t++)
+    {
+      if (counts[t] == 0) continue;
+      
+      const double meanT = sums[t][p] / counts[t];
+      
+      between += counts[t] * (meanT - mean) * (meanT - mean);
+      within += std::max (0.0, sums2[t][p] - counts[t] * meanT * meanT);
+    }
+    
+    if (between > 0.0)
+      scores[p] = within > 0.0 ? between / within : HUGE_VAL;
+  }
+  
+  std::stable_sort (planes.begin(), planes.end(),
+                    [&scores] (const unsigned int &a, const unsigned int &b)
+                    { return scores[a] > scores[b]; });
+  
+  planes.resize (nAuto);
+  
+  std::sort (planes.begin(), planes.end());
+  
+  return planes;
+}
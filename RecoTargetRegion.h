@@ -0,0 +1,64 @@
+/**
+ * @brief Region of interest: planes used by distances
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_REGION_H
+#define RECO_TARGET_REGION_H
+
+#include "RecoTargetSampleHandler.h"
+#include <string>
+#include <vector>
+
+namespace RecoTarget
+{
+  //! default half-width of z window around each target (mm)
+  const double regionHalfWidth = 250.0;
+  
+  //! default number of planes chosen by importance
+  const unsigned int regionPlanes = 64;
+}
+
+/*! region of interest is given by text:
+ *  <ul>
+ *  <li> "z1:z2[,z3:z4...]" - planes with z in any of windows [z1, z2)
+ *  <li> "targets[:d]" - planes within d mm of any nuclear target
+ *  <li> "auto[:n]" - n planes which separate learning targets best:
+ *  Fisher score = variance of target means / mean variance within
+ *  targets, computed for each plane over the learning set
+ *  </ul>
+ *  planes are returned as sorted z-orders, so samples keep their order
+ */
+class RecoTargetRegion
+{
+  public:
+  
+  //! constructor (throw BAD_ARGUMENT if text is not a region)
+  RecoTargetRegion (const std::string &text);
+  
+  //! return planes of region (learning samples are used only by auto,
+  //! NULL = target not loaded)
+  std::vector <unsigned int> getPlanes
+    (RecoTargetSampleHandler **learningSamples) const;
+  
+  //! return true if planes depend on learning samples
+  inline bool isAuto () const
+  {
+    return nAuto > 0;
+  };
+  
+  private:
+  
+  std::vector <double> windows; //!< z1, z2 of each window
+  unsigned int nAuto;           //!< planes chosen by importance (0 = no)
+  
+  //! return planes with the highest Fisher score (all planes if there
+  //! are fewer than two learning targets)
+  std::vector <unsigned int> rankPlanes
+    (RecoTargetSampleHandler **learningSamples) const;
+};
+
+#endif
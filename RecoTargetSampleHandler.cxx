@@ -1,35 +1,629 @@
 #include "RecoTargetSampleHandler.h"
-#include <iostream>
-#include <cstdlib>
+#include "RecoTargetException.h"
+#include "RecoTargetFeatures.h"
+#include "RecoTargetGeometry.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 using namespace RECOTRACKS_ANA;
 using namespace RecoTarget;
 
-RecoTargetSampleHandler :: RecoTargetSampleHandler (const int &n)
-  : nSamples (n)
+namespace
 {
-  samples = new Sample[nSamples];
+  //! sort k nearest neighbors and drop everything behind them
+  void trimNeighbors (std::vector <Neighbor> &neighbors,
+                      const unsigned int &k)
+  {
+    const size_t nKept = std::min <size_t> (k, neighbors.size());
+    
+    std::partial_sort (neighbors.begin(), neighbors.begin() + nKept,
+                       neighbors.end());
+    
+    neighbors.resize (nKept);
+  }
+  
+  //! Euclidean distance between two energy distributions (first n)
+  double euclidean (const double *a, const double *b,
+                    const unsigned int &n = nPlanes)
+  {
+    double distance2 = 0.0;
+    
+    for (unsigned int p = 0; p < n; p++)
+      distance2 += (a[p] - b[p]) * (a[p] - b[p]);
+      
+    return sqrt (distance2);
+  }
+}
+
+RecoTargetSampleHandler :: RecoTargetSampleHandler
+  (const int &n, const unsigned int &firstId)
+  : samples (n), quantized (NULL), nSamples (n), firstId (firstId),
+    isFeatures (false), isCompressed (false), profiler (NULL),
+    isIndexed (false), isDropped (false)
+{
+  allocateRows();
+}
+
+RecoTargetSampleHandler :: ~RecoTargetSampleHandler ()
+{
+  delete quantized;
+}
+
+/*! <ul>
+ *  <li> grow the pool of samples if needed (never shrink it)
+ *  <li> clear neighbors (keep their capacity)
+ *  <li> resize quantized copy (it is refilled by fillSamples)
+ *  <li> give rows back to dropped samples, drop all windows (arena
+ *  keeps its capacity)
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: resize (const unsigned int &n,
+                                        const unsigned int &firstId)
+{
+  reserve (n);
+  
+  nSamples = n;
+  this->firstId = firstId;
+  
+  clearNeighbors();
+  
+  if (quantized) quantized->resize (nSamples);
+  
+  if (isDropped and not isCompressed) allocateRows();
+  
+  if (isCompressed)
+  {
+    windows.clear();
+    
+    for (size_t i = 0; i < samples.size(); i++)
+    {
+      samples[i].energyPerPlane = NULL;
+      samples[i].size = 0;
+    }
+  }
+  
+  isIndexed = false;  // samples will be refilled
+  isDropped = false;  // with double distributions
+  isFeatures = false; // with raw distributions, unless asked again
+  region.clear();     // with all planes, unless asked again
+}
+
+//! grow samples by half to make appending one by one cheap (rows of
+//! dense samples move to a bigger block)
+void RecoTargetSampleHandler :: reserve (const unsigned int &n)
+{
+  if (n <= samples.size()) return;
+  
+  samples.resize (std::max <size_t> (n, samples.size() * 3 / 2));
+  
+  if (not isCompressed and not isDropped) allocateRows();
+}
+
+//! rows follow the order of samples (retired ones were rotated behind)
+void RecoTargetSampleHandler :: allocateRows ()
+{
+  std::vector <double> block (samples.size() * nPlanes);
+  
+  for (size_t i = 0; i < samples.size(); i++)
+  {
+    samples[i].expand (&block[i * nPlanes]);
+    samples[i].energyPerPlane = &block[i * nPlanes];
+    samples[i].size = nPlanes;
+    samples[i].firstPlane = 0;
+  }
+  
+  rows.swap (block);
+  std::vector <double> ().swap (windows);
+}
+
+/*! <ul>
+ *  <li> find the first and the last non-zero value of sample
+ *  <li> append values between them to the arena (it is packed first if
+ *  there is no room, so windows move only there)
+ *  <li> sample may be i-th sample itself if it is dense (row)
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: storeWindow (const unsigned int &i,
+                                             const Sample &sample)
+{
+  const double *dense = sample.energyPerPlane;
+  
+  unsigned int first = 0;
+  unsigned int last = sample.size;
+  
+  while (first < last and dense[first] == 0.0) first++;
+  while (last > first and dense[last - 1] == 0.0) last--;
+  
+  Sample &window = samples[i];
+  
+  window.firstPlane = sample.firstPlane + first;
+  window.inverseNorm = sample.inverseNorm;
+  window.nonZeroFrom = sample.firstPlane + first;
+  window.nonZeroTo = sample.firstPlane + last;
+  window.nDimensions = sample.nDimensions;
+  window.size = 0; // the old window is not packed
+  
+  if (windows.size() + last - first > windows.capacity())
+    packWindows (last - first);
+  
+  window.energyPerPlane = windows.data() + windows.size();
+  window.size = last - first;
+  
+  windows.insert (windows.end(), dense + first, dense + last);
+}
+
+//! windows of pool are copied in order of samples, twice the room they
+//! need is reserved (so packing is rare)
+void RecoTargetSampleHandler :: packWindows (const size_t &n)
+{
+  size_t nValues = n;
+  
+  for (size_t i = 0; i < samples.size(); i++) nValues += samples[i].size;
+  
+  std::vector <double> arena;
+  arena.reserve (2 * nValues);
+  
+  for (size_t i = 0; i < samples.size(); i++)
+  {
+    const double *window = samples[i].energyPerPlane;
+    
+    samples[i].energyPerPlane = arena.data() + arena.size();
+    arena.insert (arena.end(), window, window + samples[i].size);
+  }
+  
+  windows.swap (arena);
+}
+
+//! copy energy of samples [from, nSamples) to quantized storage
+void RecoTargetSampleHandler :: updateCopies (const unsigned int &from)
+{
+  updateCopies (from, nSamples);
+}
+
+//! copy energy of samples [from, to) to quantized storage and index
+void RecoTargetSampleHandler :: updateCopies (const unsigned int &from,
+                                              const unsigned int &to)
+{
+  if (isIndexed) updateIndex (from, to);
+  
+  if (not quantized) return;
+  
+  quantized->resize (nSamples);
+  
+  double buffer[nPlanes]; // for compressed samples
+  
+  for (unsigned int i = from; i < to; i++)
+    quantized->set (i, samples[i].values (buffer));
+}
+
+//! copy energy distributions of all samples to quantized storage
+void RecoTargetSampleHandler :: quantize (const Precision &precision)
+{
+  checkDistributions();
+  
+  allocateQuantized (precision);
+  
+  if (quantized) updateCopies();
+}
+
+//! rows (or windows) are one block swapped with an empty one, so
+//! memory is really freed
+void RecoTargetSampleHandler :: dropDistributions ()
+{
+  if (not quantized)
+    throw Exception (BAD_ARGUMENT, "only quantized samples can be dropped");
+  
+  for (size_t i = 0; i < samples.size(); i++)
+  {
+    samples[i].energyPerPlane = NULL;
+    samples[i].size = 0;
+  }
+  
+  std::vector <double> ().swap (rows);
+  std::vector <double> ().swap (windows);
+  
+  isDropped = true;
+  
+#ifdef __GLIBC__
+  malloc_trim (0); // block may be in heap (not mapped), give it back
+#endif
+}
+
+void RecoTargetSampleHandler :: checkDistributions () const
+{
+  if (isDropped)
+    throw Exception (BAD_ARGUMENT, "double distributions were dropped");
+}
+
+//! stride must match too: resize clears region, but keeps the copy
+void RecoTargetSampleHandler :: allocateQuantized
+  (const Precision &precision)
+{
+  const unsigned int nDimensions = region.empty() ? nPlanes : region.size();
+  
+  if (precision == DOUBLE or not quantized or
+      quantized->getPrecision() != precision or
+      quantized->getNDimensions() != nDimensions)
+  {
+    delete quantized;
+    quantized = precision == DOUBLE ? NULL : new RecoTargetQuantizedSamples
+      (precision, nSamples, nDimensions);
+  }
+  else quantized->resize (nSamples);
+}
+
+//! convert all samples now (once), later ones when they are filled
+//! (compressed ones are expanded, converted and compressed again)
+void RecoTargetSampleHandler :: useFeatures (const bool &features)
+{
+  if (features == isFeatures) return;
+  
+  checkDistributions();
+  
+  if (not features)
+    throw Exception (BAD_ARGUMENT, "features can not be converted back");
+    
+  isFeatures = true;
+  
+  DenseSample dense; // used only if samples are compressed
+  
+  for (unsigned int i = 0; i < nSamples; i++)
+    if (isCompressed)
+    {
+      dense.assign (samples[i]);
+      dense.extractFeatures();
+      storeWindow (i, dense);
+    }
+    else samples[i].extractFeatures();
+  
+  updateCopies();
+}
+
+/*! <ul>
+ *  <li> convert all samples now (once), later ones when they are filled
+ *  <li> compressed samples are compressed again (window of the region)
+ *  <li> quantized copy is created again with the size of region
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: useRegion
+  (const std::vector <unsigned int> &planes)
+{
+  if (planes == region) return;
+  
+  checkDistributions();
+  
+  if (not region.empty())
+    throw Exception (BAD_ARGUMENT, "region can not be changed");
+  
+  checkRegion (planes, isFeatures);
+  
+  region = planes;
+  
+  DenseSample dense; // used only if samples are compressed
+  
+  for (unsigned int i = 0; i < nSamples; i++)
+    if (isCompressed)
+    {
+      dense.assign (samples[i]);
+      dense.selectPlanes (region);
+      storeWindow (i, dense);
+    }
+    else samples[i].selectPlanes (region);
+  
+  if (quantized)
+  {
+    const Precision precision = quantized->getPrecision();
+    
+    delete quantized;
+    quantized = NULL;
+    
+    quantize (precision);
+  }
+  else updateCopies();
+}
+
+//! empty region is always fine
+void RecoTargetSampleHandler :: checkRegion
+  (const std::vector <unsigned int> &planes, const bool &features) const
+{
+  if (planes.empty()) return;
+  
+  if (features)
+    throw Exception (BAD_ARGUMENT, "region can not be used with features");
+  
+  for (unsigned int i = 0; i < planes.size(); i++)
+    if (planes[i] >= nPlanes or (i > 0 and planes[i] <= planes[i - 1]))
+      throw Exception (BAD_ARGUMENT, "region planes must be sorted");
+}
+
+/*! <ul>
+ *  <li> settings replace the old ones (samples are refilled anyway)
+ *  <li> quantized copy only gets the size and stride, it is updated
+ *  when samples are filled
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: prepare
+  (const bool &features, const std::vector <unsigned int> &planes,
+   const Precision &precision)
+{
+  checkRegion (planes, features);
+  
+  isFeatures = features;
+  region = planes;
+  
+  allocateQuantized (precision);
+}
+
+/*! <ul>
+ *  <li> compress: keep only the window from the first to the last
+ *  non-zero plane of each sample in the arena (now, and when filled
+ *  later), free rows
+ *  <li> otherwise expand all samples back to rows of nPlanes
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: compress (const bool &compressed)
+{
+  if (compressed == isCompressed) return;
+  
+  checkDistributions();
+  
+  isCompressed = compressed;
+  
+  if (not compressed)
+  {
+    allocateRows();
+    return;
+  }
+  
+  windows.clear();
+  
+  for (unsigned int i = 0; i < nSamples; i++) storeWindow (i, samples[i]);
+  
+  for (size_t i = nSamples; i < samples.size(); i++)
+  {
+    samples[i].energyPerPlane = NULL;
+    samples[i].size = 0;
+  }
+  
+  std::vector <double> ().swap (rows);
+}
+
+//! clear neighbors list of each sample
+void RecoTargetSampleHandler :: clearNeighbors ()
+{
+  for (unsigned int i = 0; i < nSamples; i++) samples[i].neighbors.clear();
+}
+
+//! fill all samples
+void RecoTargetSampleHandler :: fillSamples (
+  RECOTRACKS_ANA::RecoTracks *recoTracks, const unsigned int *entries)
+{
+  fillSamples (recoTracks, entries, 0, nSamples);
 }
 
 /*! <ul>
  *  <li> loop over "recoTracks"
- *  <li> take "nSamples" entries (starting from entry = "start", 
- *  every "step" entry
- *  <li> fill "samples"
+ *  <li> take entries listed in "entries" (sorted, so the tree is read
+ *  forward)
+ *  <li> fill "samples" (and quantized copy if exists)
+ *  <li> compressed samples are filled in dense one first, so only
+ *  their windows are kept in the pool
+ *  <li> if profiled: count the whole batch with counters of thread
+ *  (reading the tree too, switching counters around each event would
+ *  cost more than filling it)
  *  </ul> 
  */ 
 void RecoTargetSampleHandler :: fillSamples (
-  RECOTRACKS_ANA::RecoTracks *recoTracks,
-  const unsigned int &start, const unsigned int &step)
+  RECOTRACKS_ANA::RecoTracks *recoTracks, const unsigned int *entries,
+  const unsigned int &first, const unsigned int &last)
 {
-  for (unsigned int i = 0; i < nSamples; i++)
+  checkDistributions(); // dropped samples have no rows
+  
+  DenseSample dense; // used only if samples are compressed
+  
+  RecoTargetCounters *counters =
+    profiler ? &RecoTargetCounters::ofThread() : NULL;
+  
+  if (counters)
+  {
+    counters->reset();
+    counters->start();
+  }
+  
+  for (unsigned int i = first; i < last; i++)
+  {
+    recoTracks->GetEntry (entries[i]);
+    
+    Sample &sample = isCompressed ? dense : samples[i];
+    
+    sample.fill (recoTracks->plane_visible_energy, 
+                 recoTracks->plane_id,
+                 recoTracks->plane_id_sz);
+                     
+    if (isFeatures) sample.extractFeatures();
+    
+    if (not region.empty()) sample.selectPlanes (region);
+    
+    if (isCompressed) storeWindow (i, dense);
+  }
+  
+  if (counters)
+  {
+    counters->stop();
+    profiler->add (FILL, 0, *counters, last - first);
+  }
+  
+  updateCopies (first, last);
+}
+
+//! fill all samples from event store
+void RecoTargetSampleHandler :: fillSamples (
+  const RecoTargetEventStore &store, const unsigned int *entries)
+{
+  fillSamples (store, entries, 0, nSamples);
+}
+
+//! as above, but events are read from event store
+void RecoTargetSampleHandler :: fillSamples (
+  const RecoTargetEventStore &store, const unsigned int *entries,
+  const unsigned int &first, const unsigned int &last)
+{
+  checkDistributions(); // dropped samples have no rows
+  
+  DenseSample dense; // used only if samples are compressed
+  
+  RecoTargetCounters *counters =
+    profiler ? &RecoTargetCounters::ofThread() : NULL;
+  
+  if (counters)
   {
-    recoTracks->GetEntry (start + i * step);
+    counters->reset();
+    counters->start();
+  }
+  
+  for (unsigned int i = first; i < last; i++)
+  {
+    Sample &sample = isCompressed ? dense : samples[i];
+    
+    sample.fillOrdered (store.getEnergy (entries[i]),
+                        store.getPlaneOrder (entries[i]),
+                        store.getNHits (entries[i]));
+                            
+    if (isFeatures) sample.extractFeatures();
+    
+    if (not region.empty()) sample.selectPlanes (region);
     
-    samples[i].fill (recoTracks->plane_visible_energy, 
-                     recoTracks->plane_id,
-                     recoTracks->plane_id_sz);
+    if (isCompressed) storeWindow (i, dense);
   }
+  
+  if (counters)
+  {
+    counters->stop();
+    profiler->add (FILL, 0, *counters, last - first);
+  }
+  
+  updateCopies (first, last);
+}
+
+/*! <ul>
+ *  <li> make room for "n" new samples
+ *  <li> fill them as fillSamples does (ids continue from the last one)
+ *  </ul> 
+ */ 
+void RecoTargetSampleHandler :: appendSamples (
+  RECOTRACKS_ANA::RecoTracks *recoTracks, const unsigned int *entries,
+  const unsigned int &n)
+{
+  const unsigned int first = nSamples; // first new sample
+  
+  checkDistributions(); // dropped samples have no rows
+  
+  reserve (nSamples + n);
+  
+  DenseSample dense; // used only if samples are compressed
+  
+  for (unsigned int i = 0; i < n; i++)
+  {
+    recoTracks->GetEntry (entries[i]);
+    
+    samples[nSamples].neighbors.clear();
+    
+    Sample &sample = isCompressed ? dense : samples[nSamples];
+    
+    sample.fill (recoTracks->plane_visible_energy, 
+                 recoTracks->plane_id,
+                 recoTracks->plane_id_sz);
+                 
+    if (isFeatures) sample.extractFeatures();
+    
+    if (not region.empty()) sample.selectPlanes (region);
+    
+    if (isCompressed) storeWindow (nSamples, dense);
+    
+    nSamples++;
+  }
+  
+  updateCopies (first);
+}
+
+//! fill next sample from the pool
+void RecoTargetSampleHandler :: appendSample (
+  const double *planeVisibleEnergy, const int *planeId,
+  const unsigned int &nFilledPlanes)
+{
+  checkDistributions(); // dropped samples have no rows
+  
+  reserve (nSamples + 1);
+  
+  DenseSample dense; // used only if samples are compressed
+  
+  samples[nSamples].neighbors.clear();
+  
+  Sample &sample = isCompressed ? dense : samples[nSamples];
+  
+  sample.fill (planeVisibleEnergy, planeId, nFilledPlanes);
+  
+  if (isFeatures) sample.extractFeatures();
+  
+  if (not region.empty()) sample.selectPlanes (region);
+  
+  if (isCompressed) storeWindow (nSamples, dense);
+  
+  nSamples++;
+  
+  updateCopies (nSamples - 1);
+}
+
+//! as above, but plane z-orders are given
+void RecoTargetSampleHandler :: appendSample (
+  const double *planeVisibleEnergy, const uint8_t *planeZorder,
+  const unsigned int &nFilledPlanes)
+{
+  checkDistributions(); // dropped samples have no rows
+  
+  reserve (nSamples + 1);
+  
+  DenseSample dense; // used only if samples are compressed
+  
+  samples[nSamples].neighbors.clear();
+  
+  Sample &sample = isCompressed ? dense : samples[nSamples];
+  
+  sample.fillOrdered (planeVisibleEnergy, planeZorder, nFilledPlanes);
+  
+  if (isFeatures) sample.extractFeatures();
+  
+  if (not region.empty()) sample.selectPlanes (region);
+  
+  if (isCompressed) storeWindow (nSamples, dense);
+  
+  nSamples++;
+  
+  updateCopies (nSamples - 1);
+}
+
+/*! <ul>
+ *  <li> move "n" oldest samples to the end of the pool (to reuse them)
+ *  <li> ids of the rest do not change
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: retireSamples (const unsigned int &n)
+{
+  checkDistributions(); // quantized copy is made again from them
+  
+  const unsigned int nRetired = std::min (n, nSamples);
+  
+  std::rotate (samples.begin(), samples.begin() + nRetired,
+               samples.begin() + nSamples);
+  
+  nSamples -= nRetired;
+  firstId += nRetired;
+  
+  updateCopies();
 }
 
 /*! <ul>
@@ -45,26 +639,161 @@ void RecoTargetSampleHandler :: Sample :: fill (
   const int *planeId, 
   const unsigned int &nFilledPlanes)
 {
-  double totalEnergy = 0.0; // sum of energy in each plane
+  double totalEnergy = 0.0; // sum of energy in each plane
+  
+  // initial energy distribution = 0
+  std::fill_n (energyPerPlane, nPlanes, 0.0);
+    
+  // copy energy plane distribution to array
+  for (unsigned int i = 0; i < nFilledPlanes; i++)
+  {
+    // get id order based on plane id
+    const int idPlaneZorder = planeOrder (planeId[i]);
+    // save energy in proper slot        
+    energyPerPlane[idPlaneZorder] = planeVisibleEnergy[i];
+    // add current plane enegry to the total energy
+    totalEnergy += planeVisibleEnergy[i];
+  }
+  
+  normalize (totalEnergy);
+}
+
+//! as fill, but plane z-order is already known (e.g. from event store)
+void RecoTargetSampleHandler :: Sample :: fillOrdered (
+  const double *planeVisibleEnergy, 
+  const uint8_t *planeZorder, 
+  const unsigned int &nFilledPlanes)
+{
+  double totalEnergy = 0.0; // sum of energy in each plane
+  
+  std::fill_n (energyPerPlane, nPlanes, 0.0);
+    
+  for (unsigned int i = 0; i < nFilledPlanes; i++)
+  {
+    energyPerPlane[planeZorder[i]] = planeVisibleEnergy[i];
+    totalEnergy += planeVisibleEnergy[i];
+  }
+  
+  normalize (totalEnergy);
+}
+
+//! normalize distribution to 1, keep inverse norm for cosine distance
+void RecoTargetSampleHandler :: Sample :: normalize
+  (const double &totalEnergy)
+{
+  if (totalEnergy  > 0.0)
+    for (unsigned int i = 0; i < nPlanes; i++)
+      energyPerPlane[i] /= totalEnergy;
+      
+  nDimensions = nPlanes;
+  
+  updateNorms();
+}
+
+//! features go to the beginning of energyPerPlane, the rest is zero
+void RecoTargetSampleHandler :: Sample :: extractFeatures ()
+{
+  double features[nFeatures];
+  
+  RecoTarget::extractFeatures (energyPerPlane, features);
+  
+  std::copy (features, features + nFeatures, energyPerPlane);
+  std::fill (energyPerPlane + nFeatures, energyPerPlane + nPlanes, 0.0);
+  
+  nDimensions = nFeatures;
+  
+  updateNorms();
+}
+
+//! energy of chosen planes goes to the beginning of energyPerPlane, the
+//! rest is zero (planes are sorted, so values move only down)
+void RecoTargetSampleHandler :: Sample :: selectPlanes
+  (const std::vector <unsigned int> &planes)
+{
+  for (unsigned int i = 0; i < planes.size(); i++)
+    energyPerPlane[i] = energyPerPlane[planes[i]];
+  
+  std::fill (energyPerPlane + planes.size(), energyPerPlane + nPlanes, 0.0);
+  
+  nDimensions = planes.size();
+  
+  updateNorms();
+}
+
+//! inverse norm for cosine, non-zero range for compressed samples
+void RecoTargetSampleHandler :: Sample :: updateNorms ()
+{
+  const double l2 = norm();
+  
+  inverseNorm = l2 > 0.0 ? 1.0 / l2 : 0.0;
+  
+  unsigned int first = 0;
+  unsigned int last = isDense() ? nDimensions : size;
+  
+  while (first < last and energyPerPlane[first] == 0.0) first++;
+  while (last > first and energyPerPlane[last - 1] == 0.0) last--;
+  
+  nonZeroFrom = firstPlane + first;
+  nonZeroTo = firstPlane + last;
+}
+
+//! zeros, then the window at its planes
+void RecoTargetSampleHandler :: Sample :: expand (double *dense) const
+{
+  std::fill_n (dense, nPlanes, 0.0);
+  std::copy (energyPerPlane, energyPerPlane + size, dense + firstPlane);
+}
+
+//! own row
+RecoTargetSampleHandler :: DenseSample :: DenseSample ()
+{
+  energyPerPlane = row;
+  size = nPlanes;
+}
+
+//! pointer is set to own row again
+RecoTargetSampleHandler :: DenseSample :: DenseSample
+  (const DenseSample &sample)
+  : Sample (sample)
+{
+  energyPerPlane = row;
+  std::copy (sample.row, sample.row + nPlanes, row);
+}
+
+//! as copy constructor
+RecoTargetSampleHandler::DenseSample& RecoTargetSampleHandler ::
+  DenseSample :: operator= (const DenseSample &sample)
+{
+  Sample::operator= (sample);
   
-  // initial energy distribution = 0
-  std::fill_n (energyPerPlane, nPlanes, 0.0);
-    
-  // copy energy plane distribution to array
-  for (unsigned int i = 0; i < nFilledPlanes; i++)
-  {
-    // get id order based on plane id
-    const int idPlaneZorder = idOrderMap[planeId[i]];
-    // save energy in proper slot        
-    energyPerPlane[idPlaneZorder] = planeVisibleEnergy[i];
-    // add current plane enegry to the total energy
-    totalEnergy += planeVisibleEnergy[i];
-  }
-            
-  // normalize distribution to 1
-  if (totalEnergy  > 0.0)
-    for (unsigned int i = 0; i < nPlanes; i++)
-      energyPerPlane[i] /= totalEnergy;
+  energyPerPlane = row;
+  std::copy (sample.row, sample.row + nPlanes, row);
+  
+  return *this;
+}
+
+//! neighbors are not copied
+void RecoTargetSampleHandler :: DenseSample :: assign
+  (const Sample &sample)
+{
+  sample.expand (row);
+  
+  firstPlane = 0;
+  inverseNorm = sample.inverseNorm;
+  nonZeroFrom = sample.nonZeroFrom;
+  nonZeroTo = sample.nonZeroTo;
+  nDimensions = sample.nDimensions;
+}
+
+//! dense sample needs no copy
+const double* RecoTargetSampleHandler :: Sample :: values
+  (double *buffer) const
+{
+  if (isDense()) return energyPerPlane;
+  
+  expand (buffer);
+  
+  return buffer;
 }
 
 /*! <ul>
@@ -76,8 +805,17 @@ void RecoTargetSampleHandler :: Sample :: fill (
  *  </ul>
  */
 double RecoTargetSampleHandler :: Sample :: distance
-  (const Sample &sample, const Metric &metric)
+  (const Sample &sample, const Metric &metric) const
 {
+  // compressed sample: only windows are compared
+  if (not isDense() or not sample.isDense())
+    return windowDistance (sample, metric);
+  
+  // both norms are known, so it is just a dot product (norms multiplied
+  // first, so distance is the same both ways, as symmetric search needs)
+  if (metric == NORMALIZED_COSINE)
+    return 1.0 - dot (sample) * (inverseNorm * sample.inverseNorm);
+  
   double distance = 0.0; // total "distance"
 
   /* at this point each distance comes with the same weight
@@ -101,12 +839,10 @@ double RecoTargetSampleHandler :: Sample :: distance
       pMetric = metricCosine;
       break;
     default:
-      std::cerr << "\nERROR: undefined metric\n\n";
-      exit (4);
-      break;
+      throw Exception (UNDEFINED_METRIC, "undefined metric");
   }
   
-  for (unsigned int i = 0; i < nPlanes; i++) // loop over planes
+  for (unsigned int i = 0; i < nDimensions; i++) // loop over planes
     distance += pMetric (energyPerPlane[i], sample.energyPerPlane[i], 
                          weight);
    
@@ -114,50 +850,603 @@ double RecoTargetSampleHandler :: Sample :: distance
 }
 
 /*! <ul>
- *  <li> loop over samples
- *  <li> for each sample loop over training samples
+ *  <li> values outside the non-zero range of a sample are zeros, so
+ *  planes where both samples are zero add nothing and are skipped
+ *  <li> the rest is added plane by plane in the order of the dense
+ *  kernel: the part of one range before the other one, the overlap,
+ *  the part of one range after it (so the sum is the same to the bit)
+ *  <li> normalized cosine: only the overlap adds to the dot product,
+ *  each product goes to the partial sum it has in dot
+ *  <li> dense learning sample against compressed testing one costs
+ *  both non-zero ranges, not all planes
+ *  </ul>
+ */
+double RecoTargetSampleHandler :: Sample :: windowDistance
+  (const Sample &sample, const Metric &metric) const
+{
+  // value of sample at plane p (inside its window)
+  #define VALUE(s, p) (s).energyPerPlane[(p) - (s).firstPlane]
+  
+  // the sample whose range starts first (ends last) owns the planes
+  // before (after) the overlap
+  const Sample &head = nonZeroFrom <= sample.nonZeroFrom ? *this : sample;
+  const Sample &tail = nonZeroTo >= sample.nonZeroTo ? *this : sample;
+  
+  const unsigned int from = std::max (nonZeroFrom, sample.nonZeroFrom);
+  const unsigned int to = std::min (nonZeroTo, sample.nonZeroTo);
+  
+  const unsigned int headTo =
+    std::min (from, std::min (nonZeroTo, sample.nonZeroTo));
+  const unsigned int tailFrom = std::max (from, to);
+  
+  if (metric == NORMALIZED_COSINE)
+  {
+    // products behind the last full group of 4 go to sum[0] (as in dot)
+    const unsigned int nGrouped = nDimensions - nDimensions % 4;
+    
+    double sum[4] = {0.0, 0.0, 0.0, 0.0};
+    
+    for (unsigned int p = from; p < to; p++)
+      sum[p < nGrouped ? p % 4 : 0] += VALUE (*this, p) * VALUE (sample, p);
+      
+    const double dot = (sum[0] + sum[1]) + (sum[2] + sum[3]);
+    
+    return 1.0 - dot * (inverseNorm * sample.inverseNorm);
+  }
+  
+  const double weight = 1.0; // as in distance
+  
+  double (*pMetric)(const double&, const double&, const double&);
+  
+  switch (metric)
+  {
+    case EUCLIDEAN:
+      pMetric = metricEuclidean;
+      break;
+    case MANHATTAN:
+      pMetric = metricManhattan;
+      break;
+    case COSINE:
+      pMetric = metricCosine;
+      break;
+    default:
+      throw Exception (UNDEFINED_METRIC, "undefined metric");
+  }
+  
+  // the other sample is zero there (arguments keep their order)
+  const bool isHead = &head == this;
+  const bool isTail = &tail == this;
+  
+  double distance = 0.0;
+  
+  for (unsigned int p = head.nonZeroFrom; p < headTo; p++)
+    distance += isHead ? pMetric (VALUE (head, p), 0.0, weight)
+                       : pMetric (0.0, VALUE (head, p), weight);
+  
+  for (unsigned int p = from; p < to; p++)
+    distance += pMetric (VALUE (*this, p), VALUE (sample, p), weight);
+  
+  for (unsigned int p = tailFrom; p < tail.nonZeroTo; p++)
+    distance += isTail ? pMetric (VALUE (tail, p), 0.0, weight)
+                       : pMetric (0.0, VALUE (tail, p), weight);
+  
+  #undef VALUE
+  
+  return distance;
+}
+
+//! sum over planes; 4 independent sums, so compiler can vectorize it
+double RecoTargetSampleHandler :: Sample :: dot (const Sample &sample) const
+{
+  const double *x = energyPerPlane;
+  const double *y = sample.energyPerPlane;
+  
+  double sum[4] = {0.0, 0.0, 0.0, 0.0};
+  unsigned int i = 0;
+  
+  for (; i + 4 <= nDimensions; i += 4)
+  {
+    sum[0] += x[i] * y[i];
+    sum[1] += x[i + 1] * y[i + 1];
+    sum[2] += x[i + 2] * y[i + 2];
+    sum[3] += x[i + 3] * y[i + 3];
+  }
+  
+  for (; i < nDimensions; i++) sum[0] += x[i] * y[i];
+  
+  return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+//! sqrt (sum over planes energy^2)
+double RecoTargetSampleHandler :: Sample :: norm () const
+{
+  const unsigned int n = isDense() ? nDimensions : size;
+  
+  double norm2 = 0.0;
+  
+  for (unsigned int i = 0; i < n; i++)
+    norm2 += energyPerPlane[i] * energyPerPlane[i];
+    
+  return sqrt (norm2);
+}
+
+//! fill neighbors of all samples
+void RecoTargetSampleHandler :: fillNeighbors
+  (RecoTargetSampleHandler *sampleHandler,
+  const unsigned int &target,
+  const Metric &metric,
+  const unsigned int &fromId)
+{
+  fillNeighbors (sampleHandler, target, metric, fromId, 0, nSamples);
+}
+
+/*! <ul>
+ *  <li> loop over samples [firstSample, lastSample)
+ *  <li> for each sample loop over training samples (starting from id =
+ *  fromId, so only new ones are merged into existing neighbors)
+ *  <li> use quantized copies if both handlers have the same precision
  *  <li> save distance between samples
  *  </ul>
  */
 void RecoTargetSampleHandler :: fillNeighbors
   (RecoTargetSampleHandler *sampleHandler,
   const unsigned int &target,
-  const Metric &metric)
+  const Metric &metric,
+  const unsigned int &fromId,
+  const unsigned int &firstSample,
+  const unsigned int &lastSample)
 {
-  for (unsigned int i = 0; i < nSamples; i++) // loop over samples
+  // index of the first learning sample to use
+  const unsigned int first = std::min (sampleHandler->nSamples,
+    fromId > sampleHandler->firstId ? fromId - sampleHandler->firstId : 0);
+  
+  // use reduced precision if both handlers have it
+  const RecoTargetQuantizedSamples *learning =
+    quantizedLearning (sampleHandler);
+  
+  for (unsigned int i = firstSample; i < lastSample; i++) // loop over samples
   {
+    // make room for new neighbors (no-op when reused)
+    samples[i].neighbors.reserve (samples[i].neighbors.size() +
+                                  sampleHandler->nSamples - first);
+    
     // loop over training samples
-    for (unsigned int j = 0; j < sampleHandler->nSamples; j++)
+    for (unsigned int j = first; j < sampleHandler->nSamples; j++)
     {
       // calculalte distance between testing and learning samples
-      const double distance = 
+      const double distance = learning ?
+        quantized->distance (i, *learning, j, metric) :
         samples[i].distance (sampleHandler->samples[j], metric);
       
       // save neighbor
       samples[i].neighbors.push_back
-        (std::pair <double, unsigned int> (distance, target));
+        (Neighbor (distance, target, sampleHandler->firstId + j));
     }
   }  
 }
 
-//! sort neighbors, count score for each target and return the best
+/*! <ul>
+ *  <li> choose pivots: the first sample, then the sample farthest from
+ *  all pivots chosen so far (spread pivots give tighter bounds)
+ *  <li> compute norms and distances to pivots of all samples
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: index ()
+{
+  checkDistributions();
+  
+  pivots.assign (nPivots * nPlanes, 0.0);
+  
+  // the smallest distance from each sample to chosen pivots
+  std::vector <double> nearestPivot (nSamples, HUGE_VAL);
+  
+  unsigned int pivot = 0; // sample to become the next pivot
+  
+  double buffer[nPlanes]; // for compressed samples
+  
+  for (unsigned int p = 0; p < nPivots and nSamples > 0; p++)
+  {
+    samples[pivot].expand (&pivots[p * nPlanes]);
+    
+    unsigned int farthest = 0;
+               
+    for (unsigned int i = 0; i < nSamples; i++)
+    {
+      nearestPivot[i] = std::min (nearestPivot[i],
+        euclidean (samples[i].values (buffer), &pivots[p * nPlanes]));
+        
+      if (nearestPivot[i] > nearestPivot[farthest]) farthest = i;
+    }
+    
+    pivot = farthest;
+  }
+  
+  isIndexed = true;
+  
+  updateIndex (0, nSamples);
+}
+
+//! norm and distances to pivots of samples [from, to)
+void RecoTargetSampleHandler :: updateIndex (const unsigned int &from,
+                                             const unsigned int &to)
+{
+  norms.resize (nSamples);
+  pivotDistances.resize (nPivots * nSamples);
+  
+  double buffer[nPlanes]; // for compressed samples
+  
+  for (unsigned int i = from; i < to; i++)
+  {
+    norms[i] = samples[i].norm();
+    
+    const double *energy = samples[i].values (buffer);
+    
+    for (unsigned int p = 0; p < nPivots; p++)
+      pivotDistances[i * nPivots + p] =
+        euclidean (energy, &pivots[p * nPlanes]);
+  }
+}
+
+//! the same precision of both handlers is required (and it is the only
+//! way to compare samples without double distributions)
+const RecoTargetQuantizedSamples* RecoTargetSampleHandler :: 
+  quantizedLearning (const RecoTargetSampleHandler *sampleHandler) const
+{
+  if (quantized and sampleHandler->quantized and
+      quantized->getPrecision() == sampleHandler->quantized->getPrecision()
+      and quantized->getNDimensions() ==
+      sampleHandler->quantized->getNDimensions())
+    return sampleHandler->quantized;
+  
+  checkDistributions();
+  sampleHandler->checkDistributions();
+  
+  return NULL;
+}
+
+/*! <ul>
+ *  <li> loop over samples [first, last)
+ *  <li> add distances to learning samples [from, to) to the list, which
+ *  is a max-heap of k nearest (memory stays bounded by k)
+ *  <li> Euclidean with index (and double precision): skip learning 
+ *  sample if triangle inequality says it is farther than the current
+ *  k-th neighbor: |a - p| - |b - p| <= |a - b| (p = pivot or zero)
+ *  <li> the k-th neighbor is on top of the full heap, so the bound
+ *  tightens with every closer neighbor
+ *  </ul>
+ */
+uint64_t RecoTargetSampleHandler :: nearestNeighbors
+  (RecoTargetSampleHandler *sampleHandler,
+  const unsigned int &target,
+  const Metric &metric,
+  const unsigned int &first, const unsigned int &last,
+  const unsigned int &from, const unsigned int &to,
+  const unsigned int &k,
+  std::vector <Neighbor> *lists) const
+{
+  const RecoTargetQuantizedSamples *learning =
+    quantizedLearning (sampleHandler);
+  
+  // quantized distances differ from double, so bounds would not hold
+  const bool isPruned = metric == EUCLIDEAN and sampleHandler->isIndexed
+                        and not learning and k > 0;
+  
+  uint64_t nSkipped = 0;
+  
+  double toPivots[nPivots]; // distances of testing sample to pivots
+  
+  double buffer[nPlanes]; // pivots are dense, so is testing sample here
+  
+  for (unsigned int i = first; i < last; i++)
+  {
+    std::vector <Neighbor> &neighbors = lists[i - first];
+    
+    double norm = 0.0;
+    
+    if (isPruned)
+    {
+      norm = samples[i].norm();
+      
+      const double *energy = samples[i].values (buffer);
+      
+      for (unsigned int p = 0; p < nPivots; p++)
+        toPivots[p] = euclidean (energy,
+                                 &sampleHandler->pivots[p * nPlanes],
+                                 samples[i].nDimensions);
+    }
+    
+    for (unsigned int j = from; j < to; j++)
+    {
+      if (isPruned and neighbors.size() >= k)
+      {
+        // squared Euclidean distance of the current k-th neighbor
+        const double bound = neighbors.front().distance;
+        
+        double lowerBound = fabs (norm - sampleHandler->norms[j]);
+        
+        for (unsigned int p = 0; p < nPivots; p++)
+          lowerBound = std::max (lowerBound, fabs (toPivots[p] -
+            sampleHandler->pivotDistances[j * nPivots + p]));
+        
+        // small margin for rounding, so no true neighbor is skipped
+        lowerBound *= 1.0 - 1e-9;
+        
+        if (lowerBound * lowerBound > bound)
+        {
+          nSkipped++;
+          continue;
+        }
+      }
+      
+      const double distance = learning ?
+        quantized->distance (i, *learning, j, metric) :
+        samples[i].distance (sampleHandler->samples[j], metric);
+        
+      pushNearest (neighbors,
+                   Neighbor (distance, target, sampleHandler->firstId + j),
+                   k);
+    }
+  }
+  
+  return nSkipped;
+}
+
+/*! <ul>
+ *  <li> loop over pairs of samples (upper triangle if both ranges are
+ *  of this handler)
+ *  <li> d(i, j) = d(j, i) for all metrics, so one distance goes to
+ *  both lists (half of the work of two nearestNeighbors calls)
+ *  <li> lists are max-heaps of k nearest, as in nearestNeighbors
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: symmetricNeighbors
+  (const unsigned int &target,
+  RecoTargetSampleHandler *sampleHandler,
+  const unsigned int &sampleTarget,
+  const Metric &metric,
+  const unsigned int &first, const unsigned int &last,
+  const unsigned int &from, const unsigned int &to,
+  const unsigned int &k,
+  std::vector <Neighbor> *lists,
+  std::vector <Neighbor> *sampleLists) const
+{
+  const RecoTargetQuantizedSamples *learning =
+    quantizedLearning (sampleHandler);
+  
+  // the same samples: sample is not its own neighbor, pair is done once
+  const bool isSame = sampleHandler == this;
+  
+  for (unsigned int i = first; i < last; i++)
+    for (unsigned int j = isSame ? std::max (from, i + 1) : from; j < to;
+         j++)
+    {
+      const double distance = learning ?
+        quantized->distance (i, *learning, j, metric) :
+        samples[i].distance (sampleHandler->samples[j], metric);
+      
+      if (lists)
+        pushNearest (lists[i - first], Neighbor
+          (distance, sampleTarget, sampleHandler->firstId + j), k);
+      
+      if (sampleLists)
+        pushNearest (sampleLists[j - from],
+                     Neighbor (distance, target, firstId + i), k);
+    }
+}
+
+//! append list to sample's neighbors and clear it
+void RecoTargetSampleHandler :: addNeighbors
+  (const unsigned int &i, std::vector <Neighbor> &neighbors)
+{
+  samples[i].neighbors.insert (samples[i].neighbors.end(),
+                               neighbors.begin(), neighbors.end());
+  neighbors.clear();
+}
+
+/*! <ul>
+ *  <li> make a max-heap of sample's k nearest neighbors
+ *  <li> push neighbors of list into it (the heap never grows over k)
+ *  <li> free the list (keepNearest sorts the heap later)
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: addNearest
+  (const unsigned int &i, std::vector <Neighbor> &neighbors,
+   const unsigned int &k)
+{
+  std::vector <Neighbor> &nearest = samples[i].neighbors;
+  
+  if (nearest.size() > k) trimNeighbors (nearest, k);
+  
+  std::make_heap (nearest.begin(), nearest.end());
+  
+  for (size_t n = 0; n < neighbors.size(); n++)
+    pushNearest (nearest, neighbors[n], k);
+    
+  std::vector <Neighbor> ().swap (neighbors);
+}
+
+//! partial sort, then drop everything behind k-th neighbor
+void RecoTargetSampleHandler :: keepNearest (const unsigned int &k)
+{
+  keepNearest (k, 0, nSamples);
+}
+
+//! as above for samples [first, last)
+void RecoTargetSampleHandler :: keepNearest (const unsigned int &k,
+                                             const unsigned int &first,
+                                             const unsigned int &last)
+{
+  for (unsigned int i = first; i < last; i++)
+    trimNeighbors (samples[i].neighbors, k);
+}
+
+//! for each sample: number of neighbors, then neighbors (raw bytes)
+void RecoTargetSampleHandler :: packNeighbors
+  (std::vector <char> &buffer) const
+{
+  for (unsigned int i = 0; i < nSamples; i++)
+  {
+    const std::vector <Neighbor> &neighbors = samples[i].neighbors;
+    const unsigned int n = neighbors.size();
+    
+    const size_t offset = buffer.size();
+    buffer.resize (offset + sizeof (n) + n * sizeof (Neighbor));
+    
+    memcpy (&buffer[offset], &n, sizeof (n));
+    
+    if (n > 0)
+      memcpy (&buffer[offset + sizeof (n)], &neighbors[0],
+              n * sizeof (Neighbor));
+  }
+}
+
+/*! <ul>
+ *  <li> loop over samples
+ *  <li> read sorted partial list from each cursor
+ *  <li> k-way merge: take the nearest head of all lists, k times
+ *  <li> the result is exactly the top-k of the union of all lists
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: mergeNeighbors
+  (std::vector <const char*> &cursors, const unsigned int &k)
+{
+  const size_t nLists = cursors.size();
+  
+  std::vector <unsigned int> nLeft (nLists); // neighbors left in list
+  std::vector <Neighbor> heads (nLists);     // current head of list
+  
+  for (unsigned int i = 0; i < nSamples; i++)
+  {
+    // read the number of neighbors and the first one from each list
+    for (size_t l = 0; l < nLists; l++)
+    {
+      memcpy (&nLeft[l], cursors[l], sizeof (unsigned int));
+      cursors[l] += sizeof (unsigned int);
+      
+      if (nLeft[l] > 0) memcpy (&heads[l], cursors[l], sizeof (Neighbor));
+    }
+    
+    std::vector <Neighbor> &neighbors = samples[i].neighbors;
+    neighbors.clear();
+    
+    while (neighbors.size() < k)
+    {
+      size_t best = nLists; // list with the nearest head
+      
+      for (size_t l = 0; l < nLists; l++)
+        if (nLeft[l] > 0 and (best == nLists or heads[l] < heads[best]))
+          best = l;
+            
+      if (best == nLists) break; // all lists are empty
+      
+      neighbors.push_back (heads[best]);
+      
+      // move to the next neighbor in the best list
+      cursors[best] += sizeof (Neighbor);
+      
+      if (--nLeft[best] > 0)
+        memcpy (&heads[best], cursors[best], sizeof (Neighbor));
+    }
+    
+    // skip what was not used
+    for (size_t l = 0; l < nLists; l++)
+      cursors[l] += nLeft[l] * sizeof (Neighbor);
+  }
+}
+
+/*! <ul>
+ *  <li> drop neighbors with id < first id of their learning handler
+ *  (or with target without learning samples)
+ *  <li> if less than k neighbors left (and there are more learning
+ *  samples), the list is not the top-k anymore: fill it again from
+ *  all learning samples (by fillNeighbors, so in the same precision
+ *  as kept neighbors) and keep k nearest
+ *  </ul>
+ */
+void RecoTargetSampleHandler :: retireNeighbors
+  (RecoTargetSampleHandler **learningSamples, const Metric &metric,
+   const unsigned int &k)
+{
+  unsigned int nLearning = 0; // total number of learning samples
+  
+  for (unsigned int j = 0; j < nTargets; j++)
+    if (learningSamples[j]) nLearning += learningSamples[j]->nSamples;
+  
+  for (unsigned int i = 0; i < nSamples; i++)
+  {
+    std::vector <Neighbor> &neighbors = samples[i].neighbors;
+    
+    unsigned int nKept = 0;
+    
+    for (unsigned int n = 0; n < neighbors.size(); n++)
+    {
+      const RecoTargetSampleHandler *learning =
+        learningSamples[neighbors[n].target];
+        
+      if (learning and neighbors[n].id >= learning->firstId)
+        neighbors[nKept++] = neighbors[n];
+    }
+    
+    if (nKept == neighbors.size()) continue; // nothing retired
+    
+    neighbors.resize (nKept);
+    
+    if (nKept >= std::min (k, nLearning)) continue; // still top-k
+    
+    neighbors.clear();
+    
+    for (unsigned int j = 0; j < nTargets; j++)
+      if (learningSamples[j])
+        fillNeighbors (learningSamples[j], j, metric, 0, i, i + 1);
+    
+    trimNeighbors (neighbors, k);
+  }
+}
+
+/*! <ul>
+ *  <li> sort neighbors respect to the distance
+ *  <li> add vote of each of k nearest neighbors to its target
+ *  <li> return target with the highest score (the lowest id if tie)
+ *  <li> confidence = best target score / total score
+ *  </ul>
+ */
 int RecoTargetSampleHandler :: Sample :: closestTarget
-  (const unsigned int &k)
+  (const unsigned int &k, const Vote &vote, double *confidence)
 {
-  neighbors.sort(); // sort neighbors respect to the distance
+  double targetScore[nTargets] = {0.0};
+  
+  // use no more than available neighbors
+  const unsigned int nNearest = std::min <size_t> (k, neighbors.size());
   
-  unsigned int targetScore[nTargets] = {0};
+  // sort only k nearest neighbors respect to the distance
+  std::partial_sort (neighbors.begin(), neighbors.begin() + nNearest,
+                     neighbors.end());
+  
+  double (*pVote)(const double&, const double&) = voteFunction (vote);
+  
+  // distance to the k-th neighbor sets the scale for weighted votes
+  double scale = 0.0;
   
   // set up iterator at the begininng of the neighbors list
-  std::list < std::pair <double, unsigned int> > :: iterator it = 
-    neighbors.begin();
+  std::vector <Neighbor> :: iterator it = neighbors.begin();
+  
+  for (unsigned int i = 0; i < nNearest; i++, ++it) scale = it->distance;
+  
+  // count score per target up to k
+  double totalScore = 0.0;
   
-  // count how many entires per target is up to k 
-  for (unsigned int i = 0; i < k; i++) targetScore[(*it++).second]++;
+  it = neighbors.begin();
+  
+  for (unsigned int i = 0; i < nNearest; i++, ++it)
+  {
+    const double score = pVote (it->distance, scale);
+    targetScore[it->target] += score;
+    totalScore += score;
+  }
   
   // find the best match (target with highest score)
   
-  unsigned int bestScore = 0;
+  double bestScore = 0.0;
   unsigned int bestTarget = 0;
   
   for (unsigned int i = 0; i < nTargets; i++)
@@ -166,19 +1455,23 @@ int RecoTargetSampleHandler :: Sample :: closestTarget
       bestScore = targetScore[i];
       bestTarget = i;
     }
+  
+  if (confidence)
+    *confidence = totalScore > 0.0 ? bestScore / totalScore : 0.0;
     
   return bestTarget;
 }
 
 //! target = what target it should be, k = #nearest neighbors
 double RecoTargetSampleHandler :: getScore (const unsigned int &target,
-                                            const unsigned int &k)
+                                            const unsigned int &k,
+                                            const Vote &vote)
 {
   unsigned int score = 0; // final score = #goodGuesses / #samples
   
   // loop over sample to check how many was guessed correctly
   for (unsigned int i = 0; i < nSamples; i++)
-    if (samples[i].closestTarget (k) == target) score++;
+    if (samples[i].closestTarget (k, vote) == (int) target) score++;
     
   return 1.0 * score / nSamples;
 }
@@ -12,51 +12,489 @@
 #include "RecoTargetDetectorProperties.h"
 #include "RecoTracks.h"
 #include "RecoTargetMetrics.h"
-#include <list>
+#include "RecoTargetVoting.h"
+#include "RecoTargetQuantization.h"
+#include "RecoTargetEventStore.h"
+#include "RecoTargetProfiler.h"
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+
+namespace RecoTarget
+{
+  //! number of pivot profiles used to skip far learning samples
+  const unsigned int nPivots = 4;
+  
+  //! neighbor of a sample (learning sample seen from testing sample)
+  struct Neighbor
+  {
+    double distance;     //!< distance to the learning sample
+    unsigned int target; //!< target of the learning sample
+    unsigned int id;     //!< id of the learning sample in its handler
+    
+    //! constructor
+    Neighbor (const double &distance = 0.0, const unsigned int &target = 0,
+              const unsigned int &id = 0)
+      : distance (distance), target (target), id (id) {}
+    
+    //! order by distance, then target, then id
+    inline bool operator< (const Neighbor &neighbor) const
+    {
+      if (distance != neighbor.distance) return distance < neighbor.distance;
+      if (target != neighbor.target) return target < neighbor.target;
+      return id < neighbor.id;
+    };
+  };
+}
 
 class RecoTargetSampleHandler
 {
   public:
   
-  RecoTargetSampleHandler (const int &n); //!< constructor
+  //! constructor (n samples, ids starting from firstId)
+  RecoTargetSampleHandler (const int &n, const unsigned int &firstId = 0);
+  ~RecoTargetSampleHandler (); //!< destructor
+  
+  //! set the number of samples (reuses memory of the previous run)
+  void resize (const unsigned int &n, const unsigned int &firstId = 0);
 
-  //! fill samples from recoTracks
+  //! fill samples from given entries of recoTracks (one per sample)
   void fillSamples (RECOTRACKS_ANA::RecoTracks *recoTracks,
-                    const unsigned int &start = 0,
-                    const unsigned int &step = 2);
+                    const unsigned int *entries);
+  
+  //! fill samples [first, last) from entries[first, last) of recoTracks
+  void fillSamples (RECOTRACKS_ANA::RecoTracks *recoTracks,
+                    const unsigned int *entries,
+                    const unsigned int &first, const unsigned int &last);
+  
+  //! fill samples from given entries of memory-mapped event store
+  void fillSamples (const RecoTargetEventStore &store,
+                    const unsigned int *entries);
+  
+  //! fill samples [first, last) from entries[first, last) of store
+  void fillSamples (const RecoTargetEventStore &store,
+                    const unsigned int *entries,
+                    const unsigned int &first, const unsigned int &last);
+  
+  //! add "n" samples (given entries of recoTracks) after existing ones
+  void appendSamples (RECOTRACKS_ANA::RecoTracks *recoTracks,
+                      const unsigned int *entries,
+                      const unsigned int &n);
+  
+  //! add a single sample after existing ones
+  void appendSample (const double *planeVisibleEnergy, const int *planeId,
+                     const unsigned int &nFilledPlanes);
+  
+  //! as above, but plane z-orders are already known (e.g. event store)
+  void appendSample (const double *planeVisibleEnergy,
+                     const uint8_t *planeZorder,
+                     const unsigned int &nFilledPlanes);
   
-  //! fill neighbors list for each sample                  
+  //! remove "n" oldest samples
+  void retireSamples (const unsigned int &n);
+  
+  //! fill neighbors list for each sample (only with learning samples
+  //! with id >= fromId, e.g. appended since the last call)
+  void fillNeighbors (RecoTargetSampleHandler *sampleHandler,
+                      const unsigned int &target,
+                      const RecoTarget::Metric &metric,
+                      const unsigned int &fromId = 0);
+  
+  //! as above, but only for samples [first, last); different ranges
+  //! may be filled by different threads at the same time
   void fillNeighbors (RecoTargetSampleHandler *sampleHandler,
                       const unsigned int &target,
-                      const RecoTarget::Metric &metric);
+                      const RecoTarget::Metric &metric,
+                      const unsigned int &fromId,
+                      const unsigned int &first, const unsigned int &last);
+  
+  //! for samples [first, last) add k nearest of learning samples with
+  //! index [from, to) to lists[i - first]; lists belong to the caller,
+  //! so many threads can work on the same samples at the same time;
+  //! each list is a max-heap of at most k neighbors (empty or left by
+  //! previous calls with the same k), not sorted;
+  //! return the number of learning samples skipped by index
+  uint64_t nearestNeighbors (RecoTargetSampleHandler *sampleHandler,
+                             const unsigned int &target,
+                             const RecoTarget::Metric &metric,
+                             const unsigned int &first,
+                             const unsigned int &last,
+                             const unsigned int &from,
+                             const unsigned int &to,
+                             const unsigned int &k,
+                             std::vector <RecoTarget::Neighbor> *lists)
+                             const;
+  
+  //! distances between samples [first, last) of this handler and
+  //! [from, to) of sampleHandler (the same handler: only pairs i < j),
+  //! each computed once and added to both sides: to lists[i - first]
+  //! and to sampleLists[j - from] (NULL = side not filled); lists are
+  //! max-heaps of k nearest, as in nearestNeighbors
+  void symmetricNeighbors (const unsigned int &target,
+                           RecoTargetSampleHandler *sampleHandler,
+                           const unsigned int &sampleTarget,
+                           const RecoTarget::Metric &metric,
+                           const unsigned int &first,
+                           const unsigned int &last,
+                           const unsigned int &from,
+                           const unsigned int &to,
+                           const unsigned int &k,
+                           std::vector <RecoTarget::Neighbor> *lists,
+                           std::vector <RecoTarget::Neighbor> *sampleLists)
+                           const;
+  
+  //! precompute norms and distances to pivot profiles, so learning
+  //! samples which can not be among k nearest (Euclidean) are skipped
+  //! by nearestNeighbors; index is kept up to date until resize
+  void index ();
+  
+  //! move neighbors from list to i-th sample (list keeps its capacity)
+  void addNeighbors (const unsigned int &i,
+                     std::vector <RecoTarget::Neighbor> &neighbors);
+  
+  //! merge list into k nearest neighbors of i-th sample and free it
+  //! (neighbors are sorted only by keepNearest)
+  void addNearest (const unsigned int &i,
+                   std::vector <RecoTarget::Neighbor> &neighbors,
+                   const unsigned int &k);
+  
+  //! keep only k nearest neighbors of each sample (sorted)
+  void keepNearest (const unsigned int &k);
+  
+  //! keep only k nearest neighbors of samples [first, last)
+  void keepNearest (const unsigned int &k, const unsigned int &first,
+                    const unsigned int &last);
+  
+  //! append neighbors of all samples to buffer
+  void packNeighbors (std::vector <char> &buffer) const;
+  
+  //! replace neighbors by k nearest from partial lists packed by
+  //! packNeighbors (one per rank, all sorted); cursors are moved behind
+  //! the data of this handler
+  void mergeNeighbors (std::vector <const char*> &cursors,
+                       const unsigned int &k);
+  
+  //! remove neighbors retired from learning samples; samples left with
+  //! less than k neighbors are filled again from all learning samples
+  void retireNeighbors (RecoTargetSampleHandler **learningSamples,
+                        const RecoTarget::Metric &metric,
+                        const unsigned int &k);
+  //! keep a copy of samples with given precision (DOUBLE = remove copy)
+  //! fillNeighbors uses it if both handlers have the same precision
+  void quantize (const RecoTarget::Precision &precision);
+  
+  //! free double distributions of quantized samples, only the copy is
+  //! kept (e.g. learning samples of server, no double pass there): then
+  //! distances need testing samples of the same precision, and samples
+  //! can not be converted, indexed, retired, filled or appended (until
+  //! resize)
+  void dropDistributions ();
+  
+  //! replace energy distributions by compact features (false = keep
+  //! them); samples filled later are converted too, until resize
+  void useFeatures (const bool &features);
+  
+  //! return true if samples keep features instead of distributions
+  inline bool getFlagFeatures () const
+  {
+    return isFeatures;
+  };
+  
+  //! keep only energy of given planes (z-order, sorted; empty = all),
+  //! packed at the beginning of distributions; samples filled later are
+  //! converted too, until resize
+  void useRegion (const std::vector <unsigned int> &planes);
+  
+  //! return planes of region of interest (empty = all planes)
+  inline const std::vector <unsigned int>& getRegion () const
+  {
+    return region;
+  };
+  
+  //! as useFeatures, useRegion and quantize at once, but for samples
+  //! which are not filled yet (after constructor or resize): nothing is
+  //! converted or copied now, samples are converted when filled
+  void prepare (const bool &features,
+                const std::vector <unsigned int> &planes,
+                const RecoTarget::Precision &precision);
+  
+  //! keep only the window of non-zero planes of each sample (false =
+  //! keep all planes); samples filled later are compressed too; quantized
+  //! copy stays dense (all dimensions of each sample), so compression
+  //! saves nothing there
+  void compress (const bool &compressed);
+  
+  //! return true if samples keep only non-zero windows
+  inline bool getFlagCompressed () const
+  {
+    return isCompressed;
+  };
+  
+  //! count hardware events of filling samples (NULL = stop counting)
+  inline void profile (RecoTargetProfiler *profiler)
+  {
+    this->profiler = profiler;
+  };
+  
+  //! remove all neighbors (e.g. before filling them again)
+  void clearNeighbors ();
+  
   //! check how many times the target is predicted correctly
-  double getScore (const unsigned int &target, const unsigned int &k);
+  double getScore (const unsigned int &target, const unsigned int &k,
+                   const RecoTarget::Vote &vote = RecoTarget::MAJORITY);
+  
+  //! return target predicted for i-th sample by its k nearest neighbors
+  //! (confidence = winner's share of the vote, if not NULL)
+  inline unsigned int getPrediction (const unsigned int &i,
+                                     const unsigned int &k,
+                                     const RecoTarget::Vote &vote,
+                                     double *confidence = NULL)
+  {
+    return samples[i].closestTarget (k, vote, confidence);
+  };
+
+  //! return the number of samples
+  inline unsigned int getNSamples () const
+  {
+    return nSamples;
+  };
+  
+  //! return neighbors of i-th sample (sorted only after keepNearest)
+  inline const std::vector <RecoTarget::Neighbor>& getNeighbors
+    (const unsigned int &i) const
+  {
+    return samples[i].neighbors;
+  };
+  
+  //! return id of the oldest sample (ids are given in order of filling)
+  inline unsigned int getFirstId () const
+  {
+    return firstId;
+  };
+  
+  //! return id the next appended sample will get
+  inline unsigned int getNextId () const
+  {
+    return firstId + nSamples;
+  };
 
   private:
+  
+  friend class RecoTargetClassifier; //!< uses samples for classification
+  friend class RecoTargetReduction; //!< replaces samples by reduced set
+  friend class RecoTargetRegion; //!< ranks planes of learning samples
+  friend class RecoTargetValidation; //!< computes reference neighbors
+  
+  //! handler owns samples table, so it can not be copied
+  RecoTargetSampleHandler (const RecoTargetSampleHandler &);
+  RecoTargetSampleHandler& operator= (const RecoTargetSampleHandler &);
       
-  //! single sample contains a table with energy in each plane
+  //! single sample points to a table with energy in each plane
   struct Sample
   {
-    double energyPerPlane[RecoTarget::nPlanes]; //!< plane energy distr
+    //! plane energy distr of planes [firstPlane, firstPlane + size) in
+    //! z-order, kept by handler: dense samples point to their row of all
+    //! nPlanes, compressed ones to the window from the first to the last
+    //! non-zero plane (NULL = not filled, or dropped)
+    double *energyPerPlane;
+    unsigned int size;       //!< number of values of energyPerPlane
+    unsigned int firstPlane; //!< z-order of energyPerPlane[0]
+    
+    double inverseNorm; //!< 1 / Euclidean norm (0 for empty sample)
+    
+    //! z-orders [nonZeroFrom, nonZeroTo) from the first to the last
+    //! non-zero value (outside them distances of windows skip zeros)
+    unsigned int nonZeroFrom;
+    unsigned int nonZeroTo;
+    
+    //! number of used values in energyPerPlane (nPlanes, nFeatures
+    //! if it was replaced by features, or the size of region)
+    unsigned int nDimensions;
+    
+    //! constructor (table is given by handler, energy is set by fill)
+    Sample () : energyPerPlane (NULL), size (0), firstPlane (0),
+                inverseNorm (0.0), nonZeroFrom (0), nonZeroTo (0),
+                nDimensions (RecoTarget::nPlanes) {}
    
-    //! fill energyPerPlane in proper order
+    //! fill energyPerPlane in proper order (dense sample)
     void fill (const double *planeVisibleEnergy, const int *planeId, 
                const unsigned int &nFilledPlanes);
+    
+    //! fill energyPerPlane from planes given by z-order (dense sample)
+    void fillOrdered (const double *planeVisibleEnergy,
+                      const uint8_t *planeZorder,
+                      const unsigned int &nFilledPlanes);
+    
+    //! divide energyPerPlane by total energy, save inverse norm
+    void normalize (const double &totalEnergy);
+    
+    //! replace energy distribution by its features (see Features.h),
+    //! dense sample
+    void extractFeatures ();
+    
+    //! keep only energy of given planes (in their order), dense sample
+    void selectPlanes (const std::vector <unsigned int> &planes);
+    
+    //! save inverse norm and non-zero range of energyPerPlane
+    void updateNorms ();
+    
+    //! write all nPlanes values to dense (zeros outside the window)
+    void expand (double *dense) const;
+    
+    //! return all nPlanes values (kept ones, or expanded to buffer)
+    const double* values (double *buffer) const;
+    
+    //! return true if all nPlanes values are kept
+    inline bool isDense () const
+    {
+      return size == RecoTarget::nPlanes;
+    };
    
     //! calculate distance between two samples
     double distance (const Sample &sample,
-                     const RecoTarget::Metric &metric);
+                     const RecoTarget::Metric &metric) const;
+    
+    //! as above, for samples which are not both dense
+    double windowDistance (const Sample &sample,
+                           const RecoTarget::Metric &metric) const;
+                     
+    //! return Euclidean norm of energyPerPlane
+    double norm () const;
+    
+    //! return dot product of energy distributions
+    double dot (const Sample &sample) const;
                      
     //! get the target having k nearest neighbors to the sample
-    int closestTarget (const unsigned int &k);
+    int closestTarget (const unsigned int &k,
+                       const RecoTarget::Vote &vote = RecoTarget::MAJORITY,
+                       double *confidence = NULL);
                      
-    //! nighbors list (pair <distance, target>)
-    std::list < std::pair <double, unsigned int> > neighbors;
+    //! nighbors list, cleared but not freed between runs, so its
+    //! capacity is reused
+    std::vector <RecoTarget::Neighbor> neighbors;
+  };
+  
+  //! sample with its own table (not kept by handler: scratch sample
+  //! which is compressed into the pool, event being classified)
+  struct DenseSample : public Sample
+  {
+    double row[RecoTarget::nPlanes]; //!< energy in each plane
+    
+    //! constructor (empty sample)
+    DenseSample ();
+    
+    //! copy constructor (table is copied, not shared)
+    DenseSample (const DenseSample &sample);
+    
+    //! assignment (table is copied, not shared)
+    DenseSample& operator= (const DenseSample &sample);
+    
+    //! copy values (expanded) and norms of any sample
+    void assign (const Sample &sample);
   };
+  
+  //! pool of samples, first nSamples are in use, the rest only keep
+  //! their buffers for the next run
+  std::vector <Sample> samples;
+  
+  //! tables of dense samples: one row of nPlanes per sample of pool, in
+  //! one block (so learning samples are contiguous); empty if samples
+  //! are compressed
+  std::vector <double> rows;
+  
+  //! windows of compressed samples one after another; window of sample
+  //! which is filled again is appended, the old one is dropped when the
+  //! arena is packed (empty if samples are dense)
+  std::vector <double> windows;
+  
+  //! reduced precision copy of samples (NULL if not used)
+  RecoTargetQuantizedSamples *quantized;
+  
+  unsigned int nSamples;
+  
+  //! id of samples[0] (samples[i] has id = firstId + i)
+  unsigned int firstId;
+  
+  //! grow the pool of samples (if needed) to keep n samples
+  void reserve (const unsigned int &n);
+  
+  //! give each sample of pool its row of a new block (values are kept,
+  //! compressed ones are expanded), free windows
+  void allocateRows ();
+  
+  //! keep only the non-zero window of dense sample as i-th sample (its
+  //! values and norms are copied to the arena)
+  void storeWindow (const unsigned int &i, const Sample &sample);
+  
+  //! move windows of pool to a new arena with room for n more values
+  void packWindows (const size_t &n);
+  
+  bool isFeatures; //!< true if samples are converted to features
+  
+  bool isCompressed; //!< true if samples keep only non-zero windows
+  
+  //! planes kept by samples (z-order, empty = all planes)
+  std::vector <unsigned int> region;
+  
+  RecoTargetProfiler *profiler; //!< counts of fill (NULL = not used)
+  
+  bool isIndexed; //!< true if norms and pivot distances are kept
+  
+  bool isDropped; //!< true if only quantized copy of samples is kept
+  
+  //! throw BAD_ARGUMENT if double distributions were dropped
+  void checkDistributions () const;
+  
+  //! add neighbor to max-heap of k nearest (the farthest on top), so
+  //! the list never holds more than k neighbors; return true if added
+  static inline bool pushNearest
+    (std::vector <RecoTarget::Neighbor> &neighbors,
+     const RecoTarget::Neighbor &neighbor, const unsigned int &k)
+  {
+    if (neighbors.size() < k)
+    {
+      neighbors.reserve (k);
+      neighbors.push_back (neighbor);
+      std::push_heap (neighbors.begin(), neighbors.end());
+    }
+    else if (k > 0 and neighbor < neighbors.front())
+    {
+      std::pop_heap (neighbors.begin(), neighbors.end());
+      neighbors.back() = neighbor;
+      std::push_heap (neighbors.begin(), neighbors.end());
+    }
+    else return false;
     
-  Sample *samples; //!< table with all samples
+    return true;
+  };
+  
+  std::vector <double> pivots;         //!< nPivots profiles (nPlanes each)
+  std::vector <double> norms;          //!< Euclidean norm of each sample
+  std::vector <double> pivotDistances; //!< nPivots per sample
+  
+  //! compute norms and pivot distances of samples [from, to)
+  void updateIndex (const unsigned int &from, const unsigned int &to);
+  
+  //! return quantized learning samples if they have the same precision
+  //! as this handler (NULL = compare in double)
+  const RecoTargetQuantizedSamples* quantizedLearning
+    (const RecoTargetSampleHandler *sampleHandler) const;
+  
+  //! throw BAD_ARGUMENT if planes can not be region of samples (with
+  //! or without features)
+  void checkRegion (const std::vector <unsigned int> &planes,
+                    const bool &features) const;
+  
+  //! create quantized storage for nSamples with stride of region, or
+  //! reuse the old one if it has the same precision and stride (DOUBLE
+  //! = remove it); copies are not updated
+  void allocateQuantized (const RecoTarget::Precision &precision);
+  
+  //! copy samples from "from" to quantized storage and index (if used)
+  void updateCopies (const unsigned int &from = 0);
   
-  unsigned int nSamples;  
+  //! copy samples [from, to) to quantized storage and index (if used)
+  void updateCopies (const unsigned int &from, const unsigned int &to);
 };
 
 #endif
@@ -0,0 +1,353 @@
+#include "RecoTargetScheduler.h"
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+
+using namespace RecoTarget;
+
+RecoTargetScheduler :: RecoTargetScheduler (const unsigned int &nThreads,
+                                            RecoTargetProfiler *profiler)
+  : nThreads (std::max (nThreads, 1u)), profiler (profiler), nCandidates (0),
+    nSkipped (this->nThreads, 0), queues (this->nThreads),
+    lists (this->nThreads)
+{
+}
+
+//! sum over threads
+uint64_t RecoTargetScheduler :: getNSkipped () const
+{
+  uint64_t n = 0;
+  
+  for (unsigned int t = 0; t < nThreads; t++) n += nSkipped[t];
+  
+  return n;
+}
+
+//! testing targets selected by options
+void RecoTargetScheduler :: fillNeighbors
+  (RecoTargetSampleHandler **testingSamples,
+   RecoTargetSampleHandler **learningSamples,
+   const RecoTargetUserOptions &userOptions)
+{
+  bool isTestingTarget[nTargets];
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    isTestingTarget[i] = userOptions.getFlagTestingTarget (i);
+  
+  fillNeighbors (testingSamples, learningSamples, isTestingTarget,
+                 userOptions);
+}
+
+//! samples go to the place of the first target (which one is not used)
+void RecoTargetScheduler :: fillNeighbors
+  (RecoTargetSampleHandler *testingSamples,
+   RecoTargetSampleHandler **learningSamples,
+   const RecoTargetUserOptions &userOptions)
+{
+  RecoTargetSampleHandler *samples[nTargets] = {testingSamples};
+  const bool isTestingTarget[nTargets] = {true};
+  
+  fillNeighbors (samples, learningSamples, isTestingTarget, userOptions);
+}
+
+/*! <ul>
+ *  <li> find where each testing target starts in per-thread lists
+ *  <li> split all selected pairs of targets into tasks
+ *  <li> run threads on tasks, then merge lists
+ *  </ul>
+ */
+void RecoTargetScheduler :: fillNeighbors
+  (RecoTargetSampleHandler **testingSamples,
+   RecoTargetSampleHandler **learningSamples,
+   const bool *isTestingTarget,
+   const RecoTargetUserOptions &userOptions)
+{
+  offsets[0] = 0;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    offsets[i + 1] = offsets[i] + 
+      (isTestingTarget[i] ? testingSamples[i]->getNSamples() : 0);
+  
+  clearLists();
+  
+  unsigned int nTasks = 0;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    if (not isTestingTarget[i]) continue;
+    
+    const unsigned int nTesting = testingSamples[i]->getNSamples();
+    
+    for (unsigned int first = 0; first < nTesting; first += testingBlock)
+      for (unsigned int j = 0; j < nTargets; j++)
+      {
+        if (not userOptions.getFlagLearningTarget (j)) continue;
+        
+        const unsigned int nLearning = learningSamples[j]->getNSamples();
+        
+        for (unsigned int from = 0; from < nLearning; from += learningBlock)
+        {
+          const Task task = {i, first, std::min (nTesting, first +
+                             testingBlock), j, from, std::min (nLearning,
+                             from + learningBlock), false, true, false};
+          
+          queues[nTasks++ % nThreads].tasks.push_back (task);
+          
+          nCandidates += nPairs (task);
+        }
+      }
+  }
+  
+  run (testingSamples, learningSamples,
+       (Metric) userOptions.getMetric(), userOptions.getMaxNeighbors());
+}
+
+/*! <ul>
+ *  <li> samples of all loaded targets one after another in lists
+ *  <li> tasks = pairs of blocks of the upper triangle: targets i <= j,
+ *  and blocks from the diagonal on within one target
+ *  <li> block gets neighbors if its target is testing and the other
+ *  one is learning (pairs with no side filled are not computed)
+ *  <li> run threads on tasks, then merge lists
+ *  </ul>
+ */
+void RecoTargetScheduler :: fillSymmetric
+  (RecoTargetSampleHandler **samples,
+   const RecoTargetUserOptions &userOptions)
+{
+  offsets[0] = 0;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    offsets[i + 1] = offsets[i] +
+      (samples[i] ? samples[i]->getNSamples() : 0);
+  
+  clearLists();
+  
+  unsigned int nTasks = 0;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    for (unsigned int j = i; j < nTargets; j++)
+    {
+      if (not samples[i] or not samples[j]) continue;
+      
+      const bool toFirst = userOptions.getFlagTestingTarget (i) and
+                           userOptions.getFlagLearningTarget (j);
+      const bool toSecond = userOptions.getFlagTestingTarget (j) and
+                            userOptions.getFlagLearningTarget (i);
+      
+      if (not toFirst and not toSecond) continue;
+      
+      const unsigned int nFirst = samples[i]->getNSamples();
+      const unsigned int nSecond = samples[j]->getNSamples();
+      
+      for (unsigned int first = 0; first < nFirst; first += symmetricBlock)
+        for (unsigned int from = i == j ? first : 0; from < nSecond;
+             from += symmetricBlock)
+        {
+          const Task task = {i, first, std::min (nFirst, first +
+                             symmetricBlock), j, from, std::min (nSecond,
+                             from + symmetricBlock), true, toFirst,
+                             toSecond};
+          
+          queues[nTasks++ % nThreads].tasks.push_back (task);
+          
+          nCandidates += nPairs (task);
+        }
+    }
+  
+  run (samples, samples, (Metric) userOptions.getMetric(),
+       userOptions.getMaxNeighbors());
+}
+
+//! diagonal block of symmetric task has each pair once
+uint64_t RecoTargetScheduler :: nPairs (const Task &task)
+{
+  const uint64_t n = task.last - task.first;
+  
+  if (task.isSymmetric and task.testingTarget == task.learningTarget and
+      task.first == task.from) return n * (n - 1) / 2;
+  
+  return n * (task.to - task.from);
+}
+
+//! clean lists (e.g. left by failed run)
+void RecoTargetScheduler :: clearLists ()
+{
+  for (unsigned int t = 0; t < nThreads; t++)
+  {
+    lists[t].resize (offsets[nTargets]);
+    
+    for (size_t s = 0; s < lists[t].size(); s++) lists[t][s].clear();
+  }
+}
+
+/*! <ul>
+ *  <li> run threads on tasks, then (after all are done) merge lists
+ *  <li> lists are freed, they are as big as all testing samples
+ *  <li> the first error of any thread is rethrown here
+ *  </ul>
+ */
+void RecoTargetScheduler :: run (RecoTargetSampleHandler **testingSamples,
+                                 RecoTargetSampleHandler **learningSamples,
+                                 const Metric &metric, const unsigned int &k)
+{
+  std::exception_ptr error;
+  std::mutex errorMutex;
+  
+  // run given member on all threads, keep the first error
+  auto runThreads = [&] (const std::function <void (unsigned int)> &job)
+  {
+    std::vector <std::thread> threads;
+    
+    for (unsigned int t = 0; t < nThreads; t++)
+      threads.push_back (std::thread ([&, t]
+      {
+        try
+        {
+          job (t);
+        }
+        catch (...)
+        {
+          std::lock_guard <std::mutex> lock (errorMutex);
+          if (not error) error = std::current_exception();
+        }
+      }));
+      
+    for (unsigned int t = 0; t < nThreads; t++) threads[t].join();
+  };
+  
+  runThreads ([&] (unsigned int t)
+              { work (t, testingSamples, learningSamples, metric, k); });
+  
+  if (error)
+  {
+    for (unsigned int t = 0; t < nThreads; t++) queues[t].tasks.clear();
+    std::rethrow_exception (error);
+  }
+  
+  runThreads ([&] (unsigned int t) { merge (t, testingSamples, k); });
+  
+  for (unsigned int t = 0; t < nThreads; t++)
+    std::vector < std::vector <Neighbor> > ().swap (lists[t]);
+  
+  if (error) std::rethrow_exception (error);
+}
+
+/*! <ul>
+ *  <li> take the last task of own queue (the most recently dealt)
+ *  <li> if there is none, steal the first task of next queues
+ *  </ul>
+ */
+bool RecoTargetScheduler :: takeTask (const unsigned int &thread,
+                                      Task &task)
+{
+  for (unsigned int n = 0; n < nThreads; n++)
+  {
+    const unsigned int victim = (thread + n) % nThreads;
+    
+    Queue &queue = queues[victim];
+    
+    std::lock_guard <std::mutex> lock (queue.mutex);
+    
+    if (queue.tasks.empty()) continue;
+    
+    if (victim == thread)
+    {
+      task = queue.tasks.back();
+      queue.tasks.pop_back();
+    }
+    else
+    {
+      task = queue.tasks.front();
+      queue.tasks.pop_front();
+    }
+    
+    return true;
+  }
+  
+  return false; // tasks are only taken, so nothing will come
+}
+
+/*! <ul>
+ *  <li> fill thread's own top-k lists task by task (symmetric task
+ *  fills lists of both blocks)
+ *  <li> if profiled: count only tasks (not taking them) and the number
+ *  of distances computed
+ *  </ul>
+ */
+void RecoTargetScheduler :: work (const unsigned int &thread,
+                                  RecoTargetSampleHandler **testingSamples,
+                                  RecoTargetSampleHandler **learningSamples,
+                                  const Metric &metric,
+                                  const unsigned int &k)
+{
+  std::unique_ptr <RecoTargetCounters> counters
+    (profiler ? new RecoTargetCounters : NULL);
+  
+  uint64_t nDistances = 0;
+  
+  Task task;
+  
+  while (takeTask (thread, task))
+  {
+    std::vector <Neighbor> *first =
+      &lists[thread][offsets[task.testingTarget] + task.first];
+    
+    if (counters) counters->start();
+    
+    uint64_t n = 0; // skipped by index
+    
+    if (task.isSymmetric)
+      testingSamples[task.testingTarget]->symmetricNeighbors
+        (task.testingTarget, learningSamples[task.learningTarget],
+         task.learningTarget, metric, task.first, task.last, task.from,
+         task.to, k, task.toFirst ? first : NULL, task.toSecond ?
+         &lists[thread][offsets[task.learningTarget] + task.from] : NULL);
+    else
+      n = testingSamples[task.testingTarget]->nearestNeighbors
+        (learningSamples[task.learningTarget], task.learningTarget, metric,
+         task.first, task.last, task.from, task.to, k, first);
+    
+    if (counters) counters->stop();
+    
+    nSkipped[thread] += n;
+    nDistances += nPairs (task) - n;
+  }
+  
+  if (counters) profiler->add (NEIGHBORS, thread, *counters, nDistances);
+}
+
+/*! <ul>
+ *  <li> thread takes its part of all testing samples
+ *  <li> merges top-k lists of all threads into sample's k nearest
+ *  (the same as top-k of the full list), frees each list
+ *  <li> sorts k nearest
+ *  </ul>
+ */
+void RecoTargetScheduler :: merge (const unsigned int &thread,
+                                   RecoTargetSampleHandler **testingSamples,
+                                   const unsigned int &k)
+{
+  const unsigned int nAll = offsets[nTargets];
+  
+  const unsigned int begin = 1ull * nAll * thread / nThreads;
+  const unsigned int end = 1ull * nAll * (thread + 1) / nThreads;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    // part of this target's samples in [begin, end)
+    const unsigned int first = std::max (begin, offsets[i]);
+    const unsigned int last = std::min (end, offsets[i + 1]);
+    
+    if (first >= last) continue;
+    
+    for (unsigned int s = first; s < last; s++)
+      for (unsigned int t = 0; t < nThreads; t++)
+        testingSamples[i]->addNearest (s - offsets[i], lists[t][s], k);
+        
+    testingSamples[i]->keepNearest (k, first - offsets[i],
+                                    last - offsets[i]);
+  }
+}
@@ -0,0 +1,150 @@
+/**
+ * @brief Work-stealing scheduler for filling neighbors
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_SCHEDULER_H
+#define RECO_TARGET_SCHEDULER_H
+
+#include "RecoTargetSampleHandler.h"
+#include "RecoTargetUserOptions.h"
+#include "RecoTargetProfiler.h"
+#include <stdint.h>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace RecoTarget
+{
+  const unsigned int testingBlock = 32;    //!< testing samples per task
+  const unsigned int learningBlock = 1024; //!< learning samples per task
+  
+  //! samples per block of symmetric task (two blocks stay in L2 cache)
+  const unsigned int symmetricBlock = 128;
+}
+
+/*! fill k nearest neighbors with many threads:
+ *  <ul>
+ *  <li> (testing block x learning block) space of all selected target
+ *  pairs is split into tasks, dealt round-robin to threads' deques
+ *  <li> thread takes tasks from the back of its deque, when it is empty
+ *  it steals from the front of others (so big targets do not leave
+ *  threads idle)
+ *  <li> each thread keeps its own top-k list per testing sample (a
+ *  max-heap of at most k neighbors)
+ *  <li> at the end lists are merged; each thread merges different
+ *  samples, so no locks are needed
+ *  </ul>
+ *  only k nearest neighbors are kept (it is all getScore needs), so 
+ *  indexed learning samples can be skipped (see nearestNeighbors)
+ *
+ *  fillSymmetric deals pairs of blocks of one set of samples, so each
+ *  distance updates lists of both samples (no index is used there)
+ */
+class RecoTargetScheduler
+{
+  public:
+  
+  //! constructor (profiler = NULL: hardware counters are not used)
+  RecoTargetScheduler (const unsigned int &nThreads,
+                       RecoTargetProfiler *profiler = NULL);
+  
+  //! add kmax nearest neighbors from selected learning targets to
+  //! selected testing targets (as fillNeighbors does for each pair)
+  void fillNeighbors (RecoTargetSampleHandler **testingSamples,
+                      RecoTargetSampleHandler **learningSamples,
+                      const RecoTargetUserOptions &userOptions);
+  
+  //! as above, for samples of unknown target (e.g. served events)
+  void fillNeighbors (RecoTargetSampleHandler *testingSamples,
+                      RecoTargetSampleHandler **learningSamples,
+                      const RecoTargetUserOptions &userOptions);
+  
+  //! leave-one-out: samples of selected testing targets get kmax
+  //! nearest of other samples of selected learning targets (all in one
+  //! set); each distance is computed once for both samples of the pair
+  void fillSymmetric (RecoTargetSampleHandler **samples,
+                      const RecoTargetUserOptions &userOptions);
+  
+  //! return the number of (testing, learning) pairs seen so far
+  inline uint64_t getNCandidates () const
+  {
+    return nCandidates;
+  };
+  
+  //! return how many of them were skipped by learning samples index
+  uint64_t getNSkipped () const;
+  
+  private:
+  
+  //! (testing block x learning block) of one pair of targets
+  struct Task
+  {
+    unsigned int testingTarget;  //!< testing target
+    unsigned int first, last;    //!< testing samples [first, last)
+    unsigned int learningTarget; //!< learning target
+    unsigned int from, to;       //!< learning samples [from, to)
+    bool isSymmetric; //!< both blocks are of one set (fillSymmetric)
+    bool toFirst;     //!< samples [first, last) get neighbors
+    bool toSecond;    //!< samples [from, to) get neighbors (symmetric)
+  };
+  
+  //! tasks of one thread (owner uses back, thieves use front)
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque <Task> tasks;
+  };
+  
+  unsigned int nThreads; //!< number of threads
+  
+  RecoTargetProfiler *profiler; //!< counts of threads (NULL = off)
+  
+  uint64_t nCandidates;            //!< pairs in all tasks so far
+  std::vector <uint64_t> nSkipped; //!< skipped pairs (per thread)
+  
+  std::vector <Queue> queues; //!< one queue per thread
+  
+  //! per thread: top-k list for each testing sample (all targets one
+  //! after another); freed after merge
+  std::vector < std::vector < std::vector <RecoTarget::Neighbor> > > lists;
+  
+  //! index of the first sample of each testing target in lists
+  unsigned int offsets[RecoTarget::nTargets + 1];
+  
+  //! deal tasks of testing targets selected by flags, run them
+  void fillNeighbors (RecoTargetSampleHandler **testingSamples,
+                      RecoTargetSampleHandler **learningSamples,
+                      const bool *isTestingTarget,
+                      const RecoTargetUserOptions &userOptions);
+  
+  //! return the number of distances of task
+  static uint64_t nPairs (const Task &task);
+  
+  //! resize lists to offsets, clear them
+  void clearLists ();
+  
+  //! run threads on dealt tasks, then merge their lists
+  void run (RecoTargetSampleHandler **testingSamples,
+            RecoTargetSampleHandler **learningSamples,
+            const RecoTarget::Metric &metric, const unsigned int &k);
+  
+  //! take own task or steal one (false if all queues are empty)
+  bool takeTask (const unsigned int &thread, Task &task);
+  
+  //! thread: process tasks until none is left
+  void work (const unsigned int &thread,
+             RecoTargetSampleHandler **testingSamples,
+             RecoTargetSampleHandler **learningSamples,
+             const RecoTarget::Metric &metric, const unsigned int &k);
+  
+  //! thread: merge lists of all threads for samples of given part
+  void merge (const unsigned int &thread,
+              RecoTargetSampleHandler **testingSamples,
+              const unsigned int &k);
+};
+
+#endif
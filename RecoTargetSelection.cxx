@@ -0,0 +1,169 @@
+#include "RecoTargetSelection.h"
+#include "RecoTargetException.h"
+#include <algorithm>
+#include <random>
+#include <sstream>
+#include <stdint.h>
+
+namespace RecoTarget
+{
+  //! use for understandable cout's
+  const char *listOfSelections[] =
+  {
+    "Every n-th entry",
+    "Random (seeded)",
+    "Random, stratified by file",
+    "All entries"
+  };
+  
+  //! odd entries (testing) or even entries (learning) in [0, nEntries)
+  unsigned int nAvailable (const unsigned int &nEntries,
+                           const bool &isTesting)
+  {
+    return isTesting ? nEntries / 2 : (nEntries + 1) / 2;
+  }
+}
+
+namespace
+{
+  using namespace RecoTarget;
+  
+  //! throw if there is not enough entries
+  void checkAvailable (const unsigned int &sampleSize,
+                       const unsigned int &available)
+  {
+    if (sampleSize <= available) return;
+    
+    std::ostringstream message;
+    message << "requested " << sampleSize << " entries, but only "
+            << available << " are available";
+    
+    throw Exception (BAD_ARGUMENT, message.str());
+  }
+  
+  /*! choose n of entries (with given parity) in [from, to) in order
+   *  (Knuth's selection sampling, every subset is equally likely);
+   *  uses raw generator output, so it is the same on every platform
+   */
+  void selectRandom (const unsigned int &from, const unsigned int &to,
+                     const bool &isTesting, const unsigned int &n,
+                     std::mt19937 &generator,
+                     std::vector <unsigned int> &entries)
+  {
+    unsigned int first = from;
+    
+    if (first % 2 != (isTesting ? 1u : 0u)) first++; // proper parity
+    
+    // the number of candidates left
+    unsigned int nLeft = first < to ? (to - first + 1) / 2 : 0;
+    unsigned int nNeeded = n;
+    
+    for (unsigned int entry = first; nNeeded > 0; entry += 2, nLeft--)
+      if ((uint64_t) generator() * nLeft < (uint64_t) nNeeded << 32)
+      {
+        entries.push_back (entry);
+        nNeeded--;
+      }
+  }
+}
+
+namespace RecoTarget
+{
+  /*! <ul>
+   *  <li> STRIDED: start + i * step (as before, step = 0 is an error)
+   *  <li> RANDOM: sampleSize entries chosen at random
+   *  <li> STRATIFIED: each file gets share proportional to its size
+   *  (largest remainder), entries within file chosen at random
+   *  <li> ALL: every entry with proper parity
+   *  </ul>
+   */
+  std::vector <unsigned int> planSelection
+    (const Selection &selection,
+     const std::vector <unsigned int> &fileOffsets,
+     const unsigned int &sampleSize,
+     const bool &isTesting,
+     const unsigned int &seed)
+  {
+    const unsigned int nEntries = fileOffsets.back();
+    const unsigned int available = nAvailable (nEntries, isTesting);
+    
+    std::vector <unsigned int> entries;
+    
+    std::mt19937 generator (seed);
+    
+    switch (selection)
+    {
+      case STRIDED:
+      {
+        // step for events loop (must be even, because it will take
+        // even events for testing sample and odd event for learning)
+        const unsigned int step =
+          sampleSize > 0 ? (nEntries / sampleSize / 2) * 2 : 0;
+          
+        if (step == 0) checkAvailable (sampleSize, nEntries / 2);
+        
+        for (unsigned int i = 0; i < sampleSize; i++)
+          entries.push_back ((isTesting ? 1 : 0) + i * step);
+          
+        break;
+      }
+      case RANDOM:
+        checkAvailable (sampleSize, available);
+        selectRandom (0, nEntries, isTesting, sampleSize, generator,
+                      entries);
+        break;
+      case STRATIFIED:
+      {
+        checkAvailable (sampleSize, available);
+        
+        const size_t nFiles = fileOffsets.size() - 1;
+        
+        std::vector <unsigned int> quota (nFiles);
+        std::vector < std::pair <uint64_t, size_t> > remainders;
+        
+        unsigned int nAssigned = 0;
+        
+        for (size_t f = 0; f < nFiles; f++)
+        {
+          // entries with proper parity in this file
+          const unsigned int inFile =
+            nAvailable (fileOffsets[f + 1], isTesting) -
+            nAvailable (fileOffsets[f], isTesting);
+          
+          const uint64_t share = (uint64_t) sampleSize * inFile;
+          
+          quota[f] = share / available;
+          nAssigned += quota[f];
+          
+          // files with the largest remainder get one more (if possible)
+          if (quota[f] < inFile)
+            remainders.push_back (std::make_pair (share % available, f));
+        }
+        
+        std::stable_sort (remainders.begin(), remainders.end(),
+          [] (const std::pair <uint64_t, size_t> &a,
+              const std::pair <uint64_t, size_t> &b)
+          { return a.first > b.first; });
+        
+        for (size_t r = 0; nAssigned < sampleSize; r++, nAssigned++)
+          quota[remainders[r].second]++;
+          
+        for (size_t f = 0; f < nFiles; f++)
+          selectRandom (fileOffsets[f], fileOffsets[f + 1], isTesting,
+                        quota[f], generator, entries);
+                        
+        break;
+      }
+      case ALL:
+        for (unsigned int entry = isTesting ? 1 : 0; entry < nEntries;
+             entry += 2)
+          entries.push_back (entry);
+          
+        break;
+      default:
+        throw Exception (BAD_ARGUMENT, "undefined selection");
+    }
+    
+    return entries;
+  }
+}
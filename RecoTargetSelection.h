@@ -0,0 +1,40 @@
+/**
+ * @brief Strategies of choosing events for samples
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_SELECTION_H
+#define RECO_TARGET_SELECTION_H
+
+#include <vector>
+
+namespace RecoTarget
+{
+  const unsigned int nSelections = 4; //!< number of implemented selections
+  extern const char *listOfSelections[]; //!< list of selections
+  //! selections enumerator
+  enum Selection {STRIDED, RANDOM, STRATIFIED, ALL};
+  
+  /*! return sorted list of entries for a sample
+   *  <ul>
+   *  <li> testing samples use odd entries, learning samples even ones
+   *  <li> fileOffsets = first entry of each file + total (nFiles + 1)
+   *  <li> sampleSize is ignored for ALL
+   *  </ul>
+   */
+  std::vector <unsigned int> planSelection
+    (const Selection &selection,
+     const std::vector <unsigned int> &fileOffsets,
+     const unsigned int &sampleSize,
+     const bool &isTesting,
+     const unsigned int &seed = 0);
+  
+  //! return the number of entries available for testing or learning
+  unsigned int nAvailable (const unsigned int &nEntries,
+                           const bool &isTesting);
+}
+
+#endif
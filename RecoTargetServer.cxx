@@ -0,0 +1,250 @@
+#include "RecoTargetServer.h"
+#include "RecoTargetGeometry.h"
+#include "RecoTargetUtils.h"
+#include "RecoTargetException.h"
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+using namespace RecoTarget;
+
+namespace
+{
+  const char *blanks = " \t\r"; //!< separators within line
+}
+
+//! micro-batch takes features, region and precision of learning
+//! samples once (retiring samples keeps them)
+RecoTargetServer :: RecoTargetServer
+  (RecoTargetSampleHandler **learningSamples,
+   const RecoTargetUserOptions &userOptions,
+   RecoTargetScheduler &scheduler)
+  : learningSamples (learningSamples), userOptions (userOptions),
+    scheduler (scheduler), batch (0), head (0), isEnd (false)
+{
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    stores[i] = NULL;
+    isMissing[i] = false;
+  }
+  
+  batch.useFeatures (userOptions.getFlagFeatures());
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (learningSamples[i])
+    {
+      batch.useRegion (learningSamples[i]->getRegion());
+      break;
+    }
+  
+  batch.quantize ((Precision) userOptions.getPrecision());
+}
+
+RecoTargetServer :: ~RecoTargetServer ()
+{
+  for (unsigned int i = 0; i < nTargets; i++) delete stores[i];
+}
+
+/*! <ul>
+ *  <li> wait for the first line of micro-batch
+ *  <li> add lines which are already there, up to servedBatch events
+ *  <li> classify micro-batch and write its predictions
+ *  </ul>
+ *  blank lines are skipped (they are not events)
+ */
+uint64_t RecoTargetServer :: run (const int &input, std::ostream &out,
+                                  const bool &binary)
+{
+  uint64_t nEvents = 0;
+  
+  std::string line;
+  
+  while (readLine (input, line, true))
+  {
+    do
+    {
+      if (line.find_first_not_of (blanks) == std::string::npos) continue;
+      
+      events.push_back (append (line) ? batch.getNSamples() - 1 : -1);
+    }
+    while (events.size() < servedBatch and readLine (input, line, false));
+    
+    if (events.empty()) continue;
+    
+    classify (nEvents, out, binary);
+    
+    nEvents += events.size();
+    events.clear();
+  }
+  
+  return nEvents;
+}
+
+/*! <ul>
+ *  <li> return a line if there is a whole one in buffer
+ *  <li> otherwise read more (without waiting, only if input is ready)
+ *  <li> at the end of input the rest of buffer is the last line
+ *  </ul>
+ */
+bool RecoTargetServer :: readLine (const int &input, std::string &line,
+                                   const bool &wait)
+{
+  size_t end;
+  
+  while ((end = buffer.find ('\n', head)) == std::string::npos and
+         not isEnd)
+  {
+    if (not wait)
+    {
+      pollfd request = {input, POLLIN, 0};
+      
+      if (poll (&request, 1, 0) <= 0) return false; // nothing there now
+    }
+    
+    char chunk[inputBuffer];
+    
+    const ssize_t n = read (input, chunk, sizeof (chunk));
+    
+    if (n < 0 and errno == EINTR) continue;
+    
+    if (n < 0)
+      throw Exception (BAD_FILE, "can not read served events");
+    
+    if (n == 0) isEnd = true;
+    else
+    {
+      // taken lines are dropped only now, not one by one
+      buffer.erase (0, head);
+      head = 0;
+      buffer.append (chunk, n);
+    }
+  }
+  
+  if (end == std::string::npos)
+  {
+    if (head >= buffer.size()) return false;
+    
+    end = buffer.size();
+  }
+  
+  line.assign (buffer, head, end - head);
+  head = end + 1;
+  
+  return true;
+}
+
+/*! <ul>
+ *  <li> no ':' in line: event id = target and entry of its event store
+ *  (opened when the first event of target comes; if it can not be
+ *  opened, events of target are not events and it is not tried again)
+ *  <li> otherwise: pairs of plane id and energy; id must be a known
+ *  plane (as decoded by planeOrder) and energy must not be negative
+ *  </ul>
+ */
+bool RecoTargetServer :: append (const std::string &line)
+{
+  const char *text = line.c_str();
+  char *next;
+  
+  planeIds.clear();
+  energy.clear();
+  
+  if (line.find (':') == std::string::npos)
+  {
+    const unsigned long target = strtoul (text, &next, 10);
+    const char *from = next;
+    const unsigned long entry = strtoul (from, &next, 10);
+    
+    if (from == text or next == from or next[strspn (next, blanks)] or
+        target < 1 or target > nTargets or not userOptions.getStorePath())
+      return false;
+    
+    RecoTargetEventStore *&store = stores[target - 1];
+    
+    if (isMissing[target - 1]) return false;
+    
+    if (not store)
+    {
+      try
+      {
+        store = loadEventStore (userOptions.getPath(),
+                                userOptions.getStorePath(), target - 1);
+      }
+      catch (const Exception &)
+      {
+        isMissing[target - 1] = true; // server goes on with other lines
+        return false;
+      }
+    }
+    
+    if (entry >= store->getNEntries()) return false;
+    
+    batch.appendSample (store->getEnergy (entry),
+                        store->getPlaneOrder (entry),
+                        store->getNHits (entry));
+    
+    return true;
+  }
+  
+  for (const char *c = text + strspn (text, blanks); *c;
+       c = next + strspn (next, blanks))
+  {
+    const long id = strtol (c, &next, 10);
+    
+    // unknown ids would go to plane 0 (planeOrder returns 0 for them)
+    if (next == c or *next != ':' or planeId (planeOrder (id)) != id)
+      return false;
+    
+    c = next + 1;
+    
+    energy.push_back (strtod (c, &next));
+    planeIds.push_back (id);
+    
+    if (next == c or not (energy.back() >= 0.0)) return false;
+  }
+  
+  batch.appendSample (energy.data(), planeIds.data(), planeIds.size());
+  
+  return true;
+}
+
+/*! <ul>
+ *  <li> fill kmax nearest neighbors of all samples of micro-batch at
+ *  once (scheduler splits them into blocks for threads)
+ *  <li> write prediction of each event in order, flush
+ *  <li> retire samples (their buffers are reused by the next batch)
+ *  </ul>
+ */
+void RecoTargetServer :: classify (const uint64_t &first, std::ostream &out,
+                                   const bool &binary)
+{
+  if (batch.getNSamples() > 0)
+    scheduler.fillNeighbors (&batch, learningSamples, userOptions);
+  
+  for (unsigned int e = 0; e < events.size(); e++)
+  {
+    Record record = {first + e, 0, 0.0f};
+    
+    if (events[e] >= 0)
+    {
+      double confidence = 0.0;
+      
+      record.target = 1 + batch.getPrediction
+        (events[e], userOptions.getNeighbors(),
+         (Vote) userOptions.getVote(), &confidence);
+      record.confidence = confidence;
+    }
+    
+    if (binary)
+      out.write ((const char*) &record, sizeof (record));
+    else
+      out << record.event << ' ' << record.target << ' '
+          << record.confidence << '\n';
+  }
+  
+  out.flush();
+  
+  batch.retireSamples (batch.getNSamples());
+}
@@ -0,0 +1,114 @@
+/**
+ * @brief Classification of events streamed through stdin or a pipe
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_SERVER_H
+#define RECO_TARGET_SERVER_H
+
+#include "RecoTargetSampleHandler.h"
+#include "RecoTargetUserOptions.h"
+#include "RecoTargetScheduler.h"
+#include "RecoTargetEventStore.h"
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+namespace RecoTarget
+{
+  const unsigned int servedBatch = 256; //!< the largest micro-batch
+  const unsigned int inputBuffer = 65536; //!< bytes read at once
+}
+
+/*! events are read line by line from input:
+ *  <ul>
+ *  <li> "target entry" - event id: entry of event store of target
+ *  (1 .. 5, as in target codes)
+ *  <li> "id:energy id:energy ..." - sparse hits: plane id and visible
+ *  energy of each hit plane (as in RecoTracks)
+ *  </ul>
+ *  lines which are already there (up to servedBatch) make a micro-batch:
+ *  it is classified at once by the scheduler (threads, blocks of
+ *  samples, quantized kernels, index) and its predictions are written
+ *  and flushed before the next line is waited for; so a lone event is
+ *  answered at once, and a fast producer gets full batches
+ * 
+ *  one prediction per event, in input order:
+ *  <ul>
+ *  <li> text: "event target confidence" (event counts from 0, target
+ *  is 1 .. 5, or 0 for a line which is not an event: wrong text,
+ *  unknown plane id, negative energy, entry or store which is missing)
+ *  <li> binary: Record of 16 bytes (native byte order)
+ *  </ul>
+ */
+class RecoTargetServer
+{
+  public:
+  
+  //! binary prediction record
+  struct Record
+  {
+    uint64_t event;   //!< number of event in input (from 0)
+    uint32_t target;  //!< predicted target (1 .. 5, 0 = wrong line)
+    float confidence; //!< winner's share of the vote
+  };
+  
+  //! constructor (learning samples must be loaded, quantized and
+  //! indexed as options say, and must not change while serving)
+  RecoTargetServer (RecoTargetSampleHandler **learningSamples,
+                    const RecoTargetUserOptions &userOptions,
+                    RecoTargetScheduler &scheduler);
+  ~RecoTargetServer (); //!< destructor (close event stores)
+  
+  //! classify events from input file descriptor until its end, write
+  //! predictions to out (binary: Records); return the number of events
+  uint64_t run (const int &input, std::ostream &out, const bool &binary);
+  
+  private:
+  
+  RecoTargetSampleHandler **learningSamples; //!< samples to compare with
+  const RecoTargetUserOptions &userOptions;  //!< metric, k, vote
+  RecoTargetScheduler &scheduler;            //!< fills neighbors
+  
+  //! event stores of targets (opened by the first event id, NULL =
+  //! not opened yet)
+  RecoTargetEventStore *stores[RecoTarget::nTargets];
+  
+  //! true if event store of target can not be opened
+  bool isMissing[RecoTarget::nTargets];
+  
+  RecoTargetSampleHandler batch; //!< samples of micro-batch
+  
+  //! sample of each event of micro-batch (-1 = line is not an event)
+  std::vector <int> events;
+  
+  std::string buffer; //!< input read but not parsed yet
+  size_t head;        //!< the first character of buffer not taken yet
+  bool isEnd;         //!< true if input is closed
+  
+  std::vector <int> planeIds;  //!< plane ids of appended hits
+  std::vector <double> energy; //!< energy of its hits
+  
+  //! server owns stores, so it can not be copied
+  RecoTargetServer (const RecoTargetServer &);
+  RecoTargetServer& operator= (const RecoTargetServer &);
+  
+  //! take the next line (wait = block until it comes); return false if
+  //! there is no line (yet, or at all)
+  bool readLine (const int &input, std::string &line, const bool &wait);
+  
+  //! append event of line to micro-batch; return false if line is not
+  //! an event
+  bool append (const std::string &line);
+  
+  //! classify micro-batch, write its predictions (first = number of
+  //! the first event), start a new one
+  void classify (const uint64_t &first, std::ostream &out,
+                 const bool &binary);
+};
+
+#endif
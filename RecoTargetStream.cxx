@@ -0,0 +1,47 @@
+#include "RecoTargetStream.h"
+#include <future>
+
+using namespace RecoTarget;
+
+RecoTargetStream :: RecoTargetStream (const unsigned int &nChunks,
+                                      const Reader &reader)
+  : nChunks (nChunks), reader (reader)
+{
+  for (unsigned int b = 0; b < nBuffers; b++)
+    for (unsigned int i = 0; i < nTargets; i++) buffers[b][i] = NULL;
+}
+
+RecoTargetStream :: ~RecoTargetStream ()
+{
+  for (unsigned int b = 0; b < nBuffers; b++)
+    for (unsigned int i = 0; i < nTargets; i++) delete buffers[b][i];
+}
+
+/*! <ul>
+ *  <li> read the first chunk, then for each chunk: start reading the
+ *  next one to the other buffer, use this one, wait for the reader
+ *  <li> if consumer fails, reader is still waited for (future of async
+ *  blocks in its destructor), so it does not write to freed buffers
+ *  </ul>
+ */
+void RecoTargetStream :: run (const Consumer &consumer)
+{
+  if (nChunks == 0) return;
+  
+  reader (buffers[0], 0);
+  
+  for (unsigned int c = 0; c < nChunks; c++)
+  {
+    RecoTargetSampleHandler **current = buffers[c % nBuffers];
+    
+    std::future <void> next; // reading of chunk c + 1 (if any)
+    
+    if (c + 1 < nChunks)
+      next = std::async (std::launch::async, reader,
+                         buffers[(c + 1) % nBuffers], c + 1);
+    
+    consumer (current);
+    
+    if (next.valid()) next.get();
+  }
+}
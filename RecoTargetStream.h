@@ -0,0 +1,74 @@
+/**
+ * @brief Out-of-core learning samples read chunk by chunk
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_STREAM_H
+#define RECO_TARGET_STREAM_H
+
+#include "RecoTargetSampleHandler.h"
+#include <functional>
+
+namespace RecoTarget
+{
+  //! chunks in memory at the same time (one used, one being read)
+  const unsigned int nBuffers = 2;
+}
+
+/*! learning samples which do not fit in memory are read in chunks:
+ *  <ul>
+ *  <li> chunk = contiguous block of planned entries of each learning
+ *  target (as a shard of ranks), ids are the same as in the whole
+ *  sample, so neighbors (ties included) do not depend on chunks
+ *  <li> double buffering: while consumer uses chunk c, a background
+ *  thread reads chunk c + 1 to the other buffer
+ *  <li> buffers are reused, so memory of two chunks is enough
+ *  </ul>
+ *  the first chunk is read by the caller (nothing to overlap with yet,
+ *  and a missing event store is converted by the thread using ROOT);
+ *  reader must touch only handlers it is given
+ */
+class RecoTargetStream
+{
+  public:
+  
+  //! fill handlers of all targets (NULL = create) with given chunk
+  typedef std::function <void (RecoTargetSampleHandler **learningSamples,
+                               const unsigned int &chunk)> Reader;
+  
+  //! use learning samples of one chunk
+  typedef std::function <void (RecoTargetSampleHandler **learningSamples)>
+    Consumer;
+  
+  //! constructor (nothing is read until run)
+  RecoTargetStream (const unsigned int &nChunks, const Reader &reader);
+  ~RecoTargetStream (); //!< destructor (delete buffers)
+  
+  //! read all chunks in order, pass each one to consumer while the next
+  //! one is read (rethrow the first error of reader or consumer)
+  void run (const Consumer &consumer);
+  
+  //! return the number of chunks
+  inline unsigned int getNChunks () const
+  {
+    return nChunks;
+  };
+  
+  private:
+  
+  unsigned int nChunks; //!< number of chunks
+  Reader reader;        //!< fills buffer with chunk
+  
+  //! learning samples of each target, per buffer (NULL = not used)
+  RecoTargetSampleHandler *buffers[RecoTarget::nBuffers]
+                                  [RecoTarget::nTargets];
+  
+  //! stream owns buffers, so it can not be copied
+  RecoTargetStream (const RecoTargetStream &);
+  RecoTargetStream& operator= (const RecoTargetStream &);
+};
+
+#endif
@@ -1,46 +1,100 @@
 #include "RecoTargetUserOptions.h"
 #include "RecoTargetMetrics.h"
+#include "RecoTargetVoting.h"
+#include "RecoTargetQuantization.h"
+#include "RecoTargetSelection.h"
+#include "RecoTargetFeatures.h"
+#include "RecoTargetReduction.h"
+#include "RecoTargetRegion.h"
+#include "RecoTargetException.h"
 #include <algorithm>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
 #include <getopt.h>
+#include <unistd.h>
 
 using namespace RecoTarget;
 using namespace std;
 
-/*! <ul>
- *  <li> parse command line arguments
- *  <li> check if all required arguments was passed 
- *  <li> set up RecoTargetUserOptions based on arguments
- *  <\ul>
- */ 
-RecoTargetUserOptions :: RecoTargetUserOptions (int argc, char **argv) : showSummary (false)
+namespace
 {
-  if (argc == 1) usage (); // return usage() if no arguments were passed
-  
   // short options triggers
-  static const char *shortOpts = "p:t:l:k:m:x:y:sh";
-  // long options triggers
-  static const struct option longOpts[]
+  const char *shortOpts =
+    "p:e:c:b:o:t:l:k:K:m:v:q:a:z:d:j:r:C:R:S:x:y:wfugniVBsh";
+  // long options triggers (also keys of batch file)
+  const struct option longOpts[]
   {
     {"path", required_argument, NULL, 'p'},
+    {"store", required_argument, NULL, 'e'},
+    {"cache", required_argument, NULL, 'c'},
+    {"batch", required_argument, NULL, 'b'},
+    {"reduced", required_argument, NULL, 'o'},
     {"ntesting", required_argument, NULL, 't'},
     {"nlearning", required_argument, NULL, 'l'},
     {"nneighbors", required_argument, NULL, 'k'},
+    {"kmax", required_argument, NULL, 'K'},
     {"metric", required_argument, NULL, 'm'},
+    {"vote", required_argument, NULL, 'v'},
+    {"precision", required_argument, NULL, 'q'},
+    {"selection", required_argument, NULL, 'a'},
+    {"reduction", required_argument, NULL, 'z'},
+    {"seed", required_argument, NULL, 'd'},
+    {"threads", required_argument, NULL, 'j'},
+    {"ranks", required_argument, NULL, 'r'},
+    {"chunk", required_argument, NULL, 'C'},
+    {"roi", required_argument, NULL, 'R'},
+    {"serve", required_argument, NULL, 'S'},
+    {"pipeline", no_argument, NULL, 'w'},
+    {"features", no_argument, NULL, 'f'},
+    {"compress", no_argument, NULL, 'u'},
+    {"kscan", no_argument, NULL, 'g'},
+    {"loo", no_argument, NULL, 'n'},
+    {"profile", no_argument, NULL, 'i'},
+    {"validate", no_argument, NULL, 'V'},
+    {"binary", no_argument, NULL, 'B'},
     {"ttargets", required_argument, NULL, 'x'},
     {"ltargets", required_argument, NULL, 'y'},
     {"summary", no_argument, NULL, 's'},
-    {"help", no_argument, NULL, 'h'}
+    {"help", no_argument, NULL, 'h'},
+    {NULL, 0, NULL, 0}
   };
+  
+  // options shared by all runs of a process (not allowed in sections)
+  const char *globalOpts = "cbjrCwiVSBs";
+  
+  // required options
+  const char *requiredOpts = "ptlkmxy";
+  
+  //! remove leading and trailing whitespaces
+  string trim (const string &text)
+  {
+    const size_t first = text.find_first_not_of (" \t\r");
+    
+    if (first == string::npos) return "";
+    
+    return text.substr (first, text.find_last_not_of (" \t\r") - first + 1);
+  }
+}
 
-  // flags for required arguments
-  bool isPathDefined            = false;
-  bool isTestingDefined         = false;
-  bool isLearningDefined        = false;
-  bool isNeighborsDefined       = false;
-  bool isMetricDefined          = false;
-  bool isTestingTargetsDefined  = false;
-  bool isLearningTargetsDefined = false;
+/*! <ul>
+ *  <li> parse command line arguments
+ *  <li> check if all required arguments was passed (batch file is
+ *  checked when runs are created)
+ *  <li> set up RecoTargetUserOptions based on arguments
+ *  <\ul>
+ */ 
+RecoTargetUserOptions :: RecoTargetUserOptions (int argc, char **argv)
+  : nTestingSamples (0), nLearningSamples (0), nNearestNeighbors (0),
+    nMaxNeighbors (0), idMetric (EUCLIDEAN), idVote (MAJORITY),
+    idPrecision (DOUBLE), idSelection (STRIDED), idReduction (FULL),
+    seed (0), nThreads (1), nRanks (1), nChunkSamples (0),
+    isPipeline (false), isFeatures (false), isCompressed (false),
+    isKScan (false), isProfile (false), isLoo (false), isValidate (false),
+    isBinary (false), showSummary (false)
+{
+  if (argc == 1) usage (); // return usage() if no arguments were passed
   
   // set initital values of targets flag to off
   fill_n (isTestingTarget, nTargets, false);
@@ -49,78 +103,447 @@ RecoTargetUserOptions :: RecoTargetUserOptions (int argc, char **argv) : showSum
   int o, id; // for get_opt (option and option index)
 
   while ((o = getopt_long (argc, argv, shortOpts, longOpts, &id)) != -1)
-    switch (o)
+    set (o, optarg);
+    
+  if (not pathToBatch.empty()) return;
+  
+  check();
+    
+  if (showSummary)
+  {
+    summary();
+    confirm();
+  }
+}
+
+//! flags are set by value = NULL (command line) or yes/no (batch file)
+void RecoTargetUserOptions :: set (const int option, const char *value)
+{
+  const bool isOn = not value or (strcmp (value, "no") and
+                                  strcmp (value, "false") and
+                                  strcmp (value, "0"));
+  switch (option)
+  {
+    case 'p':
+      pathToFiles = value;
+      break;
+    case 'e':
+      pathToStore = value;
+      break;
+    case 'c':
+      pathToCache = value;
+      break;
+    case 'b':
+      pathToBatch = value;
+      break;
+    case 'o':
+      pathToReduced = value;
+      break;
+    case 't':
+      nTestingSamples = atoi (value);
+      break;
+    case 'l':
+      nLearningSamples = atoi (value);
+      break;
+    case 'k':
     {
-      case 'p':
-        pathToFiles = optarg;
-        isPathDefined = true;
-        break;
-      case 't':
-        nTestingSamples = atoi (optarg);
-        isTestingDefined = true;
-        break;
-      case 'l':
-        nLearningSamples = atoi (optarg);
-        isLearningDefined = true;
-        break;
-      case 'k':
-        nNearestNeighbors = atoi (optarg);
-        isNeighborsDefined = true;
-        break;
-      case 'm':
-        idMetric = atoi (optarg);
-        isMetricDefined = true;
-        break;
-      case 'x':
-        codeToFlags (atoi (optarg), isTestingTarget);
-        isTestingTargetsDefined = true;
-        break;
-      case 'y':
-        codeToFlags (atoi (optarg), isLearningTarget);
-        isLearningTargetsDefined = true;
-        break;
-      case 's':
-        showSummary = true;
-        break;
-      case 'h':
-        usage();
-        break;
-      case '?':
-        if (optopt == 'c' or isprint (optopt)) usage();
-      default:
-        usage();
+      // comma separated list, one run per k
+      listOfNeighbors.clear();
+      
+      for (const char *k = value; *k;)
+      {
+        char *next;
+        listOfNeighbors.push_back (strtoul (k, &next, 10));
+        
+        if (next == k) usage ("Wrong number of nearest neighbors.");
+        
+        k = next + strspn (next, ", ");
+      }
+      
+      if (listOfNeighbors.empty())
+        usage ("Wrong number of nearest neighbors.");
+        
+      nNearestNeighbors = listOfNeighbors[0];
+      break;
     }
+    case 'K':
+      nMaxNeighbors = atoi (value);
+      break;
+    case 'm':
+      idMetric = atoi (value);
+      break;
+    case 'v':
+      idVote = atoi (value);
+      break;
+    case 'q':
+      idPrecision = atoi (value);
+      break;
+    case 'a':
+      idSelection = atoi (value);
+      break;
+    case 'z':
+      idReduction = atoi (value);
+      break;
+    case 'd':
+      seed = strtoul (value, NULL, 10);
+      break;
+    case 'j':
+      nThreads = atoi (value);
+      break;
+    case 'r':
+      nRanks = atoi (value);
+      break;
+    case 'C':
+      nChunkSamples = atoi (value);
+      break;
+    case 'R':
+      region = value;
+      break;
+    case 'S':
+      pathToServe = value;
+      break;
+    case 'x':
+      codeToFlags (value, isTestingTarget);
+      break;
+    case 'y':
+      codeToFlags (value, isLearningTarget);
+      break;
+    case 'w':
+      isPipeline = isOn;
+      break;
+    case 'f':
+      isFeatures = isOn;
+      break;
+    case 'u':
+      isCompressed = isOn;
+      break;
+    case 'g':
+      isKScan = isOn;
+      break;
+    case 'i':
+      isProfile = isOn;
+      break;
+    case 'n':
+      isLoo = isOn;
+      break;
+    case 'V':
+      isValidate = isOn;
+      break;
+    case 'B':
+      isBinary = isOn;
+      break;
+    case 's':
+      showSummary = isOn;
+      break;
+    case 'h':
+      usage();
+      break;
+    case '?':
+    default:
+      usage();
+  }
+  
+  definedOptions += option;
+}
+
+/*! <ul>
+ *  <li> key = value per line, '#' starts a comment
+ *  <li> keys are long names of command line options
+ *  <li> options shared by all runs are allowed only in global part
+ *  </ul>
+ */
+void RecoTargetUserOptions :: set (const vector <string> &lines,
+                                   const bool isGlobal)
+{
+  for (unsigned int l = 0; l < lines.size(); l++)
+  {
+    const string line = trim (lines[l].substr (0, lines[l].find ('#')));
+    
+    if (line.empty()) continue;
+    
+    const size_t equal = line.find ('=');
+    const string key = trim (line.substr (0, equal));
+    const string value =
+      equal == string::npos ? "" : trim (line.substr (equal + 1));
+    
+    const struct option *o = longOpts;
     
-  if (!isPathDefined)
-    usage ("The path was not defined.");
-  if (!isTestingDefined)
-    usage ("The size of a testing sample was not defined.");
-  if (!isLearningDefined)
-    usage ("The size of a learning samples was not defined.");
-  if (!isNeighborsDefined)
-    usage ("The number of nearest neighbors was not defined.");
-  if (!isMetricDefined)
-    usage ("The metric was not defined.");
+    while (o->name and key != o->name) o++;
+    
+    if (not o->name or o->val == 'b' or o->val == 'h')
+      throw Exception (BAD_FILE, pathToBatch + ": unknown key '" + key + "'");
+    
+    if (not isGlobal and strchr (globalOpts, o->val))
+      throw Exception (BAD_FILE, pathToBatch + ": '" + key + "' is shared "
+                       "by all runs, set it before the first section");
+    
+    if (value.empty() and o->has_arg == required_argument)
+      throw Exception (BAD_FILE, pathToBatch + ": no value of '" + key +
+                       "'");
+                       
+    set (o->val, value.empty() ? NULL : value.c_str());
+  }
+}
+
+//! print usage if required option is missing or any is wrong
+void RecoTargetUserOptions :: check ()
+{
+  const string missing[] =
+  {
+    "The path was not defined.",
+    "The size of a testing sample was not defined.",
+    "The size of a learning samples was not defined.",
+    "The number of nearest neighbors was not defined.",
+    "The metric was not defined.",
+    "The list of testing targets was not defined.",
+    "The list of learning targets was not defined."
+  };
+  
+  for (unsigned int i = 0; requiredOpts[i]; i++)
+    if (definedOptions.find (requiredOpts[i]) == string::npos and
+        // validation generates events and checks all metrics
+        not (isValidate and strchr ("pm", requiredOpts[i])) and
+        // leave-one-out classifies learning samples
+        not (isLoo and requiredOpts[i] == 't') and
+        // served events come from input
+        not (not pathToServe.empty() and strchr ("tx", requiredOpts[i])))
+      usage (missing[i].c_str());
+  
+  if (find (listOfNeighbors.begin(), listOfNeighbors.end(), 0u) !=
+      listOfNeighbors.end())
+    usage ("At least one nearest neighbor is needed.");
   if (idMetric >= nMetrics)
     usage ("Undefined metric.");
-  if (!isTestingTargetsDefined)
-    usage ("The list of testing targets was not defined.");
-  if (!isLearningTargetsDefined)
-    usage ("The list of learning targets was not defined.");
+  if (idVote >= nVotes)
+    usage ("Undefined vote.");
+  if (idPrecision >= nPrecisions)
+    usage ("Undefined precision.");
+  if (idSelection >= nSelections)
+    usage ("Undefined selection.");
+  if (idReduction >= nReductions)
+    usage ("Undefined reduction.");
+  if (nThreads == 0)
+    usage ("At least one thread is needed.");
+  if (isFeatures and idPrecision != DOUBLE)
+    usage ("Features are not normalized, so they can not be quantized.");
+  if (isPipeline and not pathToBatch.empty())
+    usage ("Pipeline can not be used with batch file.");
+  if (isPipeline and (idReduction != FULL or not pathToReduced.empty()))
+    usage ("Pipeline can not be used with reduced learning set.");
+  if (nRanks != 1 and (idReduction != FULL or not pathToReduced.empty()))
+    usage ("Learning set is reduced and saved only by a single process "
+           "(each rank would reduce its own shard).");
+  if (isLoo and (isPipeline or nRanks != 1))
+    usage ("Leave-one-out needs all learning samples in one process.");
+  if (isLoo and (idReduction != FULL or not pathToReduced.empty()))
+    usage ("Leave-one-out can not be used with reduced learning set.");
+  
+  if (nChunkSamples > 0 and pathToStore.empty())
+    usage ("Learning samples are read in chunks only from event store.");
+  if (nChunkSamples > 0 and (isPipeline or isLoo))
+    usage ("Learning samples read in chunks can not be used with "
+           "pipeline or leave-one-out.");
+  if (nChunkSamples > 0 and (idReduction != FULL or
+                             not pathToReduced.empty()))
+    usage ("Learning samples read in chunks can not be reduced.");
+  
+  if (not pathToServe.empty() and
+      (not pathToBatch.empty() or isPipeline or isLoo or isValidate or
+       isProfile))
+    usage ("Serving is a single run of its own (no batch file, pipeline, "
+           "leave-one-out, validation or profile).");
+  if (not pathToServe.empty() and (nRanks != 1 or nChunkSamples > 0))
+    usage ("Serving needs all learning samples in one process.");
+  if (not pathToServe.empty() and (idReduction != FULL or
+                                   not pathToReduced.empty()))
+    usage ("Served events are classified with full learning set.");
+  if (isBinary and pathToServe.empty())
+    usage ("Binary records are written only for served events.");
+  
+#ifndef RECO_TARGET_VERSION
+  // cache key needs code version, or results of old code are read
+  if (not pathToCache.empty())
+    usage ("Cache needs code version (build with -DRECO_TARGET_VERSION, "
+           "see RecoTargetCache.h).");
+#endif
+  
+  if (not region.empty())
+  {
+    bool isAuto = false; // planes are chosen from learning samples
     
-  if (showSummary) summary();
+    try
+    {
+      isAuto = RecoTargetRegion (region).isAuto();
+    }
+    catch (const Exception &)
+    {
+      usage ("Wrong region of interest.");
+    }
+    
+    if (isAuto and (nRanks != 1 or nChunkSamples > 0))
+      usage ("Region chosen by importance needs all learning samples "
+             "in one process.");
+  }
+  if (not region.empty() and isFeatures)
+    usage ("Region of interest selects planes, so it can not be used "
+           "with features.");
+  if (not region.empty() and not pathToReduced.empty())
+    usage ("Reduced learning set is saved with all planes, so it can not "
+           "be used with region of interest.");
+  
+  for (unsigned int i = 0; i < nTargets and isLoo; i++)
+    if (isTestingTarget[i] and not isLearningTarget[i])
+      usage ("Leave-one-out classifies learning samples, so testing "
+             "targets must be learning targets too.");
 }
 
-//! print all available options with explanations
-void RecoTargetUserOptions :: usage (const char *error)
+/*! <ul>
+ *  <li> batch file: global part (before the first [section]) applies
+ *  to all runs, each [section] is a run on top of it (or the global
+ *  part alone, if there are no sections)
+ *  <li> each run is repeated for each k on its list
+ *  </ul>
+ */
+vector <RecoTargetUserOptions> RecoTargetUserOptions :: getRuns () const
 {
-  if (error[0] != '\0') cerr << "\nERROR: " << error << "\n";
+  vector <RecoTargetUserOptions> sections;
+  
+  if (pathToBatch.empty())
+    sections.push_back (*this);
+  else
+  {
+    ifstream file (pathToBatch.c_str());
+    
+    if (not file)
+      throw Exception (BAD_FILE, "can not open " + pathToBatch);
+    
+    vector <string> global;
+    vector <string> names;
+    vector < vector <string> > lines;
+    
+    string line;
+    
+    while (getline (file, line))
+    {
+      const string text = trim (line);
+      
+      if (text.size() > 1 and text[0] == '[' and text[text.size()-1] == ']')
+      {
+        names.push_back (trim (text.substr (1, text.size() - 2)));
+        lines.push_back (vector <string> ());
+      }
+      else if (names.empty()) global.push_back (line);
+      else lines.back().push_back (line);
+    }
+    
+    RecoTargetUserOptions base (*this);
+    base.set (global, true);
+    
+    if (names.empty()) sections.push_back (base);
+    
+    for (unsigned int i = 0; i < names.size(); i++)
+    {
+      sections.push_back (base);
+      sections.back().name = names[i];
+      sections.back().set (lines[i], false);
+    }
+  }
+  
+  vector <RecoTargetUserOptions> runs;
   
+  for (unsigned int i = 0; i < sections.size(); i++)
+  {
+    RecoTargetUserOptions &section = sections[i];
+    
+    if (not pathToBatch.empty()) section.check();
+    
+    for (unsigned int k = 0; k < section.listOfNeighbors.size(); k++)
+    {
+      runs.push_back (section);
+      
+      RecoTargetUserOptions &run = runs.back();
+      
+      run.nNearestNeighbors = section.listOfNeighbors[k];
+      run.listOfNeighbors.assign (1, run.nNearestNeighbors);
+      
+      if (section.listOfNeighbors.size() > 1)
+      {
+        ostringstream name;
+        name << section.name << (section.name.empty() ? "" : " ")
+             << "k = " << run.nNearestNeighbors;
+        run.name = name.str();
+      }
+    }
+  }
+  
+  if (runs.empty()) throw Exception (BAD_FILE, pathToBatch + ": no runs");
+  
+  if (not pathToBatch.empty() and showSummary)
+  {
+    for (unsigned int i = 0; i < runs.size(); i++) runs[i].summary();
+    confirm();
+  }
+  
+  return runs;
+}
+
+//! union of targets, the largest kmax
+void RecoTargetUserOptions :: merge (const RecoTargetUserOptions &other)
+{
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    isTestingTarget[i] = isTestingTarget[i] or other.isTestingTarget[i];
+    isLearningTarget[i] = isLearningTarget[i] or other.isLearningTarget[i];
+  }
+  
+  nMaxNeighbors = max (getMaxNeighbors(), other.getMaxNeighbors());
+}
+
+//! everything which goes into loaded (and converted) samples
+bool RecoTargetUserOptions :: isSameSamples
+  (const RecoTargetUserOptions &other) const
+{
+  return pathToFiles == other.pathToFiles and
+         pathToStore == other.pathToStore and
+         nTestingSamples == other.nTestingSamples and
+         nLearningSamples == other.nLearningSamples and
+         idSelection == other.idSelection and seed == other.seed and
+         idPrecision == other.idPrecision and
+         isFeatures == other.isFeatures and
+         isCompressed == other.isCompressed and
+         region == other.region and
+         isLoo == other.isLoo and
+         idReduction == other.idReduction and
+         pathToReduced == other.pathToReduced and
+         // reduction finds neighbors with run's metric
+         (idReduction == FULL or idMetric == other.idMetric);
+}
+
+//! neighbors depend also on metric and targets to learn from
+bool RecoTargetUserOptions :: isSameNeighbors
+  (const RecoTargetUserOptions &other) const
+{
+  return isSameSamples (other) and idMetric == other.idMetric and
+         equal (isLearningTarget, isLearningTarget + nTargets,
+                other.isLearningTarget);
+}
+
+//! print all available options with explanations and throw BAD_USAGE
+void RecoTargetUserOptions :: usage (const char *error)
+{
   cout << "\n########## USAGE ##########\n";
   
   cout << "\nUsage: ./RecoTarget [options]:\n\n";
   cout << "\t -p, --path       "
        << "\t [path_to_samples] (see example below)\n";
+  cout << "\t -e, --store      "
+       << "\t [path_to_event_store] (optional, see below)\n";
+  cout << "\t -c, --cache      "
+       << "\t [path_to_cache] (optional, see below)\n";
+  cout << "\t -b, --batch      "
+       << "\t [batch_file] (optional, see below)\n";
+  cout << "\t -o, --reduced    "
+       << "\t [reduced_learning_set_file] (optional, see below)\n";
   cout << "\t -t, --ntesting   "
        << "\t [size of a testing sample]\n";
   cout << "\t -l, --nlearning  "
@@ -130,9 +553,59 @@ void RecoTargetUserOptions :: usage (const char *error)
   cout << "\t -y, --ltargets   "
        << "\t [testing target code] (see examples below)\n";
   cout << "\t -k, --nneighbors "
-       << "\t [number of nearest neighbors]\n";
+       << "\t [number of nearest neighbors] (or list, e.g. 1,5,10)\n";
+  cout << "\t -K, --kmax       "
+       << "\t [number of nearest neighbors to keep] (optional, k by "
+       << "default)\n";
   cout << "\t -m, --metric     "
        << "\t [metric] (see the options below)\n";
+  cout << "\t -v, --vote       "
+       << "\t [vote] (optional, majority by default)\n";
+  cout << "\t -q, --precision  "
+       << "\t [precision] (optional, double by default)\n";
+  cout << "\t -a, --selection  "
+       << "\t [selection of entries] (optional, every n-th by default)\n";
+  cout << "\t -z, --reduction  "
+       << "\t [reduction of learning samples] (optional, none by "
+       << "default)\n";
+  cout << "\t -d, --seed       "
+       << "\t [seed for random selections] (optional, 0 by default)\n";
+  cout << "\t -j, --threads    "
+       << "\t [number of threads computing distances] (optional, 1 by"
+       << " default)\n";
+  cout << "\t -w, --pipeline   "
+       << "\t (classify testing events while they are being read)\n";
+  cout << "\t -g, --kscan      "
+       << "\t (print scores and margins for every k up to kmax, and "
+       << "confusion matrix)\n";
+  cout << "\t -n, --loo        "
+       << "\t (leave-one-out: classify each learning sample by the other "
+       << "ones, -t is not needed)\n";
+  cout << "\t -i, --profile    "
+       << "\t (count cycles, instructions, cache and branch misses per "
+       << "event and distance)\n";
+  cout << "\t -V, --validate   "
+       << "\t (compare all engines and metrics to reference on "
+       << "synthetic events, see below)\n";
+  cout << "\t -f, --features   "
+       << "\t (use " << nFeatures << " profile features instead of "
+       << nPlanes << " planes)\n";
+  cout << "\t -u, --compress   "
+       << "\t (keep only non-zero window of planes of testing events)\n";
+  cout << "\t -r, --ranks      "
+       << "\t [number of processes sharing learning samples]"
+       << " (optional, 0 = MPI ranks)\n";
+  cout << "\t -C, --chunk      "
+       << "\t [learning samples per target read at once] (optional, "
+       << "see below)\n";
+  cout << "\t -R, --roi        "
+       << "\t [region of interest] (optional, all planes by default, "
+       << "see below)\n";
+  cout << "\t -S, --serve      "
+       << "\t [input of events to classify] (optional, - = stdin, see "
+       << "below)\n";
+  cout << "\t -B, --binary     "
+       << "\t (write served predictions as binary records)\n";
   cout << "\t -s, --summary    "
        << "\t (use to see your options summary)\n";
   cout << "\t -h, --help       "
@@ -146,12 +619,108 @@ void RecoTargetUserOptions :: usage (const char *error)
   
   cout << "\nThe following convention is assumed: "
        << "path/00/00/00/0X -> files for target X\n";
+  
+  cout << "\nWith --store ana files are converted once to "
+       << "store/target0X.store and events are read from there\n";
+            
+  cout << "\nWith --cache top-kmax neighbors are saved in cache "
+       << "directory; a rerun with the same input files and options\n"
+       << "(any k <= kmax, any vote) reads them instead of computing\n"
+       << "(only if code version was set when building, see "
+       << "RecoTargetCache.h)\n";
+            
+  cout << "\n########## BATCH ##########\n";
+  
+  cout << "\nBatch file describes many runs done by one process; "
+       << "runs with the same samples load them once,\n"
+       << "runs with the same samples, metric and learning targets "
+       << "share distances (k, vote, testing targets may differ):\n\n";
+  cout << "\t # command line and lines before the first section apply "
+       << "to all runs\n";
+  cout << "\t path = /minerva/data/...\n";
+  cout << "\t ntesting = 1000\n";
+  cout << "\t nlearning = 10000\n";
+  cout << "\t ltargets = 1,2,3,4,5\n";
+  cout << "\t threads = 8\n\n";
+  cout << "\t [euclidean]\n";
+  cout << "\t metric = 0\n";
+  cout << "\t ttargets = 1,2,3,4,5\n";
+  cout << "\t nneighbors = 1, 5, 10\n\n";
+  cout << "\t [cosine with features]\n";
+  cout << "\t metric = 2\n";
+  cout << "\t features = yes\n";
+  cout << "\t ttargets = 4,5\n";
+  cout << "\t nneighbors = 10\n";
+  
+  cout << "\nThreads, ranks, chunk, cache and summary are shared by all "
+       << "runs (pipeline is not available)\n";
+  
+  cout << "\n########## OUT-OF-CORE ##########\n";
+  
+  cout << "\nWith --chunk learning samples do not have to fit in memory: "
+       << "they are read from event store chunk\n"
+       << "by chunk (the next one is read while distances to this one are "
+       << "computed), testing samples stay\n"
+       << "in memory; each run (and double precision pass) reads all "
+       << "chunks again, e.g.:\n\n";
+  cout << "\t ./RecoTarget -p ... -e store -t 1000 -l 1000000 -C 100000 "
+       << "-k 5 -m 0 -x 12345 -y 12345\n";
+  
+  cout << "\n########## SERVING ##########\n";
+  
+  cout << "\nWith --serve learning samples are loaded once, then events "
+       << "are read from input (stdin or named\n"
+       << "pipe) line by line: \"target entry\" (event store entry, "
+       << "needs --store) or \"id:energy ...\" (hits);\n"
+       << "lines already there make a micro-batch, its predictions "
+       << "(\"event target confidence\", or 16-byte\n"
+       << "records with --binary) are written to stdout as soon as it "
+       << "is classified (-t and -x are not needed):\n\n";
+  cout << "\t ./select_events | ./RecoTarget -p ... -e store -l 10000 "
+       << "-k 5 -m 0 -y 12345 -S - | ...\n";
+  
+  cout << "\n########## LEAVE-ONE-OUT ##########\n";
+  
+  cout << "\nWith --loo samples of testing targets are taken from "
+       << "learning samples, each one gets neighbors from\n"
+       << "all the others; every distance is computed once for both "
+       << "samples (half of the work)\n";
+  
+  cout << "\n########## VALIDATION ##########\n";
+  
+  cout << "\nWith --validate no files are read (path and metric are not "
+       << "needed): events of selected targets are\n"
+       << "generated from the seed, neighbors found by each engine with "
+       << "each metric are compared to the sorted\n"
+       << "list of all distances; exit code is 7 if any check fails, "
+       << "e.g.:\n\n";
+  cout << "\t ./RecoTarget -V -t 50 -l 500 -k 5 -K 10 -x 12345 "
+       << "-y 12345 -j 4\n";
+  
+  cout << "\n########## FEATURES ##########\n";
+  
+  cout << "\nWith --features each event is described by energy-weighted "
+       << "mean z, RMS, skew, z of the first and the last hit plane,\n"
+       << "energy fractions in detector regions (split by targets, "
+       << "ECAL, HCAL) and in the modules next to each target\n";
             
+  cout << "\n########## REGION OF INTEREST ##########\n";
+  
+  cout << "\nWith --roi distances use only chosen planes (kept next to "
+       << "each other, so fewer of them are compared):\n\n";
+  cout << "\t -R 4000:6000,8600:9100 \t (planes with z in [4000, 6000) "
+       << "or [8600, 9100) mm)\n";
+  cout << "\t -R targets:300 \t (planes within 300 mm of any target, "
+       << regionHalfWidth << " by default)\n";
+  cout << "\t -R auto:50      \t (50 planes which separate learning "
+       << "targets best, " << regionPlanes << " by default)\n";
+  
   cout << "\n########## TARGETS ##########\n";          
             
   cout << "\nTarget code examples:\n\n";
   cout << "\t x -t 145  \t (proceed targets 1, 4, 5)\n";
   cout << "\t y -t 2514 \t (learn from targets 1, 2, 4, 5)\n";
+  cout << "\t y -t 1,2,5 \t (learn from targets 1, 2, 5)\n";
   
   cout << "\n########## METRICS ##########\n";
   
@@ -159,24 +728,87 @@ void RecoTargetUserOptions :: usage (const char *error)
   
   for (unsigned int i = 0; i < nMetrics; i++)
     cout << "\t" << i << " - " << listOfMetrics[i] << "\n";
+  
+  cout << "\n########## VOTES ##########\n";
+  
+  cout << "\nAvailable votes:\n\n";
+  
+  for (unsigned int i = 0; i < nVotes; i++)
+    cout << "\t" << i << " - " << listOfVotes[i] << "\n";
+  
+  cout << "\n########## PRECISIONS ##########\n";
+  
+  cout << "\nAvailable precisions (scores are compared to double):\n\n";
+  
+  for (unsigned int i = 0; i < nPrecisions; i++)
+    cout << "\t" << i << " - " << listOfPrecisions[i] << "\n";
+  
+  cout << "\nQuantized copy is kept next to double samples (they are "
+       << "needed for the double pass), so it\n"
+       << "makes distances faster, not memory smaller; only --serve "
+       << "frees double learning samples;\n"
+       << "the copy is dense, also for --compress (which shrinks only "
+       << "double testing samples)\n";
+    
+  cout << "\n########## SELECTIONS ##########\n";
+  
+  cout << "\nAvailable selections (odd entries are used for testing, "
+       << "even for learning):\n\n";
+  
+  for (unsigned int i = 0; i < nSelections; i++)
+    cout << "\t" << i << " - " << listOfSelections[i] << "\n";
+    
+  cout << "\nThe same seed gives the same samples; with 'All entries' "
+       << "sizes of samples are ignored\n";
+    
+  cout << "\n########## REDUCTIONS ##########\n";
+  
+  cout << "\nAvailable reductions of learning samples (scores are "
+       << "compared to full learning set):\n\n";
+  
+  for (unsigned int i = 0; i < nReductions; i++)
+    cout << "\t" << i << " - " << listOfReductions[i] << "\n";
+    
+  cout << "\nWith --reduced reduced learning set is saved to given file; "
+       << "if the file exists, learning samples\n"
+       << "are read from it instead (and not reduced again)\n";
     
   cout << "\n";
   
-  exit (1);
+  throw Exception (BAD_USAGE, error);
 }
 
-//! print options chosen by user and ask if program should continue
-void RecoTargetUserOptions :: summary ()
+//! print options chosen by user
+void RecoTargetUserOptions :: summary () const
 {
-  cout << "\nThis is your setup:\n\n";
+  cout << "\nThis is your setup";
+  
+  if (not name.empty()) cout << " (\033[1m" << name << "\033[0m)";
+  
+  cout << ":\n\n";
   cout << "The path to ana files: \033[1m"
        << pathToFiles << "\033[0m\n";
+  
+  if (not pathToStore.empty())
+    cout << "The path to event store: \033[1m"
+         << pathToStore << "\033[0m\n";
+  
+  if (not pathToCache.empty())
+    cout << "The path to cache: \033[1m"
+         << pathToCache << "\033[0m\n";
+  
   cout << "The size of your testing sample = \033[1m"
        << nTestingSamples << "\033[0m\n";
   cout << "The size of your learning sample = \033[1m"
        << nLearningSamples << "\033[0m\n";
-  cout << "The number of nearest neighbors = \033[1m"
-       << nNearestNeighbors << "\033[0m\n";
+  cout << "The number of nearest neighbors = \033[1m";
+  
+  for (unsigned int i = 0; i < listOfNeighbors.size(); i++)
+    cout << listOfNeighbors[i] << " ";
+    
+  cout << "\033[0m\n";
+  cout << "The number of neighbors kept = \033[1m"
+       << getMaxNeighbors() << "\033[0m\n";
   cout << "Targets to proceed: \033[1m";
   
   for (unsigned int i = 0; i < 5; i++)
@@ -189,25 +821,83 @@ void RecoTargetUserOptions :: summary ()
     
   cout << "\n\033[0mYour metric: \033[1m"
        << listOfMetrics[idMetric] << "\033[0m\n";
+  cout << "Your vote: \033[1m"
+       << listOfVotes[idVote] << "\033[0m\n";
+  cout << "Your precision: \033[1m"
+       << listOfPrecisions[idPrecision] << "\033[0m\n";
+  cout << "Your selection: \033[1m"
+       << listOfSelections[idSelection] << "\033[0m\n";
+  cout << "Your reduction: \033[1m"
+       << listOfReductions[idReduction] << "\033[0m\n";
+  
+  if (not pathToReduced.empty())
+    cout << "The path to reduced learning set: \033[1m"
+         << pathToReduced << "\033[0m\n";
+  
+  if (idSelection == RANDOM or idSelection == STRATIFIED)
+    cout << "The seed = \033[1m" << seed << "\033[0m\n";
   
-  char answer;
+  cout << "The number of worker threads = \033[1m"
+       << nThreads << "\033[0m\n";
+  cout << "Classify while reading: \033[1m"
+       << (isPipeline ? "yes" : "no") << "\033[0m\n";
+  
+  if (nChunkSamples > 0)
+    cout << "Learning samples per chunk = \033[1m"
+         << nChunkSamples << "\033[0m\n";
+  cout << "Scores for every k: \033[1m"
+       << (isKScan ? "yes" : "no") << "\033[0m\n";
+  cout << "Hardware counters: \033[1m"
+       << (isProfile ? "yes" : "no") << "\033[0m\n";
+  if (not pathToServe.empty())
+    cout << "Served events from: \033[1m" << pathToServe
+         << (isBinary ? " (binary predictions)" : "") << "\033[0m\n";
+  cout << "Validation of engines: \033[1m"
+       << (isValidate ? "yes" : "no") << "\033[0m\n";
+  cout << "Input to kNN: \033[1m"
+       << (isFeatures ? "profile features" : "energy per plane")
+       << "\033[0m\n";
+  cout << "Region of interest: \033[1m"
+       << (region.empty() ? "all planes" : region) << "\033[0m\n";
+  cout << "Leave-one-out: \033[1m"
+       << (isLoo ? "yes" : "no") << "\033[0m\n";
+  cout << "Compressed testing events: \033[1m"
+       << (isCompressed ? "yes" : "no") << "\033[0m\n";
+  cout << "The number of processes = \033[1m";
+  
+  if (nRanks == 0) cout << "MPI";
+  else cout << nRanks;
+  
+  cout << "\033[0m\n";
+}
+
+//! ask if program should continue (batch jobs can not answer, so they
+//! just go on)
+void RecoTargetUserOptions :: confirm () const
+{
+  if (not isatty (STDIN_FILENO)) return;
+  
+  char answer = 'n';
   
   cout << "\nDo you want to proceed [y/n]? "; cin >> answer;
   
-  if (answer != 'Y' and answer != 'y') exit (2); 
+  if (answer != 'Y' and answer != 'y')
+    throw Exception (USER_ABORT, "Aborted by user.");
 }
 
-//! target code = sum_i^#targets (TARGET * 10^i)
-void RecoTargetUserOptions::codeToFlags (int code, bool *flags)
+//! target code = digits of targets, optionally separated by commas
+void RecoTargetUserOptions :: codeToFlags (const char *code, bool *flags)
 {
-  while (code > 0)
+  fill_n (flags, nTargets, false);
+  
+  for (; *code; code++)
   {
-    const unsigned int target = code % 10;
+    if (*code == ',' or *code == ' ') continue;
     
-    if (target < 1 or target > 5) usage ("Wrong target.");
+    const int target = *code - '0';
     
-    flags [target-1] = true;    
+    if (target < 1 or target > (int) nTargets) usage ("Wrong target.");
     
-    code /= 10;
-  };
+    flags [target-1] = true;
+  }
 }
@@ -10,17 +10,62 @@
 #define RECO_TARGET_USER_OPTIONS_H
 
 #include "RecoTargetDetectorProperties.h"
+#include <string>
+#include <vector>
 
 class RecoTargetUserOptions
 {
   public:
   
   RecoTargetUserOptions (int argc, char **argv); //!< constructor
+  
+  //! return all runs: one per k from command line, or one per k and
+  //! section of batch file
+  std::vector <RecoTargetUserOptions> getRuns () const;
+  
+  //! add targets and neighbors of other run (to do both at once)
+  void merge (const RecoTargetUserOptions &other);
+  
+  //! true if other run uses the same testing and learning samples
+  bool isSameSamples (const RecoTargetUserOptions &other) const;
+  
+  //! true if other run finds the same neighbors (for its targets)
+  bool isSameNeighbors (const RecoTargetUserOptions &other) const;
+  
+  //! return name of the run (empty if not from batch file)
+  inline const char* getName () const
+  {
+    return name.c_str();
+  };
     
   //! return path to files
-  inline char* getPath () const
+  inline const char* getPath () const
+  {
+    return pathToFiles.c_str();
+  };
+  
+  //! return path to cache directory (NULL if not used)
+  inline const char* getCachePath () const
+  {
+    return pathToCache.empty() ? NULL : pathToCache.c_str();
+  };
+  
+  //! return path to event store directory (NULL if not used)
+  inline const char* getStorePath () const
+  {
+    return pathToStore.empty() ? NULL : pathToStore.c_str();
+  };
+  
+  //! return path to reduced learning set (NULL if not used)
+  inline const char* getReducedPath () const
+  {
+    return pathToReduced.empty() ? NULL : pathToReduced.c_str();
+  };
+  
+  //! return path to batch file (NULL if not used)
+  inline const char* getBatchPath () const
   {
-    return pathToFiles;
+    return pathToBatch.empty() ? NULL : pathToBatch.c_str();
   };
   
   //! return testing target on/off flag
@@ -53,16 +98,154 @@ class RecoTargetUserOptions
     return idMetric;
   };
 
+  //! return chosen vote
+  inline unsigned int getVote () const
+  {
+    return idVote;
+  };
+
+  //! return chosen storage precision
+  inline unsigned int getPrecision () const
+  {
+    return idPrecision;
+  };
+
+  //! return chosen selection of entries
+  inline unsigned int getSelection () const
+  {
+    return idSelection;
+  };
+
+  //! return chosen reduction of learning samples
+  inline unsigned int getReduction () const
+  {
+    return idReduction;
+  };
+
+  //! return seed for random selections
+  inline unsigned int getSeed () const
+  {
+    return seed;
+  };
+
+  //! return the number of worker threads
+  inline unsigned int getNThreads () const
+  {
+    return nThreads;
+  };
+
+  //! return true if kNN uses compact features instead of distributions
+  inline bool getFlagFeatures () const
+  {
+    return isFeatures;
+  };
+
+  //! return region of interest (NULL = all planes, see Region.h)
+  inline const char* getRegion () const
+  {
+    return region.empty() ? NULL : region.c_str();
+  };
+
+  //! return true if testing samples keep only non-zero windows
+  inline bool getFlagCompressed () const
+  {
+    return isCompressed;
+  };
+
+  //! return true if scores for every k up to kmax are printed
+  inline bool getFlagKScan () const
+  {
+    return isKScan;
+  };
+
+  //! return true if hardware counters are reported
+  inline bool getFlagProfile () const
+  {
+    return isProfile;
+  };
+
+  //! return true if learning samples are classified by each other
+  inline bool getFlagLoo () const
+  {
+    return isLoo;
+  };
+
+  //! return true if engines are compared on synthetic events (no run)
+  inline bool getFlagValidate () const
+  {
+    return isValidate;
+  };
+
+  //! return input of served events (NULL = not served, "-" = stdin)
+  inline const char* getServePath () const
+  {
+    return pathToServe.empty() ? NULL : pathToServe.c_str();
+  };
+  
+  //! return true if predictions of served events are binary records
+  inline bool getFlagBinary () const
+  {
+    return isBinary;
+  };
+
+  //! return true if testing samples are classified while being read
+  inline bool getFlagPipeline () const
+  {
+    return isPipeline;
+  };
+
+  //! return the number of processes (0 = MPI ranks)
+  inline unsigned int getNRanks () const
+  {
+    return nRanks;
+  };
+
+  //! return learning samples per target read at once (0 = all of them
+  //! stay in memory)
+  inline unsigned int getChunkSize () const
+  {
+    return nChunkSamples;
+  };
+
   //! return the number of nearest neighbors for kNN
   inline unsigned int getNeighbors () const
   {
     return nNearestNeighbors;
   };
   
+  //! return the number of nearest neighbors to keep (>= k)
+  inline unsigned int getMaxNeighbors () const
+  {
+    return nMaxNeighbors > nNearestNeighbors ? nMaxNeighbors
+                                             : nNearestNeighbors;
+  };
+  
   private:
+  
+  friend class RecoTargetValidation; //!< runs engines with each metric
+  
+  std::string name; //!< section of batch file (+ k if many)
 
   //! path to the ana files to process
-  char *pathToFiles;
+  std::string pathToFiles;
+  
+  //! path to event store directory (empty = read ana files directly)
+  std::string pathToStore;
+  
+  //! path to cache directory (empty = no cache)
+  std::string pathToCache;
+  
+  //! path to batch file (empty = single run from command line)
+  std::string pathToBatch;
+  
+  //! path to reduced learning set (empty = not saved)
+  std::string pathToReduced;
+  
+  //! planes used by distances (empty = all planes)
+  std::string region;
+  
+  //! input of served events (empty = testing samples are used)
+  std::string pathToServe;
 
   //! number of samples to process
   unsigned int nTestingSamples;
@@ -70,8 +253,20 @@ class RecoTargetUserOptions
   unsigned int nLearningSamples;
   //! number of nearest neighbors that matters
   unsigned int nNearestNeighbors;
+  //! all k requested (one run each)
+  std::vector <unsigned int> listOfNeighbors;
+  //! number of nearest neighbors kept (e.g. for cache)
+  unsigned int nMaxNeighbors;
 
   unsigned int idMetric; //!< id of the chosen metric
+  unsigned int idVote; //!< id of the chosen vote
+  unsigned int idPrecision; //!< id of the chosen storage precision
+  unsigned int idSelection; //!< id of the chosen selection of entries
+  unsigned int idReduction; //!< id of the chosen reduction of learning
+  unsigned int seed; //!< seed for random selections
+  unsigned int nThreads; //!< number of worker threads
+  unsigned int nRanks; //!< number of processes (0 = MPI ranks)
+  unsigned int nChunkSamples; //!< learning chunk per target (0 = all)
 
   //!< on/off flag for testing targets
   bool isTestingTarget[RecoTarget::nTargets];
@@ -79,12 +274,38 @@ class RecoTargetUserOptions
   //!< on/off flag for learning targets
   bool isLearningTarget[RecoTarget::nTargets];
 
+  bool isPipeline; //!< true if testing samples are read in background
+  
+  bool isFeatures; //!< true if samples are converted to features
+  
+  bool isCompressed; //!< true if testing samples are compressed
+  
+  bool isKScan; //!< true if scores for every k are printed
+  
+  bool isProfile; //!< true if hardware counters are reported
+  
+  bool isLoo; //!< true if learning samples are left out one by one
+  
+  bool isValidate; //!< true if engines are compared to reference
+  
+  bool isBinary; //!< true if served predictions are binary records
+
   bool showSummary; //!< true if summary should be displayed before run
   
-  void usage (const char *error = ""); //!< print usage and exit program
-  void summary (); //!< print user setup
-  //! convert target code to array of flags
-  void codeToFlags (int code, bool *flags);
+  std::string definedOptions; //!< short names of all options set
+  
+  //! set option given by short name (value = NULL for flags)
+  void set (const int option, const char *value);
+  //! apply key = value lines of batch file section
+  void set (const std::vector <std::string> &lines,
+            const bool isGlobal);
+  void check (); //!< check if all required options are set and valid
+  
+  void usage (const char *error = ""); //!< print usage and throw
+  void summary () const; //!< print user setup
+  void confirm () const; //!< ask user to proceed (only if interactive)
+  //! convert target list (e.g. 145 or 1,4,5) to array of flags
+  void codeToFlags (const char *code, bool *flags);
 };
 
 #endif
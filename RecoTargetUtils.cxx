@@ -1,19 +1,33 @@
 #include "RecoTargetUtils.h"
 #include "RecoTargetDetectorProperties.h"
-#include <cstring>
-#include <iostream>
-#include <cstdlib>
+#include "RecoTargetException.h"
+#include <algorithm>
+#include <string>
+#include <unistd.h>
 
 using namespace RECOTRACKS_ANA;
-using std::strcpy;
-using std::strcat;
 
 namespace RecoTarget
 {
-  //! create a new char of the length "a"+"b", copy "a" and add "b" 
-  char* mergeChar (const char *a, const char *b)
+  //! return a string "a"+"b" (frees itself)
+  std::string mergeChar (const char *a, const char *b)
   {   
-    return strcat (strcpy (new char[strlen(a) + strlen(b)], a), b);
+    return std::string (a) + b;
+  }
+  
+  //! path to input ana files assuming 'path/00/00/00/0#TARGET'
+  const char* targetSubpath (const unsigned int &target)
+  {
+    static const char *subpaths[nTargets] =
+    {
+      "/00/00/00/01/*.root",
+      "/00/00/00/02/*.root",
+      "/00/00/00/03/*.root",
+      "/00/00/00/04/*.root",
+      "/00/00/00/05/*.root"
+    };
+    
+    return subpaths[target];
   }
   
   /*! <ul>
@@ -31,84 +45,360 @@ namespace RecoTarget
 
     if (tChain -> GetEntries() == 0)
     {
-      std::cerr << "\nERROR: There is no files in "
-                << pathToFiles << "\n\n";
-      exit (3);
+      delete tChain;
+      throw Exception (NO_FILES, std::string ("There is no files in ")
+                                 + pathToFiles);
     }
         
     // create and return RecoTracks from TChain
     return new RecoTracks (tChain);
   }
+  
+  //! RecoTracks does not own its chain, so delete it here
+  void closeFiles (RecoTracks *recoTracks)
+  {
+    TTree *tChain = recoTracks->fChain;
+    
+    delete recoTracks;
+    delete tChain;
+  }
+
+  /*! <ul>
+   *  <li> entries of i-th file start at GetTreeOffset()[i]
+   *  <li> a plain tree (not a chain) is treated as a single file
+   *  </ul>
+   */
+  std::vector <unsigned int> fileOffsets (RecoTracks *recoTracks)
+  {
+    std::vector <unsigned int> offsets (1, 0);
+    
+    // GetEntries also makes chain to compute offsets of its trees
+    const unsigned int nEntries = recoTracks->fChain->GetEntries();
+    
+    TChain *tChain = dynamic_cast <TChain*> (recoTracks->fChain);
+    
+    if (tChain)
+      for (int i = 1; i < tChain->GetNtrees(); i++)
+        offsets.push_back (tChain->GetTreeOffset()[i]);
+        
+    offsets.push_back (nEntries);
+    
+    return offsets;
+  }
 
   /*! <ul>
    *  <li> create path to files for each target
    *  <li> loop over targets
-   *  <li> load RecoTracks
-   *  <li> fill samples with defined number of entries
+   *  <li> create handlers (compressed, profiled) before they are filled
+   *  <li> load RecoTracks (or event store)
+   *  <li> fill samples with selected entries (only given shard for 
+   *  learning samples)
    *  </ul>
    */ 
   void loadSamples (RecoTargetSampleHandler **testingSamples,
                     RecoTargetSampleHandler **learningSamples,
-                    const RecoTargetUserOptions &userOptions)
+                    const RecoTargetUserOptions &userOptions,
+                    const unsigned int &shard,
+                    const unsigned int &nShards,
+                    unsigned int *nEntries,
+                    RecoTargetPipeline *pipeline,
+                    RecoTargetProfiler *profiler)
   {
-    // path to input ana files assuming 'path/00/00/00/0#TARGET'
-    const char *pathToFiles[nTargets] =
-    {
-      mergeChar (userOptions.getPath(), "/00/00/00/01/*.root"),
-      mergeChar (userOptions.getPath(), "/00/00/00/02/*.root"),
-      mergeChar (userOptions.getPath(), "/00/00/00/03/*.root"),
-      mergeChar (userOptions.getPath(), "/00/00/00/04/*.root"),
-      mergeChar (userOptions.getPath(), "/00/00/00/05/*.root")
-    };
+    const Selection selection = (Selection) userOptions.getSelection();
+    
+    // chunk of learning samples is a block of planned entries read
+    // front to back, other samples are spread over the store
+    const bool isStreamed = userOptions.getChunkSize() > 0 and
+                            not testingSamples;
     
     for (unsigned int i = 0; i < nTargets; i++) // loop over targets
     {
       // check if i-th target was selected 
-      if (not (userOptions.getFlagTestingTarget (i) or 
-               userOptions.getFlagLearningTarget (i))) continue;
+      const bool isTesting =
+        testingSamples and userOptions.getFlagTestingTarget (i);
+      const bool isLearning =
+        learningSamples and userOptions.getFlagLearningTarget (i);
+      
+      if (not (isTesting or isLearning)) continue;
+      
+      // handlers are set up before filling: testing events may be
+      // compressed while being filled, fill may be profiled
+      if (isTesting)
+      {
+        if (not testingSamples[i])
+          testingSamples[i] = new RecoTargetSampleHandler (0);
+        
+        testingSamples[i]->compress (userOptions.getFlagCompressed());
+        testingSamples[i]->profile (profiler);
+      }
+      
+      if (isLearning)
+      {
+        if (not learningSamples[i])
+          learningSamples[i] = new RecoTargetSampleHandler (0);
+        
+        learningSamples[i]->profile (profiler);
+      }
+      
+      // read events from event store if user wants it
+      if (userOptions.getStorePath())
+      {
+        RecoTargetEventStore *store = loadEventStore
+          (userOptions.getPath(), userOptions.getStorePath(), i,
+           isStreamed);
+          
+        if (nEntries) nEntries[i] = store->getNEntries();
+          
+        try
+        {
+          if (isTesting)
+            testingSamples[i] =
+            createSample (*store, userOptions.getNTestingSamples(), 1,
+                          testingSamples[i], 0, 1, selection,
+                          userOptions.getSeed(), pipeline);
+          
+          if (isLearning)
+            learningSamples[i] =
+            createSample (*store, userOptions.getNLearningSamples(), 0,
+                          learningSamples[i], shard, nShards, selection,
+                          userOptions.getSeed());
+        }
+        catch (...)
+        {
+          delete store;
+          throw;
+        }
+          
+        delete store;
+        continue;
+      }
+      
+      // path to input ana files assuming 'path/00/00/00/0#TARGET'
+      const std::string pathToFiles =
+        mergeChar (userOptions.getPath(), targetSubpath (i));
             
       // get RecoTracks for current target
-      RecoTracks *recoTracks = loadFiles (pathToFiles[i]);
+      RecoTracks *recoTracks = loadFiles (pathToFiles.c_str());
+      
+      if (nEntries) nEntries[i] = recoTracks->fChain->GetEntries();
       
-      // create testing samples handler for current target
-      if (userOptions.getFlagTestingTarget (i))
-        testingSamples[i] =
-        createSample (recoTracks, userOptions.getNTestingSamples(), 1);
+      try
+      {
+        // create testing samples handler for current target
+        if (isTesting)
+          testingSamples[i] =
+          createSample (recoTracks, userOptions.getNTestingSamples(), 1,
+                        testingSamples[i], 0, 1, selection,
+                        userOptions.getSeed(), pipeline);
 
-      // create learning samples handler for current target
-      if (userOptions.getFlagLearningTarget (i))
-        learningSamples[i] =
-        createSample (recoTracks, userOptions.getNLearningSamples(), 0);
+        // create learning samples handler for current target
+        if (isLearning)
+          learningSamples[i] =
+          createSample (recoTracks, userOptions.getNLearningSamples(), 0,
+                        learningSamples[i], shard, nShards, selection,
+                        userOptions.getSeed());
+      }
+      catch (...)
+      {
+        closeFiles (recoTracks);
+        throw;
+      }
+
+      closeFiles (recoTracks);
+    }
+  }
 
-      delete recoTracks;    
+  //! plan entries of each learning target (from store, if used)
+  unsigned int maxLearningEntries (const RecoTargetUserOptions &userOptions)
+  {
+    const Selection selection = (Selection) userOptions.getSelection();
+    
+    unsigned int nMax = 0;
+    
+    for (unsigned int i = 0; i < nTargets; i++)
+    {
+      if (not userOptions.getFlagLearningTarget (i)) continue;
+      
+      std::vector <unsigned int> offsets;
+      
+      if (userOptions.getStorePath())
+      {
+        RecoTargetEventStore *store = loadEventStore
+          (userOptions.getPath(), userOptions.getStorePath(), i);
+        
+        for (unsigned int f = 0; f <= store->getNFiles(); f++)
+          offsets.push_back (store->getFileOffset (f));
+        
+        delete store;
+      }
+      else
+      {
+        RecoTracks *recoTracks = loadFiles
+          (mergeChar (userOptions.getPath(), targetSubpath (i)).c_str());
+        
+        offsets = fileOffsets (recoTracks);
+        
+        closeFiles (recoTracks);
+      }
+      
+      nMax = std::max <unsigned int> (nMax, planSelection
+        (selection, offsets, userOptions.getNLearningSamples(), false,
+         userOptions.getSeed()).size());
     }
+    
+    return nMax;
   }
+  
+  /*! <ul>
+   *  <li> plan sorted list of entries for the whole sample
+   *  <li> find a block of samples for given shard
+   *  <li> create sample handler (or resize existing one)
+   *  </ul>
+   */
+  RecoTargetSampleHandler* prepareSample 
+    (const std::vector <unsigned int> &fileOffsets,
+     const unsigned int &sampleSize,
+     const bool &isTesting,
+     RecoTargetSampleHandler *sample,
+     const unsigned int &shard,
+     const unsigned int &nShards,
+     const Selection &selection,
+     const unsigned int &seed,
+     std::vector <unsigned int> &entries,
+     unsigned int &first)
+  {
+    entries = planSelection (selection, fileOffsets, sampleSize,
+                             isTesting, seed);
     
-  //! create a sample, set up step for looping events, load events
+    // samples [first, last) belong to the shard (ids as in full sample)
+    first = 1ull * entries.size() * shard / nShards;
+    const unsigned int last = 1ull * entries.size() * (shard + 1) / nShards;
+    
+    // create a sample handler or reuse the existing one
+    if (sample) sample->resize (last - first, first);
+    else sample = new RecoTargetSampleHandler (last - first, first);
+    
+    return sample;
+  }
+  
+  /*! <ul>
+   *  <li> without pipeline: fill all samples at once
+   *  <li> with pipeline: fill batch by batch, each batch is classified
+   *  by pipeline workers while the next one is read
+   *  </ul>
+   */
+  template <typename Source>
+  void fillSample (Source source, RecoTargetSampleHandler *sample,
+                   const unsigned int *entries,
+                   RecoTargetPipeline *pipeline)
+  {
+    if (not pipeline)
+    {
+      sample->fillSamples (source, entries);
+      return;
+    }
+    
+    // features, region and quantized copy are made batch by batch from
+    // now on (samples are not filled yet, so nothing is converted now)
+    sample->prepare (pipeline->getFlagFeatures(), pipeline->getRegion(),
+                     pipeline->getPrecision());
+    
+    const unsigned int n = sample->getNSamples();
+    
+    for (unsigned int first = 0; first < n; first += pipelineBatch)
+    {
+      const unsigned int last = std::min (n, first + pipelineBatch);
+      
+      sample->fillSamples (source, entries, first, last);
+      pipeline->push (sample, first, last);
+    }
+  }
+  
+  //! create a sample, choose entries, load events
   RecoTargetSampleHandler* createSample (RecoTracks *recoTracks,
                                          const unsigned int &sampleSize,
-                                         const bool &isTesting)
+                                         const bool &isTesting,
+                                         RecoTargetSampleHandler *sample,
+                                         const unsigned int &shard,
+                                         const unsigned int &nShards,
+                                         const Selection &selection,
+                                         const unsigned int &seed,
+                                         RecoTargetPipeline *pipeline)
   {
-    // create a sample handler
-    RecoTargetSampleHandler *sample = 
-      new RecoTargetSampleHandler (sampleSize);
+    std::vector <unsigned int> entries;
+    unsigned int first;
     
-    // number of entries in RecoTracks
-    const unsigned int nEntries = recoTracks->fChain->GetEntries();
+    sample = prepareSample (fileOffsets (recoTracks), sampleSize, 
+                            isTesting, sample, shard, nShards, selection,
+                            seed, entries, first);
+        
+    // fill sample using planned entries of this shard
+    fillSample (recoTracks, sample, entries.data() + first, pipeline);
     
-    // step for events loop (must be even, because it will take
-    // even events for testing sample and odd event for learning)
-    const unsigned int step = (nEntries / sampleSize / 2) * 2;
+    return sample;
+  }
+  
+  //! the same as above for event store
+  RecoTargetSampleHandler* createSample (const RecoTargetEventStore &store,
+                                         const unsigned int &sampleSize,
+                                         const bool &isTesting,
+                                         RecoTargetSampleHandler *sample,
+                                         const unsigned int &shard,
+                                         const unsigned int &nShards,
+                                         const Selection &selection,
+                                         const unsigned int &seed,
+                                         RecoTargetPipeline *pipeline)
+  {
+    std::vector <unsigned int> offsets;
     
-    // initial event in the loop
-    unsigned int start = 0;
+    for (unsigned int i = 0; i <= store.getNFiles(); i++)
+      offsets.push_back (store.getFileOffset (i));
     
-    if (isTesting) start = 1;
-        
-    // fill sample using "sampleSize" events, starting from "start"
-    // with step = "step"
-    sample->fillSamples (recoTracks, start, step);   
+    std::vector <unsigned int> entries;
+    unsigned int first;
+    
+    sample = prepareSample (offsets, sampleSize, isTesting, sample, shard,
+                            nShards, selection, seed, entries, first);
+    
+    fillSample <const RecoTargetEventStore&> (store, sample,
+                                              entries.data() + first,
+                                              pipeline);
     
     return sample;
   }
+  
+  /*! <ul>
+   *  <li> store file = pathToStore/target0#TARGET.store
+   *  <li> if it does not exist convert ana files to it (once)
+   *  <li> map store file
+   *  </ul>
+   */
+  RecoTargetEventStore* loadEventStore (const char *pathToFiles,
+                                        const char *pathToStore,
+                                        const unsigned int &target,
+                                        const bool &isSequential)
+  {
+    const std::string storeFile = std::string (pathToStore) + "/target0" +
+                                  char ('1' + target) + ".store";
+    
+    if (access (storeFile.c_str(), F_OK) != 0)
+    {
+      RecoTracks *recoTracks =
+        loadFiles (mergeChar (pathToFiles, targetSubpath (target)).c_str());
+        
+      try
+      {
+        RecoTargetEventStore::convert (recoTracks, storeFile.c_str());
+      }
+      catch (...)
+      {
+        closeFiles (recoTracks);
+        throw;
+      }
+      
+      closeFiles (recoTracks);
+    }
+    
+    return new RecoTargetEventStore (storeFile.c_str(), isSequential);
+  }
 }
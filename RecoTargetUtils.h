@@ -12,25 +12,78 @@
 #include "RecoTracks.h"
 #include "RecoTargetSampleHandler.h"
 #include "RecoTargetUserOptions.h"
+#include "RecoTargetSelection.h"
+#include "RecoTargetPipeline.h"
+#include <string>
+#include <vector>
 
 namespace RecoTarget
 {
   //! return char* + char*
-  char* mergeChar (const char *a, const char *b);
+  std::string mergeChar (const char *a, const char *b);
+  
+  //! return files pattern for given target (relative to user's path)
+  const char* targetSubpath (const unsigned int &target);
   
   //! load recotracks tree from files
   RECOTRACKS_ANA::RecoTracks* loadFiles (const char *pathToFiles);
   
-  //! load testing and learning samples
+  //! delete recotracks created by loadFiles (together with its TChain)
+  void closeFiles (RECOTRACKS_ANA::RecoTracks *recoTracks);
+  
+  //! return first entry of each file in the chain (+ total entries)
+  std::vector <unsigned int> fileOffsets 
+    (RECOTRACKS_ANA::RecoTracks *recoTracks);
+  
+  //! load testing and learning samples (reuse already created ones),
+  //! learning samples are split in nShards and only one is loaded;
+  //! the number of entries found for each target goes to nEntries;
+  //! NULL testing or learning array = skip it; with pipeline testing
+  //! samples are pushed to it batch by batch while being read; fill
+  //! of all samples is counted by profiler (if given)
   void loadSamples (RecoTargetSampleHandler **testingSamples,
                     RecoTargetSampleHandler **learningSamples,
-                    const RecoTargetUserOptions &userOptions);
+                    const RecoTargetUserOptions &userOptions,
+                    const unsigned int &shard = 0,
+                    const unsigned int &nShards = 1,
+                    unsigned int *nEntries = NULL,
+                    RecoTargetPipeline *pipeline = NULL,
+                    RecoTargetProfiler *profiler = NULL);
+  
+  //! return the largest number of learning entries planned for one of
+  //! learning targets (all shards together, as loadSamples selects them)
+  unsigned int maxLearningEntries (const RecoTargetUserOptions &userOptions);
   
-  //! make a sample from RecoTracks                  
+  //! make a sample from RecoTracks (or refill given one); with
+  //! nShards > 1 only given shard (contiguous block) of it is loaded
   RecoTargetSampleHandler* createSample 
     (RECOTRACKS_ANA::RecoTracks *recoTracks,
      const unsigned int &sampleSize,
-     const bool &isTesting);
+     const bool &isTesting,
+     RecoTargetSampleHandler *sample = NULL,
+     const unsigned int &shard = 0,
+     const unsigned int &nShards = 1,
+     const Selection &selection = STRIDED,
+     const unsigned int &seed = 0,
+     RecoTargetPipeline *pipeline = NULL);
+  
+  //! make a sample from event store (as above)
+  RecoTargetSampleHandler* createSample 
+    (const RecoTargetEventStore &store,
+     const unsigned int &sampleSize,
+     const bool &isTesting,
+     RecoTargetSampleHandler *sample = NULL,
+     const unsigned int &shard = 0,
+     const unsigned int &nShards = 1,
+     const Selection &selection = STRIDED,
+     const unsigned int &seed = 0,
+     RecoTargetPipeline *pipeline = NULL);
+  
+  //! return event store for target (converted from ana files if needed)
+  RecoTargetEventStore* loadEventStore (const char *pathToFiles,
+                                        const char *pathToStore,
+                                        const unsigned int &target,
+                                        const bool &isSequential = false);
 }
 
 #endif
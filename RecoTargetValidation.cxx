@@ -0,0 +1,744 @@
+#include "RecoTargetValidation.h"
+#include "RecoTargetScheduler.h"
+#include "RecoTargetPipeline.h"
+#include "RecoTargetClassifier.h"
+#include "RecoTargetRanking.h"
+#include "RecoTargetStream.h"
+#include "RecoTargetGeometry.h"
+#include "RecoTargetRegion.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <list>
+#include <random>
+#include <set>
+
+using namespace RecoTarget;
+
+namespace RecoTarget
+{
+  //! use for understandable cout's
+  const char *listOfEngines[] =
+  {
+    "serial",
+    "scheduler",
+    "pipeline",
+    "ranks",
+    "streamed (out-of-core)",
+    "incremental",
+    "compressed",
+    "quantized",
+    "symmetric (leave-one-out)",
+    "region (targets, pipeline)",
+    "classifier",
+    "early exit"
+  };
+}
+
+namespace
+{
+  //! delete handlers and set them to NULL
+  void clear (RecoTargetSampleHandler **samples)
+  {
+    for (unsigned int i = 0; i < nTargets; i++)
+    {
+      delete samples[i];
+      samples[i] = NULL;
+    }
+  }
+}
+
+RecoTargetValidation :: RecoTargetValidation
+  (const RecoTargetUserOptions &userOptions)
+  : userOptions (userOptions)
+{
+  std::fill_n (reference, nTargets, (RecoTargetSampleHandler*) NULL);
+  std::fill_n (learning, nTargets, (RecoTargetSampleHandler*) NULL);
+  std::fill_n (self, nTargets, (RecoTargetSampleHandler*) NULL);
+  
+  generate();
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    if (userOptions.getFlagTestingTarget (i))
+      reference[i] = load (testingEvents[i], 0, testingEvents[i].size());
+    
+    if (userOptions.getFlagLearningTarget (i))
+      learning[i] = load (learningEvents[i], 0, learningEvents[i].size());
+    
+    if (reference[i] and learning[i])
+      self[i] = load (learningEvents[i], 0, learningEvents[i].size());
+  }
+}
+
+RecoTargetValidation :: ~RecoTargetValidation ()
+{
+  clear (reference);
+  clear (learning);
+  clear (self);
+}
+
+/*! <ul>
+ *  <li> shower of target t starts at random plane after the t-th part
+ *  of detector, parts overlap, so targets are not trivially separated
+ *  <li> energy decays exponentially with random length, some planes
+ *  are not hit
+ *  <li> ties: some learning events are copies of events of the same
+ *  target (tie broken by id) or of target 1 (broken by target), some
+ *  testing events are copies of learning events (distance 0)
+ *  </ul>
+ */
+void RecoTargetValidation :: generate ()
+{
+  // plane id of each z-order (events are filled as from RecoTracks)
+  int planeIds[nPlanes];
+  
+  for (unsigned int p = 0; p < nPlanes; p++) planeIds[p] = planeId (p);
+  
+  std::mt19937 generator (userOptions.getSeed());
+  std::uniform_real_distribution <double> uniform (0.0, 1.0);
+  
+  for (unsigned int t = 0; t < nTargets; t++)
+  {
+    const unsigned int nTesting = userOptions.getFlagTestingTarget (t) ?
+      userOptions.getNTestingSamples() : 0;
+    const unsigned int nLearning = userOptions.getFlagLearningTarget (t) ?
+      userOptions.getNLearningSamples() : 0;
+    
+    for (unsigned int e = 0; e < nTesting + nLearning; e++)
+    {
+      Event event;
+      
+      const unsigned int first = 8 + 36 * t + 24 * uniform (generator);
+      const unsigned int last =
+        std::min (nPlanes, first + 5 + (unsigned int) (60 * uniform
+                                                       (generator)));
+      const double length = 3.0 + 15.0 * uniform (generator);
+      
+      for (unsigned int p = first; p < last; p++)
+        if (uniform (generator) < 0.85 or event.planeId.empty())
+        {
+          event.planeId.push_back (planeIds[p]);
+          event.planeVisibleEnergy.push_back
+            ((0.1 + uniform (generator)) *
+             exp (-1.0 * (p - first) / length));
+        }
+      
+      if (e < nTesting) testingEvents[t].push_back (event);
+      else learningEvents[t].push_back (event);
+    }
+  }
+  
+  for (unsigned int t = 0; t < nTargets; t++)
+  {
+    std::vector <Event> &events = learningEvents[t];
+    
+    for (unsigned int e = 1; e < events.size(); e++)
+      if (e % 11 == 5) events[e] = events[e - 1];
+      else if (t > 0 and e % 7 == 3 and e < learningEvents[0].size())
+        events[e] = learningEvents[0][e];
+    
+    for (unsigned int e = 0; e < testingEvents[t].size(); e++)
+      if (e % 13 == 0 and e < events.size())
+        testingEvents[t][e] = events[e];
+  }
+}
+
+//! samples are appended one by one (as classifier does), region is
+//! set before (as pipeline does)
+RecoTargetSampleHandler* RecoTargetValidation :: load
+  (const std::vector <Event> &events, const unsigned int &from,
+   const unsigned int &to, const bool &compressed,
+   const std::vector <unsigned int> &region)
+{
+  RecoTargetSampleHandler *samples = new RecoTargetSampleHandler (0, from);
+  
+  samples->compress (compressed);
+  samples->prepare (false, region, DOUBLE);
+  
+  for (unsigned int e = from; e < to; e++)
+    samples->appendSample (events[e].planeVisibleEnergy.data(),
+                           events[e].planeId.data(),
+                           events[e].planeId.size());
+  
+  return samples;
+}
+
+//! testing samples and learning samples of testing targets
+void RecoTargetValidation :: fillReference ()
+{
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    if (reference[i]) fillReference (reference[i], i, false, learning);
+    if (self[i]) fillReference (self[i], i, true, learning);
+  }
+}
+
+/*! <ul>
+ *  <li> distances to all learning samples of all selected targets
+ *  (but the sample itself, if it is learning one)
+ *  <li> std::list::sort (stable, by distance, target, id)
+ *  <li> keep kmax nearest
+ *  </ul>
+ */
+void RecoTargetValidation :: fillReference
+  (RecoTargetSampleHandler *samples, const unsigned int &target,
+   const bool &isLearning, RecoTargetSampleHandler **learning)
+{
+  const Metric metric = (Metric) userOptions.getMetric();
+  const unsigned int k = userOptions.getMaxNeighbors();
+  
+  std::vector <Neighbor> nearest;
+  
+  samples->clearNeighbors();
+  
+  for (unsigned int s = 0; s < samples->nSamples; s++)
+  {
+    std::list <Neighbor> neighbors;
+    
+    for (unsigned int j = 0; j < nTargets; j++)
+      for (unsigned int l = 0; learning[j] and l < learning[j]->nSamples;
+           l++)
+      {
+        if (isLearning and j == target and l == s) continue;
+        
+        neighbors.push_back (Neighbor (samples->samples[s].distance
+          (learning[j]->samples[l], metric), j, learning[j]->firstId + l));
+      }
+    
+    neighbors.sort();
+    
+    std::list <Neighbor> :: const_iterator it = neighbors.begin();
+    
+    for (unsigned int n = 0; n < k and it != neighbors.end(); n++, ++it)
+      nearest.push_back (*it);
+    
+    samples->addNeighbors (s, nearest);
+  }
+}
+
+/*! <ul>
+ *  <li> SERIAL: fillNeighbors of each pair of targets
+ *  <li> SCHEDULER, COMPRESSED, QUANTIZED: scheduler with all threads
+ *  (indexed learning samples if Euclidean), as RecoTarget does
+ *  <li> PIPELINE, REGION: batches of testing samples pushed to workers
+ *  <li> RANKS: learning samples split into shards, top-k of each shard
+ *  packed and merged as reduceNeighbors does
+ *  <li> STREAMED: learning samples read chunk by chunk (the next one
+ *  while scheduler works on this one)
+ *  <li> INCREMENTAL: the second half of learning samples appended
+ *  later, only new ones are added (fromId), then the oldest ones are
+ *  retired and lists without them filled again (retireNeighbors)
+ *  <li> SYMMETRIC: learning samples classified by each other, pairs
+ *  of blocks dealt to scheduler's threads
+ *  <li> at the end each list is trimmed to sorted kmax nearest
+ *  </ul>
+ */
+void RecoTargetValidation :: fillNeighbors
+  (const Engine &engine, RecoTargetSampleHandler **testingSamples,
+   RecoTargetSampleHandler **learningSamples)
+{
+  const Metric metric = (Metric) userOptions.getMetric();
+  const unsigned int k = userOptions.getMaxNeighbors();
+  
+  // at least two threads, so they really share the work
+  const unsigned int nThreads = std::max (2u, userOptions.getNThreads());
+  
+  switch (engine)
+  {
+    case SERIAL:
+      for (unsigned int i = 0; i < nTargets; i++)
+        for (unsigned int j = 0; j < nTargets and testingSamples[i]; j++)
+          if (learningSamples[j])
+            testingSamples[i]->fillNeighbors (learningSamples[j], j, metric);
+      break;
+    case SCHEDULER:
+    case COMPRESSED:
+    case QUANTIZED:
+    {
+      for (unsigned int j = 0; j < nTargets; j++)
+        if (learningSamples[j] and metric == EUCLIDEAN)
+          learningSamples[j]->index();
+      
+      RecoTargetScheduler scheduler (nThreads);
+      
+      scheduler.fillNeighbors (testingSamples, learningSamples,
+                               userOptions);
+      break;
+    }
+    case PIPELINE:
+    case REGION:
+    {
+      for (unsigned int j = 0; j < nTargets; j++)
+        if (learningSamples[j] and metric == EUCLIDEAN and engine == REGION)
+          learningSamples[j]->index();
+      
+      RecoTargetPipeline pipeline (learningSamples, userOptions, nThreads);
+      
+      for (unsigned int i = 0; i < nTargets; i++)
+        for (unsigned int first = 0; testingSamples[i] and
+             first < testingSamples[i]->getNSamples();
+             first += pipelineBatch)
+          pipeline.push (testingSamples[i], first, std::min
+            (first + pipelineBatch, testingSamples[i]->getNSamples()));
+      
+      pipeline.finish();
+      break;
+    }
+    case RANKS:
+    {
+      std::vector < std::vector <char> > buffers (validationRanks);
+      
+      for (unsigned int r = 0; r < validationRanks; r++)
+      {
+        RecoTargetSampleHandler *shard[nTargets] = {NULL};
+        
+        for (unsigned int j = 0; j < nTargets; j++)
+          if (learningSamples[j])
+          {
+            const std::vector <Event> &events = learningEvents[j];
+            
+            shard[j] = load (events, events.size() * r / validationRanks,
+                             events.size() * (r + 1) / validationRanks);
+          }
+        
+        for (unsigned int i = 0; i < nTargets; i++)
+          if (testingSamples[i])
+          {
+            testingSamples[i]->clearNeighbors();
+            
+            for (unsigned int j = 0; j < nTargets; j++)
+              if (shard[j])
+                testingSamples[i]->fillNeighbors (shard[j], j, metric);
+            
+            testingSamples[i]->keepNearest (k);
+            testingSamples[i]->packNeighbors (buffers[r]);
+          }
+        
+        clear (shard);
+      }
+      
+      std::vector <const char*> cursors (validationRanks);
+      
+      for (unsigned int r = 0; r < validationRanks; r++)
+        cursors[r] = buffers[r].data();
+      
+      for (unsigned int i = 0; i < nTargets; i++)
+        if (testingSamples[i]) testingSamples[i]->mergeNeighbors (cursors, k);
+      break;
+    }
+    case STREAMED:
+    {
+      RecoTargetStream stream (validationChunks,
+        [&] (RecoTargetSampleHandler **chunk, const unsigned int &c)
+        {
+          for (unsigned int j = 0; j < nTargets; j++)
+            if (learningSamples[j])
+            {
+              const std::vector <Event> &events = learningEvents[j];
+              
+              delete chunk[j];
+              chunk[j] = load (events, events.size() * c / validationChunks,
+                               events.size() * (c + 1) / validationChunks);
+              
+              if (metric == EUCLIDEAN) chunk[j]->index();
+            }
+        });
+      
+      RecoTargetScheduler scheduler (nThreads);
+      
+      stream.run ([&] (RecoTargetSampleHandler **chunk)
+                  { scheduler.fillNeighbors (testingSamples, chunk,
+                                             userOptions); });
+      break;
+    }
+    case INCREMENTAL:
+    {
+      RecoTargetSampleHandler *half[nTargets] = {NULL};
+      unsigned int fromId[nTargets] = {0};
+      
+      for (unsigned int j = 0; j < nTargets; j++)
+        if (learningSamples[j])
+        {
+          half[j] = load (learningEvents[j], 0,
+                          learningEvents[j].size() / 2);
+          fromId[j] = half[j]->getNextId();
+        }
+      
+      for (unsigned int i = 0; i < nTargets; i++)
+        for (unsigned int j = 0; j < nTargets and testingSamples[i]; j++)
+          if (half[j]) testingSamples[i]->fillNeighbors (half[j], j, metric);
+      
+      for (unsigned int i = 0; i < nTargets; i++)
+        if (testingSamples[i]) testingSamples[i]->keepNearest (k);
+      
+      for (unsigned int j = 0; j < nTargets; j++)
+        for (unsigned int e = fromId[j]; half[j] and
+             e < learningEvents[j].size(); e++)
+          half[j]->appendSample
+            (learningEvents[j][e].planeVisibleEnergy.data(),
+             learningEvents[j][e].planeId.data(),
+             learningEvents[j][e].planeId.size());
+      
+      for (unsigned int i = 0; i < nTargets; i++)
+        for (unsigned int j = 0; j < nTargets and testingSamples[i]; j++)
+          if (half[j])
+            testingSamples[i]->fillNeighbors (half[j], j, metric,
+                                              fromId[j]);
+      
+      for (unsigned int i = 0; i < nTargets; i++)
+        if (testingSamples[i]) testingSamples[i]->keepNearest (k);
+      
+      for (unsigned int j = 0; j < nTargets; j++)
+        if (half[j])
+          half[j]->retireSamples (learningEvents[j].size() /
+                                  validationRetired);
+      
+      for (unsigned int i = 0; i < nTargets; i++)
+        if (testingSamples[i])
+          testingSamples[i]->retireNeighbors (half, metric, k);
+      
+      clear (half);
+      break;
+    }
+    case SYMMETRIC:
+    {
+      RecoTargetScheduler scheduler (nThreads);
+      
+      scheduler.fillSymmetric (learningSamples, userOptions);
+      break;
+    }
+    default:
+      break;
+  }
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (testingSamples[i]) testingSamples[i]->keepNearest (k);
+}
+
+/*! <ul>
+ *  <li> found = reference neighbors (target, id) found in lists
+ *  <li> the same order = the same (target, id) at each position
+ *  <li> near = distances at each position within tolerance (so only
+ *  near-equal neighbors swap) and neighbors missing from reference
+ *  within tolerance from its last one (swapped at the k-th neighbor)
+ *  <li> scores for every k up to kmax and every vote
+ *  </ul>
+ */
+RecoTargetValidation::Result RecoTargetValidation :: compareNeighbors
+  (RecoTargetSampleHandler **testingSamples,
+   RecoTargetSampleHandler **referenceSamples,
+   const double &tolerance) const
+{
+  Result result = {0.0, true, true, 0.0, 0.0, 0};
+  
+  unsigned int nFound = 0;
+  unsigned int nReference = 0;
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    if (not referenceSamples[i]) continue;
+    
+    for (unsigned int s = 0; s < referenceSamples[i]->nSamples; s++)
+    {
+      const std::vector <Neighbor> &expected =
+        referenceSamples[i]->getNeighbors (s);
+      const std::vector <Neighbor> &neighbors =
+        testingSamples[i]->getNeighbors (s);
+      
+      std::set < std::pair <unsigned int, unsigned int> > ids;
+      std::set < std::pair <unsigned int, unsigned int> > expectedIds;
+      
+      for (unsigned int n = 0; n < neighbors.size(); n++)
+        ids.insert (std::make_pair (neighbors[n].target, neighbors[n].id));
+      
+      if (neighbors.size() != expected.size())
+        result.isSame = result.isNear = false;
+      
+      for (unsigned int n = 0; n < expected.size(); n++)
+      {
+        nFound += ids.count (std::make_pair (expected[n].target,
+                                             expected[n].id));
+        expectedIds.insert (std::make_pair (expected[n].target,
+                                            expected[n].id));
+        
+        if (n >= neighbors.size()) continue;
+        
+        if (neighbors[n].target != expected[n].target or
+            neighbors[n].id != expected[n].id)
+          result.isSame = false;
+        
+        const double difference =
+          fabs (neighbors[n].distance - expected[n].distance);
+        
+        result.distance = std::max (result.distance, difference);
+        result.isNear = result.isNear and difference <= tolerance;
+      }
+      
+      for (unsigned int n = 0; n < neighbors.size(); n++)
+        if (not expectedIds.count (std::make_pair (neighbors[n].target,
+                                                   neighbors[n].id)) and
+            (expected.empty() or neighbors[n].distance <
+             expected.back().distance - tolerance))
+          result.isNear = false;
+      
+      nReference += expected.size();
+    }
+    
+    for (unsigned int k = 1; k <= userOptions.getMaxNeighbors(); k++)
+      for (unsigned int v = 0; v < nVotes; v++)
+        result.score = std::max (result.score, fabs
+          (testingSamples[i]->getScore (i, k, (Vote) v) -
+           referenceSamples[i]->getScore (i, k, (Vote) v)));
+  }
+  
+  result.found = nReference > 0 ? 1.0 * nFound / nReference : 1.0;
+  
+  return result;
+}
+
+//! predictions for k of the run and every vote
+RecoTargetValidation::Result RecoTargetValidation :: comparePredictions
+  (const bool &earlyExit)
+{
+  Result result = {1.0, true, true, 0.0, 0.0, 0};
+  
+  const Metric metric = (Metric) userOptions.getMetric();
+  const unsigned int k = userOptions.getNeighbors();
+  
+  for (unsigned int v = 0; v < nVotes; v++)
+  {
+    RecoTargetClassifier classifier (learning, metric, k, (Vote) v,
+                                     earlyExit);
+    
+    for (unsigned int i = 0; i < nTargets; i++)
+    {
+      if (not reference[i]) continue;
+      
+      unsigned int nCorrect = 0;
+      unsigned int nExpected = 0;
+      
+      for (unsigned int s = 0; s < reference[i]->nSamples; s++)
+      {
+        const Event &event = testingEvents[i][s];
+        const RecoTarget::Event hits = {event.planeVisibleEnergy.data(),
+                                        event.planeId.data(),
+                                        (unsigned int) event.planeId.size()};
+        
+        const unsigned int predicted = classifier.classify (hits);
+        const unsigned int expected =
+          reference[i]->samples[s].closestTarget (k, (Vote) v);
+        
+        if (predicted != expected) result.nDiffer++;
+        
+        nCorrect += predicted == i;
+        nExpected += expected == i;
+      }
+      
+      result.score = std::max (result.score, 1.0 *
+        abs ((int) nCorrect - (int) nExpected) / reference[i]->nSamples);
+    }
+  }
+  
+  result.isSame = result.nDiffer == 0;
+  
+  return result;
+}
+
+//! ranking adds votes neighbor by neighbor, getScore sorts and counts
+RecoTargetValidation::Result RecoTargetValidation :: compareRanking ()
+{
+  Result result = {1.0, true, true, 0.0, 0.0, 0};
+  
+  const unsigned int kMax = userOptions.getMaxNeighbors();
+  
+  for (unsigned int v = 0; v < nVotes; v++)
+  {
+    RecoTargetRanking ranking (kMax, (Vote) v);
+    
+    for (unsigned int i = 0; i < nTargets; i++)
+      if (reference[i]) ranking.add (reference[i], i);
+    
+    for (unsigned int i = 0; i < nTargets; i++)
+      for (unsigned int k = 1; k <= kMax and reference[i]; k++)
+        result.score = std::max (result.score, fabs
+          (ranking.getScore (i, k) - reference[i]->getScore (i, k, (Vote) v)));
+  }
+  
+  return result;
+}
+
+/*! <ul>
+ *  <li> fresh samples for each engine (engines index, quantize or
+ *  compress them)
+ *  <li> QUANTIZED: all precisions but double, the others in double
+ *  <li> only quantized storage changes distances, so it is the only
+ *  approximate engine (compressed samples give dense distances)
+ *  <li> REGION: compressed testing samples and learning samples keep
+ *  planes of region, reference is filled again for them
+ *  <li> INCREMENTAL: reference is filled again without retired samples
+ *  (the same ids: learning handler starts from the first one left)
+ *  </ul>
+ */
+bool RecoTargetValidation :: check (const Engine &engine,
+                                    const Precision &precision,
+                                    std::ostream &out)
+{
+  if (engine == CLASSIFIER or engine == EARLY_EXIT)
+    return print (out, listOfEngines[engine],
+                  comparePredictions (engine == EARLY_EXIT), true);
+  
+  RecoTargetSampleHandler *testingSamples[nTargets] = {NULL};
+  RecoTargetSampleHandler *learningSamples[nTargets] = {NULL};
+  
+  // reference of REGION or INCREMENTAL (NULL = reference is used)
+  RecoTargetSampleHandler *ownReference[nTargets] = {NULL};
+  RecoTargetSampleHandler *ownLearning[nTargets] = {NULL};
+  
+  const bool isOwnReference = engine == REGION or engine == INCREMENTAL;
+  
+  const std::vector <unsigned int> region = engine == REGION ?
+    RecoTargetRegion (validationRegion).getPlanes (learning) :
+    std::vector <unsigned int> ();
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+  {
+    if (reference[i] and engine != SYMMETRIC)
+      testingSamples[i] = load (testingEvents[i], 0,
+                                testingEvents[i].size(),
+                                engine == COMPRESSED or engine == REGION,
+                                region);
+    
+    if (learning[i])
+      learningSamples[i] = load (learningEvents[i], 0,
+                                 learningEvents[i].size(), false, region);
+    
+    if (testingSamples[i]) testingSamples[i]->quantize (precision);
+    if (learningSamples[i]) learningSamples[i]->quantize (precision);
+    
+    if (isOwnReference and reference[i])
+      ownReference[i] = load (testingEvents[i], 0, testingEvents[i].size(),
+                              false, region);
+    
+    if (isOwnReference and learning[i])
+      ownLearning[i] = load (learningEvents[i], engine == INCREMENTAL ?
+                             learningEvents[i].size() / validationRetired :
+                             0, learningEvents[i].size(), false, region);
+  }
+  
+  for (unsigned int i = 0; i < nTargets; i++)
+    if (ownReference[i])
+      fillReference (ownReference[i], i, false, ownLearning);
+  
+  fillNeighbors (engine, testingSamples, learningSamples);
+  
+  const double tolerance = distanceTolerance[precision];
+  
+  const Result result = engine == SYMMETRIC ?
+    compareNeighbors (learningSamples, self, tolerance) :
+    compareNeighbors (testingSamples,
+                      isOwnReference ? ownReference : reference, tolerance);
+  
+  clear (testingSamples);
+  clear (learningSamples);
+  clear (ownReference);
+  clear (ownLearning);
+  
+  if (precision == DOUBLE)
+    return print (out, listOfEngines[engine], result, true);
+  
+  return print (out, std::string (listOfEngines[engine]) + " " +
+                listOfPrecisions[precision], result, false);
+}
+
+/*! <ul>
+ *  <li> exact: the same lists (order included), the same distances,
+ *  scores and predictions
+ *  <li> approximate: lists within tolerance (see compareNeighbors),
+ *  scores within scoreTolerance
+ *  </ul>
+ */
+bool RecoTargetValidation :: print (std::ostream &out,
+                                    const std::string &engine,
+                                    const Result &result,
+                                    const bool &isExact) const
+{
+  const bool isPassed = result.isNear and (isExact ?
+    result.isSame and result.distance == 0.0 and result.score == 0.0 :
+    result.score <= scoreTolerance);
+  
+  const std::ios_base::fmtflags flags = out.flags();
+  const std::streamsize precision = out.precision();
+  
+  out << std::setw (30) << engine << std::fixed << std::setprecision (4)
+      << std::setw (8) << result.found
+      << std::setw (7) << (result.isSame ? "yes" : "no")
+      << std::scientific << std::setprecision (1)
+      << std::setw (11) << result.distance
+      << std::fixed << std::setprecision (4)
+      << std::setw (9) << result.score
+      << std::setw (8) << result.nDiffer
+      << (isPassed ? "   ok" : "   FAILED") << "\n";
+  
+  out.flags (flags);
+  out.precision (precision);
+  
+  return isPassed;
+}
+
+/*! <ul>
+ *  <li> for each metric: reference, then ranking, then all engines
+ *  <li> early exit is only different from classifier for Euclidean
+ *  </ul>
+ */
+unsigned int RecoTargetValidation :: run (std::ostream &out)
+{
+  out << "\nValidation on synthetic events (seed "
+      << userOptions.getSeed() << ", kmax = "
+      << userOptions.getMaxNeighbors() << ", classifier k = "
+      << userOptions.getNeighbors() << "):\n\n"
+      << std::setw (30) << "engine"
+      << std::setw (8) << "found" << std::setw (7) << "order"
+      << std::setw (11) << "distance" << std::setw (9) << "score"
+      << std::setw (8) << "differ" << "   result\n";
+  
+  unsigned int nFailed = 0;
+  
+  for (unsigned int m = 0; m < nMetrics; m++)
+  {
+    userOptions.idMetric = m;
+    
+    fillReference();
+    
+    out << listOfMetrics[m] << ":\n";
+    
+    nFailed += not print (out, "ranking", compareRanking(), true);
+    
+    for (unsigned int e = 0; e < nEngines; e++)
+    {
+      if (e == EARLY_EXIT and m != EUCLIDEAN) continue;
+      
+      if (e != QUANTIZED)
+        nFailed += not check ((Engine) e, DOUBLE, out);
+      else
+        for (unsigned int p = FLOAT; p < nPrecisions; p++)
+          nFailed += not check ((Engine) e, (Precision) p, out);
+    }
+  }
+  
+  out << "\nfound = fraction of reference neighbors found, order = the "
+      << "same lists, distance = the largest difference\n"
+      << "score = the largest score difference (k = 1 .. kmax, all "
+      << "votes), differ = predictions different from reference\n"
+      << "quantized engines may swap neighbors within distance "
+      << "tolerance of precision (float " << distanceTolerance[FLOAT]
+      << ", int16 " << distanceTolerance[INT16] << ", uint8 "
+      << distanceTolerance[UINT8] << ") and differ by " << scoreTolerance
+      << " in score, the others must be the same\n";
+  
+  if (nFailed > 0) out << "\n" << nFailed << " checks FAILED\n";
+  else out << "\nAll checks passed\n";
+  
+  return nFailed;
+}
@@ -0,0 +1,173 @@
+/**
+ * @brief Equivalence of neighbor search engines on synthetic events
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_VALIDATION_H
+#define RECO_TARGET_VALIDATION_H
+
+#include "RecoTargetSampleHandler.h"
+#include "RecoTargetUserOptions.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace RecoTarget
+{
+  const unsigned int nEngines = 12; //!< number of validated engines
+  extern const char *listOfEngines[]; //!< list of validated engines
+  //! engines enumerator
+  enum Engine {SERIAL, SCHEDULER, PIPELINE, RANKS, STREAMED, INCREMENTAL,
+               COMPRESSED, QUANTIZED, SYMMETRIC, REGION, CLASSIFIER,
+               EARLY_EXIT};
+  
+  //! the largest distance difference allowed for each storage
+  //! precision (engines in double must give reference bit for bit)
+  const double distanceTolerance[nPrecisions] = {0.0, 1e-6, 2e-3, 1e-1};
+  
+  //! the largest score difference allowed for quantized engines
+  const double scoreTolerance = 0.05;
+  
+  //! learning samples are split into that many ranks (RANKS engine)
+  const unsigned int validationRanks = 3;
+  
+  //! learning samples are read in that many chunks (STREAMED engine)
+  const unsigned int validationChunks = 4;
+  
+  //! the oldest 1 / validationRetired of learning samples are retired
+  //! at the end (INCREMENTAL engine)
+  const unsigned int validationRetired = 4;
+  
+  //! region of interest of REGION engine (see RecoTargetRegion)
+  const char validationRegion[] = "targets";
+}
+
+/*! reference = Sample::distance to every learning sample, sorted by
+ *  std::list::sort (distance, then target, then id), top kmax kept;
+ *  every engine is run on the same synthetic events with every metric:
+ *  <ul>
+ *  <li> exact engines (all but QUANTIZED, compressed samples included)
+ *  must give the same neighbors in the same order (ties included), the
+ *  same distances and the same scores for every k up to kmax and every
+ *  vote
+ *  <li> quantized engines must give the same neighbors up to
+ *  distanceTolerance of their precision: distances at each position
+ *  within it (near-equal neighbors may swap), neighbors which are not
+ *  in reference within it from the last one of reference, and scores
+ *  within scoreTolerance
+ *  <li> classifier must predict the same target for every event (for
+ *  each k and vote of the run)
+ *  <li> RecoTargetRanking must give the same scores as getScore
+ *  <li> SYMMETRIC (leave-one-out) is compared to learning samples of
+ *  testing targets with reference neighbors of all other ones
+ *  <li> REGION is compared to reference of samples which keep only
+ *  planes of validationRegion, INCREMENTAL to reference of learning
+ *  samples which are not retired
+ *  </ul>
+ *  events are generated from the seed of the run, with exact copies
+ *  (same target and other targets), so ties do happen
+ */
+class RecoTargetValidation
+{
+  public:
+  
+  //! constructor (generate events: sizes, targets, kmax, threads and
+  //! seed are taken from run)
+  RecoTargetValidation (const RecoTargetUserOptions &userOptions);
+  ~RecoTargetValidation (); //!< destructor
+  
+  //! check all engines with all metrics, print one line per check;
+  //! return the number of failed checks
+  unsigned int run (std::ostream &out);
+  
+  private:
+  
+  //! synthetic event (only hit planes, as in RecoTracks)
+  struct Event
+  {
+    std::vector <double> planeVisibleEnergy; //!< energy per hit plane
+    std::vector <int> planeId;               //!< id of hit plane
+  };
+  
+  //! how engine differs from reference
+  struct Result
+  {
+    double found;    //!< fraction of reference neighbors found
+    bool isSame;     //!< true if all lists have the same order
+    bool isNear;     //!< true if lists differ within tolerance only
+    double distance; //!< the largest distance difference (same rank)
+    double score;    //!< the largest score difference
+    unsigned int nDiffer; //!< predictions which differ (classifier)
+  };
+  
+  RecoTargetUserOptions userOptions; //!< run (its metric is changed)
+  
+  std::vector <Event> testingEvents[RecoTarget::nTargets];
+  std::vector <Event> learningEvents[RecoTarget::nTargets];
+  
+  //! testing samples with reference neighbors (NULL = not selected)
+  RecoTargetSampleHandler *reference[RecoTarget::nTargets];
+  
+  //! learning samples of reference (NULL = not selected)
+  RecoTargetSampleHandler *learning[RecoTarget::nTargets];
+  
+  //! learning samples of testing targets with reference neighbors of
+  //! all other learning samples (leave-one-out, NULL = not selected)
+  RecoTargetSampleHandler *self[RecoTarget::nTargets];
+  
+  //! validation owns samples, so it can not be copied
+  RecoTargetValidation (const RecoTargetValidation &);
+  RecoTargetValidation& operator= (const RecoTargetValidation &);
+  
+  //! generate testing and learning events of selected targets
+  void generate ();
+  
+  //! create handler with events [from, to) (ids starting from "from"),
+  //! samples keep only planes of region (empty = all planes)
+  static RecoTargetSampleHandler* load
+    (const std::vector <Event> &events, const unsigned int &from,
+     const unsigned int &to, const bool &compressed = false,
+     const std::vector <unsigned int> &region =
+     std::vector <unsigned int> ());
+  
+  //! fill reference neighbors with the metric of the run
+  void fillReference ();
+  
+  //! fill reference neighbors of samples of target from learningSamples
+  //! (isLearning: they are learning samples, so each one is not its own
+  //! neighbor)
+  void fillReference (RecoTargetSampleHandler *samples,
+                      const unsigned int &target, const bool &isLearning,
+                      RecoTargetSampleHandler **learningSamples);
+  
+  //! fill neighbors of testing samples with engine
+  void fillNeighbors (const RecoTarget::Engine &engine,
+                      RecoTargetSampleHandler **testingSamples,
+                      RecoTargetSampleHandler **learningSamples);
+  
+  //! compare neighbors and scores of testing samples with reference
+  //! samples (NULL = not compared), distances within tolerance
+  Result compareNeighbors (RecoTargetSampleHandler **testingSamples,
+                           RecoTargetSampleHandler **referenceSamples,
+                           const double &tolerance) const;
+  
+  //! compare predictions of classifier with reference
+  Result comparePredictions (const bool &earlyExit);
+  
+  //! compare scores of ranking with getScore of reference
+  Result compareRanking ();
+  
+  //! run engine (with precision for QUANTIZED), print result; return
+  //! true if it passed
+  bool check (const RecoTarget::Engine &engine,
+              const RecoTarget::Precision &precision, std::ostream &out);
+  
+  //! print one line of table; return true if result passed
+  bool print (std::ostream &out, const std::string &engine,
+              const Result &result, const bool &isExact) const;
+};
+
+#endif
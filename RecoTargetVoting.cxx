@@ -0,0 +1,53 @@
+#include "RecoTargetVoting.h"
+#include "RecoTargetException.h"
+#include <algorithm>
+#include <cmath>
+
+namespace RecoTarget
+{
+  //! use for understandable cout's
+  const char *listOfVotes[] =
+  {
+    "Majority",
+    "Inverse distance",
+    "Gaussian kernel"
+  };
+  
+  //! return 1
+  double voteMajority (const double &, const double &)
+  {
+    return 1.0;
+  }
+  
+  //! return 1/distance (distance < 0 is treated as 0)
+  double voteInverseDistance (const double &distance, const double &)
+  {
+    return 1.0 / (std::max (distance, 0.0) + 1e-9);
+  }
+  
+  //! return exp(-(distance/scale)^2/2) (1 if scale = 0)
+  double voteGaussian (const double &distance, const double &scale)
+  {
+    if (scale <= 0.0) return 1.0;
+    
+    const double x = std::max (distance, 0.0) / scale;
+    
+    return exp (-0.5 * x * x);
+  }
+  
+  //! scale is the distance to the k-th neighbor
+  double (*voteFunction (const Vote &vote))(const double&, const double&)
+  {
+    switch (vote)
+    {
+      case MAJORITY:
+        return voteMajority;
+      case INVERSE_DISTANCE:
+        return voteInverseDistance;
+      case GAUSSIAN:
+        return voteGaussian;
+      default:
+        throw Exception (BAD_ARGUMENT, "undefined vote");
+    }
+  }
+}
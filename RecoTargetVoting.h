@@ -0,0 +1,30 @@
+/**
+ * @brief The definitions of neighbors votes
+ * 
+ * @author TG, GP, MW
+ * @date 2015
+ * 
+*/
+
+#ifndef RECO_TARGET_VOTING_H
+#define RECO_TARGET_VOTING_H
+
+namespace RecoTarget
+{
+  const unsigned int nVotes = 3; //!< number of implemented votes
+  extern const char *listOfVotes[]; //!< list of implemented votes
+  //! votes enumerator
+  enum Vote {MAJORITY, INVERSE_DISTANCE, GAUSSIAN};
+  
+  //! each neighbor has the same vote
+  double voteMajority (const double &distance, const double &scale);
+  //! vote weighted by 1/distance
+  double voteInverseDistance (const double &distance, const double &scale);
+  //! vote weighted by Gaussian kernel of width = scale
+  double voteGaussian (const double &distance, const double &scale);
+  
+  //! return pointer to vote function
+  double (*voteFunction (const Vote &vote))(const double&, const double&);
+}
+
+#endif